@@ -0,0 +1,451 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <prim/prim.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "palloc/PageAllocator.h"
+
+/*
+ * This is a trace driven benchmark of the page allocators. Each run drives one
+ * allocator with a synthetic workload and reports the throughput, latency
+ * percentiles of each API call, peak metadata bytes, and the fragmentation
+ * ratio at the end of the run. Building with PALLOC_STATS also reports the
+ * search histograms.
+ *
+ * Workloads:
+ *  uniform     uniform sizes, random lifetimes
+ *  powerlaw    Pareto distributed sizes, random lifetimes
+ *  lifo        uniform sizes, bursts of allocations freed newest first
+ *  fifo        uniform sizes, bursts of allocations freed oldest first
+ *  growshrink  uniform sizes, mostly growing, shrinking, and resizing
+ *
+ * The number of live blocks is bounded so heaps of up to 2^36 pages can be
+ * run, larger heaps simply use larger blocks.
+ */
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+enum Api : u32 {
+  kCreate = 0, kFree, kGrow, kShrink, kResize, kNumApis
+};
+
+const char* kApiNames[kNumApis] = {
+  "createBlock", "freeBlock", "growBlock", "shrinkBlock", "resizeBlock"
+};
+
+enum Workload : u32 {
+  kUniform = 0, kPowerLaw, kLifo, kFifo, kGrowShrink, kNumWorkloads
+};
+
+const char* kWorkloadNames[kNumWorkloads] = {
+  "uniform", "powerlaw", "lifo", "fifo", "growshrink"
+};
+
+const f64 kOccupancy = 0.6;  // targeted fraction of used pages
+const u64 kMaxLiveBlocks = 8192;
+
+struct Live {
+  u64 base;
+  u64 pages;  // requested pages, the block may be slightly larger
+};
+
+struct Settings {
+  u64 ops;
+  u64 seed;
+  std::vector<u64> exponents;  // heap sizes are 2^exponent pages
+  std::vector<u64> minBlockSizes;
+  std::vector<u32> workloads;
+  std::string policy;
+};
+
+template <typename Allocator>
+class Bench {
+ public:
+  Bench(u64 _pages, u64 _minBlockSize, u32 _workload, u64 _seed)
+      : pages_(_pages), minBlockSize_(_minBlockSize), workload_(_workload),
+        allocator_(_pages, _minBlockSize), rnd_(_seed), allocating_(true),
+        drainTo_(0), failures_(0), peakMetadata_(0) {
+    // size the blocks so the targeted occupancy is reached with a bounded
+    //  number of live blocks
+    u64 liveBlocks = std::max(
+        std::min(pages_ / (16 * minBlockSize_), kMaxLiveBlocks), (u64)1);
+    targetPages_ = (u64)(pages_ * kOccupancy);
+    meanPages_ = std::max(targetPages_ / liveBlocks, (u64)1);
+  }
+
+  void run(u64 _ops) {
+    for (u64 op = 0; op < _ops; op++) {
+      switch (workload_) {
+        case kUniform:
+        case kPowerLaw:
+          stepRandom();
+          break;
+        case kLifo:
+        case kFifo:
+          stepBurst();
+          break;
+        case kGrowShrink:
+          stepGrowShrink();
+          break;
+      }
+      peakMetadata_ = std::max(peakMetadata_, allocator_.metadataBytes());
+    }
+  }
+
+  void report() {
+    u64 ns = 0;
+    u64 calls = 0;
+    for (u32 api = 0; api < kNumApis; api++) {
+      for (u64 latency : latencies_[api]) {
+        ns += latency;
+      }
+      calls += latencies_[api].size();
+    }
+    printf("%-10s pages=2^%-2u mbs=%-4lu %10.0f ops/s  metadata=%lu bytes  "
+           "fragmentation=%.4f  failures=%lu\n",
+           kWorkloadNames[workload_], __builtin_ctzll(pages_), minBlockSize_,
+           ns == 0 ? 0.0 : calls * 1e9 / ns, peakMetadata_, fragmentation(),
+           failures_);
+#ifdef PALLOC_STATS
+    palloc::Stats stats;
+    allocator_.getStats(&stats);
+    const palloc::StatCounters& counters = stats.counters;
+    printf("  splits=%lu coalesces=%lu probes p50<=%lu p99<=%lu "
+           "walked p50<=%lu p99<=%lu\n",
+           counters.splits, counters.coalesces,
+           counters.probes.quantile(0.50), counters.probes.quantile(0.99),
+           counters.walked.quantile(0.50), counters.walked.quantile(0.99));
+#endif  // PALLOC_STATS
+    for (u32 api = 0; api < kNumApis; api++) {
+      std::vector<u64>& latencies = latencies_[api];
+      if (latencies.empty()) {
+        continue;
+      }
+      printf("  %-12s calls=%-8lu p50=%-6lu p99=%-6lu p999=%-6lu (ns)\n",
+             kApiNames[api], latencies.size(), percentile(&latencies, 0.50),
+             percentile(&latencies, 0.99), percentile(&latencies, 0.999));
+    }
+  }
+
+ private:
+  // this returns the nanoseconds since '_start' and records them for '_api'
+  void record(u32 _api, Clock::time_point _start) {
+    u64 ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now() - _start).count();
+    latencies_[_api].push_back(ns);
+  }
+
+  // this returns the '_fraction' percentile of the latencies (reorders them)
+  static u64 percentile(std::vector<u64>* _latencies, f64 _fraction) {
+    u64 index = (u64)(_fraction * (_latencies->size() - 1));
+    std::nth_element(_latencies->begin(), _latencies->begin() + index,
+                     _latencies->end());
+    return _latencies->at(index);
+  }
+
+  // this returns the fraction of free pages outside the largest free block
+  f64 fragmentation() const {
+    palloc::Stats stats;
+    allocator_.getStats(&stats);
+    return stats.fragmentation;
+  }
+
+  u64 random(u64 _limit) {
+    return std::uniform_int_distribution<u64>(0, _limit - 1)(rnd_);
+  }
+
+  u64 nextSize() {
+    if (workload_ == kPowerLaw) {
+      // Pareto with alpha 1.5 has a mean of 3 times its minimum
+      f64 minimum = std::max(meanPages_ / 3.0, 1.0);
+      f64 u = std::uniform_real_distribution<f64>(0.0, 1.0)(rnd_);
+      f64 size = minimum / std::pow(1.0 - u, 1.0 / 1.5);
+      return std::min((u64)size, pages_ / 8 + 1);
+    }
+    return 1 + random(2 * meanPages_);
+  }
+
+  bool create() {
+    u64 pages = nextSize();
+    Clock::time_point start = Clock::now();
+    u64 base = allocator_.createBlock(pages);
+    record(kCreate, start);
+    if (base == palloc::INV) {
+      failures_++;
+      return false;
+    }
+    live_.push_back({base, pages});
+    return true;
+  }
+
+  void free(u64 _index) {
+    Clock::time_point start = Clock::now();
+    bool ok = allocator_.freeBlock(live_.at(_index).base);
+    record(kFree, start);
+    (void)ok;  // unused
+    assert(ok);
+    std::swap(live_.at(_index), live_.back());
+    live_.pop_back();
+  }
+
+  void freeFront() {
+    Clock::time_point start = Clock::now();
+    bool ok = allocator_.freeBlock(live_.front().base);
+    record(kFree, start);
+    (void)ok;  // unused
+    assert(ok);
+    live_.pop_front();
+  }
+
+  void grow(u64 _index) {
+    Live& block = live_.at(_index);
+    u64 pages = block.pages + 1 + random(meanPages_);
+    Clock::time_point start = Clock::now();
+    bool ok = allocator_.growBlock(block.base, pages);
+    record(kGrow, start);
+    if (ok) {
+      block.pages = pages;
+    } else {
+      failures_++;
+    }
+  }
+
+  void shrink(u64 _index) {
+    Live& block = live_.at(_index);
+    if (block.pages < 2) {
+      return;
+    }
+    u64 pages = 1 + random(block.pages - 1);
+    Clock::time_point start = Clock::now();
+    bool ok = allocator_.shrinkBlock(block.base, pages);
+    record(kShrink, start);
+    (void)ok;  // unused
+    assert(ok);
+    block.pages = pages;
+  }
+
+  void resize(u64 _index) {
+    Live& block = live_.at(_index);
+    u64 pages = nextSize();
+    palloc::Move move;
+    Clock::time_point start = Clock::now();
+    u64 base = allocator_.resizeBlock(block.base, pages, &move);
+    record(kResize, start);
+    if (base == palloc::INV) {
+      failures_++;
+    } else {
+      block.base = base;
+      block.pages = pages;
+    }
+  }
+
+  // random lifetimes: allocate below the targeted occupancy, free above it
+  void stepRandom() {
+    if ((live_.empty() || allocator_.usedPages() < targetPages_) &&
+        (create() || live_.empty())) {
+      return;
+    }
+    free(random(live_.size()));
+  }
+
+  // bursts: allocate up to the targeted occupancy then free a random number
+  //  of blocks from the back (LIFO) or front (FIFO)
+  void stepBurst() {
+    if (allocating_) {
+      if (allocator_.usedPages() < targetPages_ && create()) {
+        return;
+      }
+      allocating_ = false;
+      drainTo_ = random(live_.size());
+    }
+    if (live_.size() <= drainTo_ || live_.empty()) {
+      allocating_ = true;
+      return;
+    }
+    if (workload_ == kLifo) {
+      free(live_.size() - 1);
+    } else {
+      freeFront();
+    }
+  }
+
+  // grow/shrink heavy: 20% create/free, 30% grow, 25% shrink, 25% resize
+  void stepGrowShrink() {
+    u64 choice = random(20);
+    if (live_.empty() || choice < 4) {
+      stepRandom();
+      return;
+    }
+    u64 index = random(live_.size());
+    if (choice < 10) {
+      grow(index);
+    } else if (choice < 15) {
+      shrink(index);
+    } else {
+      resize(index);
+    }
+  }
+
+  const u64 pages_;
+  const u64 minBlockSize_;
+  const u32 workload_;
+  Allocator allocator_;
+  std::mt19937_64 rnd_;
+  u64 targetPages_;
+  u64 meanPages_;
+  std::deque<Live> live_;
+  bool allocating_;
+  u64 drainTo_;
+  u64 failures_;
+  u64 peakMetadata_;
+  std::vector<u64> latencies_[kNumApis];
+};
+
+template <typename Allocator>
+void runAll(const Settings& _settings) {
+  for (u32 workload : _settings.workloads) {
+    for (u64 exponent : _settings.exponents) {
+      for (u64 mbs : _settings.minBlockSizes) {
+        u64 pages = (u64)1 << exponent;
+        if (mbs * 64 > pages) {
+          continue;  // too few blocks to be meaningful
+        }
+        Bench<Allocator> bench(pages, mbs, workload, _settings.seed);
+        bench.run(_settings.ops);
+        bench.report();
+      }
+    }
+  }
+}
+
+void usage(const char* _name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -o OPS       operations per run (default 200000)\n"
+          "  -s SEED      random seed (default 12345)\n"
+          "  -e EXP       heap size 2^EXP pages, repeatable "
+          "(default 10,14,...,34,36)\n"
+          "  -m MBS       minimum block size, repeatable (default 1,8,64)\n"
+          "  -w WORKLOAD  uniform, powerlaw, lifo, fifo, growshrink, "
+          "repeatable (default all)\n"
+          "  -p POLICY    bestfit, firstfit, or nextfit (default bestfit)\n",
+          _name);
+  exit(-1);
+}
+
+}  // namespace
+
+s32 main(s32 _argc, char** _argv) {
+  Settings settings;
+  settings.ops = 200000;
+  settings.seed = 12345;
+  settings.policy = "bestfit";
+
+  s32 opt;
+  while ((opt = getopt(_argc, _argv, "o:s:e:m:w:p:h")) != -1) {
+    switch (opt) {
+      case 'o':
+        settings.ops = strtoull(optarg, nullptr, 0);
+        break;
+      case 's':
+        settings.seed = strtoull(optarg, nullptr, 0);
+        break;
+      case 'e':
+        settings.exponents.push_back(strtoull(optarg, nullptr, 0));
+        if (settings.exponents.back() > 62) {
+          usage(_argv[0]);
+        }
+        break;
+      case 'm':
+        settings.minBlockSizes.push_back(strtoull(optarg, nullptr, 0));
+        if (settings.minBlockSizes.back() == 0) {
+          usage(_argv[0]);
+        }
+        break;
+      case 'w': {
+        u32 workload = 0;
+        while (workload < kNumWorkloads &&
+               strcmp(optarg, kWorkloadNames[workload]) != 0) {
+          workload++;
+        }
+        if (workload == kNumWorkloads) {
+          usage(_argv[0]);
+        }
+        settings.workloads.push_back(workload);
+        break;
+      }
+      case 'p':
+        settings.policy = optarg;
+        break;
+      default:
+        usage(_argv[0]);
+    }
+  }
+  if (settings.exponents.empty()) {
+    for (u64 exponent = 10; exponent <= 34; exponent += 4) {
+      settings.exponents.push_back(exponent);
+    }
+    settings.exponents.push_back(36);
+  }
+  if (settings.minBlockSizes.empty()) {
+    settings.minBlockSizes = {1, 8, 64};
+  }
+  if (settings.workloads.empty()) {
+    for (u32 workload = 0; workload < kNumWorkloads; workload++) {
+      settings.workloads.push_back(workload);
+    }
+  }
+
+  if (settings.policy == "bestfit") {
+    runAll<palloc::PageAllocator>(settings);
+  } else if (settings.policy == "firstfit") {
+    runAll<palloc::FirstFitPageAllocator>(settings);
+  } else if (settings.policy == "nextfit") {
+    runAll<palloc::NextFitPageAllocator>(settings);
+  } else {
+    usage(_argv[0]);
+  }
+  return 0;
+}
@@ -0,0 +1,202 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <prim/prim.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "palloc/ConcurrentPageAllocator.h"
+
+/*
+ * This measures how the throughput of ConcurrentPageAllocator scales with the
+ * number of threads. For 1, 2, 4, ... threads up to the maximum, a fresh
+ * allocator is driven by all threads at once, each allocating and freeing
+ * small blocks at random while keeping a bounded number of live blocks. Blocks
+ * are freed with the sized freeBlock() so they go through the caches, unless
+ * the caches are disabled. The calls per second and the speedup over one
+ * thread are reported.
+ */
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const u64 kMaxLiveBlocks = 256;  // per thread
+
+struct Settings {
+  u64 threads;
+  u64 shards;  // 0 for one per thread
+  u64 cachePages;
+  u64 maxPages;  // largest block size
+  u64 ops;  // per thread
+  u64 exponent;  // the heap has 2^exponent pages
+  u64 minBlockSize;
+};
+
+// returns the calls per second of all threads together
+f64 run(const Settings& _settings, u64 _threads) {
+  u64 shards = (_settings.shards == 0) ? _threads : _settings.shards;
+  palloc::ConcurrentPageAllocator allocator(
+      (u64)1 << _settings.exponent, _settings.minBlockSize, shards,
+      _settings.cachePages);
+
+  // the threads start together and the slowest one sets the time
+  std::atomic<u64> ready(0);
+  std::atomic<u64> failures(0);
+  std::vector<std::thread> threads;
+  for (u64 thread = 0; thread < _threads; thread++) {
+    threads.push_back(std::thread([&, thread]() {
+      std::mt19937_64 rnd(12345 + thread);
+      std::vector<std::pair<u64, u64> > live;
+      live.reserve(kMaxLiveBlocks);
+      ready++;
+      while (ready < _threads) {}
+      for (u64 op = 0; op < _settings.ops; op++) {
+        if (live.empty() ||
+            (live.size() < kMaxLiveBlocks && (rnd() & 1) == 0)) {
+          u64 pages = 1 + rnd() % _settings.maxPages;
+          u64 block = allocator.createBlock(pages);
+          if (block == palloc::INV) {
+            failures++;
+          } else {
+            live.push_back(std::make_pair(block, pages));
+          }
+        } else {
+          u64 idx = rnd() % live.size();
+          std::swap(live.at(idx), live.back());
+          allocator.freeBlock(live.back().first, live.back().second);
+          live.pop_back();
+        }
+      }
+      for (const std::pair<u64, u64>& block : live) {
+        allocator.freeBlock(block.first, block.second);
+      }
+    }));
+  }
+  while (ready < _threads) {}
+  Clock::time_point start = Clock::now();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  f64 seconds = std::chrono::duration_cast<std::chrono::duration<f64> >(
+      Clock::now() - start).count();
+  allocator.verify(false);
+  if (failures > 0) {
+    fprintf(stderr, "warning: %lu allocations failed\n", (u64)failures);
+  }
+  return seconds > 0.0 ? _threads * _settings.ops / seconds : 0.0;
+}
+
+void usage(const char* _name) {
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -t COUNT  most threads (default hardware threads)\n"
+          "  -s COUNT  shards (default one per thread)\n"
+          "  -c PAGES  largest cached block size, 0 disables the caches "
+          "(default 16)\n"
+          "  -b PAGES  largest block size (default 16)\n"
+          "  -o COUNT  calls per thread (default 1000000)\n"
+          "  -e EXP    heap size is 2^EXP pages (default 24)\n"
+          "  -m PAGES  minimum block size (default 1)\n",
+          _name);
+  exit(-1);
+}
+
+}  // namespace
+
+s32 main(s32 _argc, char** _argv) {
+  Settings settings;
+  settings.threads = std::max((u64)std::thread::hardware_concurrency(),
+                              (u64)1);
+  settings.shards = 0;
+  settings.cachePages = 16;
+  settings.maxPages = 16;
+  settings.ops = 1000000;
+  settings.exponent = 24;
+  settings.minBlockSize = 1;
+
+  s32 opt;
+  while ((opt = getopt(_argc, _argv, "t:s:c:b:o:e:m:h")) != -1) {
+    switch (opt) {
+      case 't':
+        settings.threads = strtoull(optarg, nullptr, 0);
+        break;
+      case 's':
+        settings.shards = strtoull(optarg, nullptr, 0);
+        break;
+      case 'c':
+        settings.cachePages = strtoull(optarg, nullptr, 0);
+        break;
+      case 'b':
+        settings.maxPages = strtoull(optarg, nullptr, 0);
+        break;
+      case 'o':
+        settings.ops = strtoull(optarg, nullptr, 0);
+        break;
+      case 'e':
+        settings.exponent = strtoull(optarg, nullptr, 0);
+        break;
+      case 'm':
+        settings.minBlockSize = strtoull(optarg, nullptr, 0);
+        break;
+      default:
+        usage(_argv[0]);
+    }
+  }
+  if (optind != _argc || settings.threads == 0 || settings.maxPages == 0 ||
+      settings.minBlockSize == 0 || settings.exponent == 0 ||
+      settings.exponent > 40) {
+    usage(_argv[0]);
+  }
+
+  printf("%8s %16s %8s\n", "threads", "calls/s", "speedup");
+  f64 base = 0.0;
+  for (u64 threads = 1; threads <= settings.threads; threads *= 2) {
+    f64 rate = run(settings, threads);
+    if (threads == 1) {
+      base = rate;
+    }
+    printf("%8lu %16.0f %8.2f\n", threads, rate,
+           base > 0.0 ? rate / base : 0.0);
+    if (threads < settings.threads && threads * 2 > settings.threads) {
+      threads = settings.threads / 2;  // the last run uses all threads
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <ex/Exception.h>
+#include <prim/prim.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "palloc/PageAllocator.h"
+#include "palloc/Trace.h"
+#include "palloc/TraceReplay.h"
+
+/*
+ * This replays a trace recorded with PageAllocator::startTrace() on a fresh
+ * allocator at full speed. The trace is loaded into memory first so only the
+ * allocator calls are timed. Any placement policy can be replayed, which
+ * compares allocator variants on a real workload.
+ */
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+template <typename Allocator>
+void replay(const palloc::TraceHeader& _header,
+            const std::vector<palloc::TraceRecord>& _records, u64 _repeats,
+            bool _verify) {
+  for (u64 repeat = 0; repeat < _repeats; repeat++) {
+    Allocator allocator(_header.pages, _header.minBlockSize);
+    palloc::TraceReplay<Allocator> replay(&allocator);
+    Clock::time_point start = Clock::now();
+    replay.replay(_records.data(), _records.size());
+    f64 seconds = std::chrono::duration_cast<std::chrono::duration<f64> >(
+        Clock::now() - start).count();
+    if (_verify) {
+      allocator.verify(false);
+    }
+    printf("replay %lu: %lu calls in %.6f s (%.0f calls/s), %lu mismatches, "
+           "%lu skipped, %lu used blocks, %lu free blocks, metadata=%lu "
+           "bytes\n",
+           repeat, replay.calls(), seconds,
+           seconds > 0.0 ? replay.calls() / seconds : 0.0,
+           replay.mismatches(), replay.skipped(), allocator.usedBlocks(),
+           allocator.freeBlocks(), allocator.metadataBytes());
+  }
+}
+
+void usage(const char* _name) {
+  fprintf(stderr,
+          "usage: %s [options] trace\n"
+          "  -p POLICY  bestfit, firstfit, or nextfit (default bestfit)\n"
+          "  -r COUNT   number of replays (default 1)\n"
+          "  -v         verify the allocator after each replay\n"
+          "  -s         print a summary of the trace\n",
+          _name);
+  exit(-1);
+}
+
+}  // namespace
+
+s32 main(s32 _argc, char** _argv) {
+  std::string policy = "bestfit";
+  u64 repeats = 1;
+  bool verify = false;
+  bool summary = false;
+
+  s32 opt;
+  while ((opt = getopt(_argc, _argv, "p:r:vsh")) != -1) {
+    switch (opt) {
+      case 'p':
+        policy = optarg;
+        break;
+      case 'r':
+        repeats = strtoull(optarg, nullptr, 0);
+        break;
+      case 'v':
+        verify = true;
+        break;
+      case 's':
+        summary = true;
+        break;
+      default:
+        usage(_argv[0]);
+    }
+  }
+  if (optind != _argc - 1) {
+    usage(_argv[0]);
+  }
+
+  // load the trace
+  palloc::TraceReader reader;
+  if (!reader.open(_argv[optind])) {
+    fprintf(stderr, "%s is not a trace\n", _argv[optind]);
+    return -1;
+  }
+  std::vector<palloc::TraceRecord> records;
+  if (!reader.readAll(&records)) {
+    fprintf(stderr, "warning: %s is truncated\n", _argv[optind]);
+  }
+  const palloc::TraceHeader& header = reader.header();
+  printf("trace: pages=%lu mbs=%lu records=%lu recorded over %.6f s\n",
+         header.pages, header.minBlockSize, records.size(),
+         records.empty() ? 0.0 : (records.back().time - records.front().time) *
+         1e-9);
+
+  if (summary) {
+    std::vector<u64> counts(palloc::kNumTraceOps, 0);
+    for (const palloc::TraceRecord& record : records) {
+      if (record.op < palloc::kNumTraceOps) {
+        counts.at(record.op)++;
+      }
+    }
+    for (u64 op = 0; op < palloc::kNumTraceOps; op++) {
+      if (counts.at(op) > 0) {
+        printf("  %-22s %lu\n", palloc::traceOpName(op), counts.at(op));
+      }
+    }
+  }
+
+  // the allocator rejects a bad geometry in the header
+  try {
+    if (policy == "bestfit") {
+      replay<palloc::PageAllocator>(header, records, repeats, verify);
+    } else if (policy == "firstfit") {
+      replay<palloc::FirstFitPageAllocator>(header, records, repeats, verify);
+    } else if (policy == "nextfit") {
+      replay<palloc::NextFitPageAllocator>(header, records, repeats, verify);
+    } else {
+      usage(_argv[0]);
+    }
+  } catch (ex::Exception* _e) {
+    fprintf(stderr, "%s has a bad geometry: %s\n", _argv[optind], _e->what());
+    delete _e;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,182 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/AddressIndex.h"
+
+#include <cassert>
+
+#include <algorithm>
+
+namespace palloc {
+
+const u64 AddressIndex::kMinPoolChunk;
+
+AddressIndex::AddressIndex()
+    : poolNodes_(0), freeNodes_(nullptr), root_(nullptr), count_(0) {}
+
+void AddressIndex::insert(Block* _block) {
+  // grow the pool geometrically when it is exhausted
+  if (freeNodes_ == nullptr) {
+    u64 nodes = std::max(poolNodes_, kMinPoolChunk);
+    poolChunks_.emplace_back(new Node[nodes]);
+    Node* chunk = poolChunks_.back().get();
+    poolNodes_ += nodes;
+    for (u64 idx = nodes; idx > 0; idx--) {
+      chunk[idx - 1].left = freeNodes_;
+      freeNodes_ = &chunk[idx - 1];
+    }
+  }
+  Node* node = freeNodes_;
+  freeNodes_ = node->left;
+  node->block = _block;
+
+  // descend to the first node of a lower priority, the node takes its place
+  //  and the subtree found there is split between the node's children
+  u64 prio = priority(node);
+  Node** link = &root_;
+  while (*link != nullptr && priority(*link) > prio) {
+    link = (_block->base < (*link)->block->base) ? &(*link)->left :
+        &(*link)->right;
+  }
+  split(*link, _block->base, &node->left, &node->right);
+  *link = node;
+  count_++;
+}
+
+void AddressIndex::remove(const Block* _block) {
+  // find the node, its children are merged into its place
+  Node** link = &root_;
+  while ((*link)->block != _block) {
+    link = (_block->base < (*link)->block->base) ? &(*link)->left :
+        &(*link)->right;
+    assert(*link != nullptr);
+  }
+  Node* node = *link;
+  *link = merge(node->left, node->right);
+  count_--;
+
+  // push the node onto the unused node stack
+  node->left = freeNodes_;
+  freeNodes_ = node;
+}
+
+Block* AddressIndex::floor(u64 _page) const {
+  Block* best = nullptr;
+  for (const Node* node = root_; node != nullptr;) {
+    if (node->block->base <= _page) {
+      best = node->block;
+      node = node->right;
+    } else {
+      node = node->left;
+    }
+  }
+  return best;
+}
+
+u64 AddressIndex::metadataBytes() const {
+  return poolNodes_ * sizeof(Node) +
+      poolChunks_.capacity() * sizeof(std::unique_ptr<Node[]>);
+}
+
+u64 AddressIndex::verify() const {
+  const Block* last = nullptr;
+  u64 count = verify(root_, &last);
+  (void)count;  // unused
+  assert(count == count_);
+  return count_;
+}
+
+/*** private below here ***/
+
+u64 AddressIndex::priority(const Node* _node) {
+  // a mix of the node's address, stable while the node is in the index
+  u64 hash = (u64)_node;
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDlu;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+void AddressIndex::split(Node* _root, u64 _base, Node** _lower,
+                         Node** _upper) {
+  // walk down the subtree handing each node to the side it belongs to
+  while (_root != nullptr) {
+    if (_root->block->base < _base) {
+      *_lower = _root;
+      _lower = &_root->right;
+      _root = _root->right;
+    } else {
+      *_upper = _root;
+      _upper = &_root->left;
+      _root = _root->left;
+    }
+  }
+  *_lower = nullptr;
+  *_upper = nullptr;
+}
+
+AddressIndex::Node* AddressIndex::merge(Node* _lower, Node* _upper) {
+  // walk down the right spine of the lower subtree and the left spine of the
+  //  upper subtree in priority order
+  Node* root;
+  Node** link = &root;
+  while (_lower != nullptr && _upper != nullptr) {
+    if (priority(_lower) > priority(_upper)) {
+      *link = _lower;
+      link = &_lower->right;
+      _lower = _lower->right;
+    } else {
+      *link = _upper;
+      link = &_upper->left;
+      _upper = _upper->left;
+    }
+  }
+  *link = (_lower != nullptr) ? _lower : _upper;
+  return root;
+}
+
+u64 AddressIndex::verify(const Node* _root, const Block** _last) {
+  if (_root == nullptr) {
+    return 0;
+  }
+  u64 count = verify(_root->left, _last);
+  assert(_root->left == nullptr || priority(_root->left) <= priority(_root));
+  assert(_root->right == nullptr ||
+         priority(_root->right) <= priority(_root));
+
+  // the blocks are disjoint and in page order
+  const Block* last = *_last;
+  (void)last;  // unused
+  assert(last == nullptr || last->base + last->size <= _root->block->base);
+  *_last = _root->block;
+  return count + 1 + verify(_root->right, _last);
+}
+
+}  // namespace palloc
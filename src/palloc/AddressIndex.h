@@ -0,0 +1,107 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_ADDRESSINDEX_H_
+#define PALLOC_ADDRESSINDEX_H_
+
+#include <prim/prim.h>
+
+#include <memory>
+#include <vector>
+
+#include "palloc/Block.h"
+
+namespace palloc {
+
+/*
+ * This is an index of disjoint blocks ordered by base page that is kept
+ * outside of the blocks, so only the blocks in it pay for it. It is a treap
+ * of pooled nodes with priorities hashed from the node address. Insertion
+ * and removal split and merge subtrees in expected O(log n) time.
+ */
+class AddressIndex {
+ public:
+  AddressIndex();
+
+  // adds a block, its base page must not change while it is in the index
+  void insert(Block* _block);
+
+  // removes a block
+  void remove(const Block* _block);
+
+  // returns the block with the highest base page of at most '_page', nullptr
+  //  if none
+  Block* floor(u64 _page) const;
+
+  // returns the number of blocks in the index
+  u64 count() const {
+    return count_;
+  }
+
+  // returns the number of bytes of heap memory used by the index, this only
+  //  grows because the node pool is never shrunk
+  u64 metadataBytes() const;
+
+  // verifies the index, returns the number of blocks in it
+  u64 verify() const;
+
+ private:
+  struct Node {
+    Block* block;
+    Node* left;  // also links the unused nodes
+    Node* right;
+  };
+
+  static const u64 kMinPoolChunk = 64;
+
+  // this returns the priority of a node
+  static u64 priority(const Node* _node);
+
+  // this splits a subtree into the nodes below '_base' and the others
+  static void split(Node* _root, u64 _base, Node** _lower, Node** _upper);
+
+  // this merges two subtrees, all of '_lower' is below all of '_upper'
+  static Node* merge(Node* _lower, Node* _upper);
+
+  // this verifies a subtree, returns its number of nodes and sets '_last' to
+  //  its last block
+  static u64 verify(const Node* _root, const Block** _last);
+
+  std::vector<std::unique_ptr<Node[]> > poolChunks_;
+  u64 poolNodes_;  // total number of nodes in the pool
+  Node* freeNodes_;  // stack of unused nodes linked by 'left'
+
+  Node* root_;
+  u64 count_;
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_ADDRESSINDEX_H_
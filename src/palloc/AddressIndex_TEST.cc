@@ -0,0 +1,73 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/AddressIndex.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <iterator>
+#include <map>
+#include <random>
+#include <vector>
+
+TEST(AddressIndex, floor) {
+  // blocks of 2 pages at even pages are added and removed at random
+  const u64 kBlocks = 1000;
+  std::vector<palloc::Block> blocks;
+  for (u64 idx = 0; idx < kBlocks; idx++) {
+    blocks.emplace_back(idx * 2, 2, false, nullptr, nullptr);
+  }
+  palloc::AddressIndex index;
+  ASSERT_EQ(index.floor(0), nullptr);
+  std::map<u64, palloc::Block*> expected;
+  std::mt19937_64 rnd(12345);
+  for (u64 iter = 0; iter < 20000; iter++) {
+    palloc::Block* block = &blocks.at(rnd() % kBlocks);
+    if (expected.count(block->base) == 0) {
+      index.insert(block);
+      expected[block->base] = block;
+    } else {
+      index.remove(block);
+      expected.erase(block->base);
+    }
+    ASSERT_EQ(index.count(), expected.size());
+
+    u64 page = rnd() % (kBlocks * 2 + 10);
+    auto it = expected.upper_bound(page);
+    palloc::Block* floor = (it == expected.begin()) ? nullptr :
+        std::prev(it)->second;
+    ASSERT_EQ(index.floor(page), floor);
+    if (iter % 1000 == 0) {
+      ASSERT_EQ(index.verify(), expected.size());
+    }
+  }
+  ASSERT_GT(index.metadataBytes(), 0u);
+}
@@ -0,0 +1,149 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_BESTFIT_H_
+#define PALLOC_BESTFIT_H_
+
+#include <prim/prim.h>
+
+#include <array>
+#include <vector>
+
+#include "palloc/AddressIndex.h"
+#include "palloc/Block.h"
+#include "palloc/SizeClasses.h"
+#include "palloc/Stats.h"
+#include "palloc/Treap.h"
+
+namespace palloc {
+
+/*
+ * This is the best fit placement policy: an exponential (i.e., powers of 2),
+ * sorted, segregated fit free index. Each free list is a treap ordered by
+ * size then base, and a mask of non-empty lists finds the first usable list
+ * with a single bit scan. An address index outside of the blocks orders all
+ * free blocks by base page for the lookups of fixed ranges.
+ *
+ * 'Classes' is SizeClasses or a StaticSizeClasses of a fixed geometry. It
+ * must provide index(), count(), limit(), and the type of the free list
+ * roots as 'Lists', either a std::vector or a std::array of Block*.
+ */
+
+template <typename Classes>
+class BasicBestFit {
+ public:
+  BasicBestFit(u64 _pages, u64 _minBlockSize);
+
+  // links a free block into the index
+  void link(Block* _block);
+
+  // unlinks a free block from the index
+  void unlink(Block* _block);
+
+  // returns the smallest free block with at least '_pages' pages (lowest
+  //  base page among equals), nullptr if none
+  Block* find(u64 _pages) const;
+
+  // returns the best fitting free block holding an aligned range of '_pages'
+  //  pages and sets '_base' to the aligned base page, nullptr if none
+  //  when no block is large enough to surely hold the range only the
+  //  kAlignedProbes smallest large enough blocks are checked, so this takes
+  //  O(log n + kAlignedProbes) time and can miss a larger aligned fit
+  Block* findAligned(u64 _pages, u64 _alignment, u64* _base) const;
+
+  // returns the size of the largest free block, 0 if none
+  u64 largest() const;
+
+  // returns the free block with the highest base page of at most '_page',
+  //  nullptr if none
+  Block* floor(u64 _page) const;
+
+  // changes the number of pages, refiling only the blocks of the classes
+  //  that are split or merged
+  //  returns true if success, false if the classes are fixed
+  bool resize(u64 _pages);
+
+  // returns the work done by the searches since the last call and resets it
+  //  (only counted with PALLOC_STATS)
+  SearchCount takeSearchCount() const;
+
+  // returns the number of bytes of heap memory used by the index
+  u64 metadataBytes() const;
+
+  // verifies the index, returns the number of free blocks in it
+  u64 verify(bool _print) const;
+
+ private:
+  struct SizeOrder {
+    static bool less(const Block* _a, const Block* _b);
+    static const bool kAugmented = false;
+  };
+  typedef Treap<SizeOrder> Tree;
+
+  // this returns the smallest block of a free list tree with at least
+  //  '_pages' pages, nullptr if none
+  Block* lowerBound(Block* _root, u64 _pages) const;
+
+  // this moves a free block between lists after the classes changed
+  void refile(u64 _from, Block* _block);
+
+  // these size the free lists and return their heap memory
+  static void makeLists(std::vector<Block*>* _lists, u64 _count);
+  template <size_t N>
+  static void makeLists(std::array<Block*, N>* _lists, u64 _count);
+  static void resizeLists(std::vector<Block*>* _lists, u64 _count);
+  template <size_t N>
+  static void resizeLists(std::array<Block*, N>* _lists, u64 _count);
+  static u64 listBytes(const std::vector<Block*>& _lists);
+  template <size_t N>
+  static u64 listBytes(const std::array<Block*, N>& _lists);
+
+  const u64 minBlockSize_;
+
+  Classes classes_;  // one free list per class
+  u64 freeListMask_;  // bit 'i' is set when free list 'i' is non-empty
+  typename Classes::Lists freeLists_;  // tree roots
+  AddressIndex addresses_;  // all free blocks in page order
+  mutable SearchCount search_;
+};
+
+typedef BasicBestFit<SizeClasses> BestFit;
+
+// the best fit policy of a fixed geometry
+template <u64 Pages, u64 MinBlockSize>
+using StaticBestFit = BasicBestFit<StaticSizeClasses<Pages, MinBlockSize> >;
+
+extern template class BasicBestFit<SizeClasses>;
+
+}  // namespace palloc
+
+#include "palloc/BestFit.tcc"
+
+#endif  // PALLOC_BESTFIT_H_
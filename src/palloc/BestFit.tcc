@@ -0,0 +1,324 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cassert>
+#include <cstdio>
+
+namespace palloc {
+
+template <typename Classes>
+BasicBestFit<Classes>::BasicBestFit(u64 _pages, u64 _minBlockSize)
+    : minBlockSize_(_minBlockSize), classes_(_pages, _minBlockSize),
+      search_({0, 0}) {
+  // create lists
+  makeLists(&freeLists_, classes_.count());
+  freeListMask_ = 0;
+}
+
+template <typename Classes>
+void BasicBestFit<Classes>::link(Block* _block) {
+  // put the block in its list in ascending size order
+  u64 listIndex = classes_.index(_block->size);
+  Tree::insert(&freeLists_[listIndex], _block);
+  addresses_.insert(_block);
+
+  // mark the list as non-empty
+  freeListMask_ |= (u64)1 << listIndex;
+}
+
+template <typename Classes>
+void BasicBestFit<Classes>::unlink(Block* _block) {
+  // remove the block from its list
+  u64 listIndex = classes_.index(_block->size);
+  Tree::remove(&freeLists_[listIndex], _block);
+  addresses_.remove(_block);
+
+  // mark the list as empty if this was the last block
+  if (freeLists_[listIndex] == nullptr) {
+    freeListMask_ &= ~((u64)1 << listIndex);
+  }
+}
+
+template <typename Classes>
+Block* BasicBestFit<Classes>::find(u64 _pages) const {
+  // the list of the requested size may hold blocks that are too small, so
+  //  search its tree for the smallest block large enough
+  u64 listIndex = classes_.index(_pages);
+  PALLOC_STAT(search_.probes++);
+  Block* block = lowerBound(freeLists_[listIndex], _pages);
+
+  // every block in a higher list is large enough, the first non-empty
+  //  higher list is found with a single bit scan of the mask
+  if (block == nullptr) {
+    u64 higher = (listIndex == 63) ? 0 :
+        (freeListMask_ & (U64_MAX << (listIndex + 1)));
+    if (higher != 0) {
+      listIndex = (u64)__builtin_ctzll(higher);
+      PALLOC_STAT(search_.probes++);
+      block = lowerBound(freeLists_[listIndex], _pages);
+    }
+  }
+  assert(block == nullptr || block->used == false);
+  return block;
+}
+
+template <typename Classes>
+Block* BasicBestFit<Classes>::findAligned(u64 _pages, u64 _alignment,
+                                          u64* _base) const {
+  // any block this large holds an aligned range, use the best fitting one
+  u64 guaranteed = _pages + minBlockSize_ + _alignment - 1;
+  if (guaranteed > _pages) {
+    Block* block = find(guaranteed);
+    if (block != nullptr) {
+      *_base = alignedBase(block, _pages, _alignment, minBlockSize_);
+      assert(*_base != INV);
+      return block;
+    }
+  } else {
+    guaranteed = U64_MAX;
+  }
+
+  // otherwise only the smaller blocks of the lists up to the guaranteed size
+  //  can hold an aligned range, check a bounded number of them in size order
+  u64 probes = kAlignedProbes;
+  u64 lastIndex = classes_.index(guaranteed);
+  for (u64 listIndex = classes_.index(_pages); listIndex <= lastIndex;
+       listIndex++) {
+    if ((freeListMask_ & ((u64)1 << listIndex)) == 0) {
+      continue;
+    }
+    PALLOC_STAT(search_.probes++);
+    for (Block* block = lowerBound(freeLists_[listIndex], _pages);
+         block != nullptr && block->size < guaranteed;
+         block = Tree::next(block)) {
+      PALLOC_STAT(search_.walked++);
+      *_base = alignedBase(block, _pages, _alignment, minBlockSize_);
+      if (*_base != INV) {
+        return block;
+      }
+      if (--probes == 0) {
+        return nullptr;
+      }
+    }
+  }
+  return nullptr;
+}
+
+template <typename Classes>
+u64 BasicBestFit<Classes>::largest() const {
+  // the largest block is the last of the highest non-empty list
+  if (freeListMask_ == 0) {
+    return 0;
+  }
+  Block* block = freeLists_[63 - __builtin_clzll(freeListMask_)];
+  while (block->right != nullptr) {
+    block = block->right;
+  }
+  return block->size;
+}
+
+template <typename Classes>
+Block* BasicBestFit<Classes>::floor(u64 _page) const {
+  PALLOC_STAT(search_.probes++);
+  return addresses_.floor(_page);
+}
+
+template <typename Classes>
+bool BasicBestFit<Classes>::resize(u64 _pages) {
+  u64 oldCount = classes_.count();
+  if (!classes_.resize(_pages)) {
+    return false;
+  }
+  u64 count = classes_.count();
+
+  if (count > oldCount) {
+    // only the blocks of the old last class that exceed its new limit move
+    //  up into the new classes
+    resizeLists(&freeLists_, count);
+    Block* block = lowerBound(freeLists_[oldCount - 1],
+                              classes_.limit(oldCount - 1) + 1);
+    while (block != nullptr) {
+      Block* next = Tree::next(block);
+      refile(oldCount - 1, block);
+      block = next;
+    }
+  } else if (count < oldCount) {
+    // the blocks of the removed classes merge into the new last class
+    for (u64 listIndex = count; listIndex < oldCount; listIndex++) {
+      while (freeLists_[listIndex] != nullptr) {
+        refile(listIndex, freeLists_[listIndex]);
+      }
+    }
+    resizeLists(&freeLists_, count);
+  }
+  return true;
+}
+
+template <typename Classes>
+SearchCount BasicBestFit<Classes>::takeSearchCount() const {
+  SearchCount count = search_;
+  search_ = {0, 0};
+  return count;
+}
+
+template <typename Classes>
+u64 BasicBestFit<Classes>::metadataBytes() const {
+  return listBytes(freeLists_) + addresses_.metadataBytes();
+}
+
+template <typename Classes>
+u64 BasicBestFit<Classes>::verify(bool _print) const {
+  // print free lists
+  if (_print) {
+    printf("free lists:\n");
+  }
+  u64 count = 0;
+  for (u64 listIndex = 0; listIndex < classes_.count(); listIndex++) {
+    u64 listSize = classes_.limit(listIndex);
+    if (_print) {
+      printf("listIndex=%lu listSize=%lu\n", listIndex, listSize);
+    }
+    Block* root = freeLists_.at(listIndex);
+    assert(root == nullptr || root->parent == nullptr);
+    u64 treeCount = Tree::verify(root);
+    (void)treeCount;  // unused
+    Block* last = nullptr;
+    for (Block* block = Tree::first(root); block != nullptr;
+         block = Tree::next(block)) {
+      count++;
+      if (_print) {
+        printf("this=0x%lX base=%lu size=%lu used=%u prev=0x%lX next=0x%lX\n",
+               (u64)block, block->base, block->size, block->used,
+               (u64)block->prev, (u64)block->next);
+      }
+      assert(block->used == false);
+      assert(block->quick == false);
+      assert(block->size <= listSize);
+      assert(classes_.index(block->size) == listIndex);
+      assert(last == nullptr || SizeOrder::less(last, block));
+      last = block;
+      treeCount--;
+    }
+    (void)last;  // unused
+    assert(treeCount == 0);
+    assert(((freeListMask_ >> listIndex) & 1) == (root == nullptr ? 0 : 1));
+  }
+
+  // check the address index holds as many blocks in page order
+  u64 addressCount = addresses_.verify();
+  (void)addressCount;  // unused
+  assert(addressCount == count);
+  return count;
+}
+
+/*** private below here ***/
+
+template <typename Classes>
+bool BasicBestFit<Classes>::SizeOrder::less(const Block* _a,
+                                            const Block* _b) {
+  // free blocks are ordered by size then by base
+  return (_a->size < _b->size) ||
+      (_a->size == _b->size && _a->base < _b->base);
+}
+
+
+template <typename Classes>
+Block* BasicBestFit<Classes>::lowerBound(Block* _root, u64 _pages) const {
+  // find the smallest block with at least '_pages' pages
+  Block* best = nullptr;
+  while (_root != nullptr) {
+    PALLOC_STAT(search_.walked++);
+    if (_root->size >= _pages) {
+      best = _root;
+      _root = _root->left;
+    } else {
+      _root = _root->right;
+    }
+  }
+  return best;
+}
+
+template <typename Classes>
+void BasicBestFit<Classes>::refile(u64 _from, Block* _block) {
+  // the address index is unaffected
+  Tree::remove(&freeLists_[_from], _block);
+  if (freeLists_[_from] == nullptr) {
+    freeListMask_ &= ~((u64)1 << _from);
+  }
+  u64 listIndex = classes_.index(_block->size);
+  Tree::insert(&freeLists_[listIndex], _block);
+  freeListMask_ |= (u64)1 << listIndex;
+}
+
+template <typename Classes>
+void BasicBestFit<Classes>::makeLists(std::vector<Block*>* _lists,
+                                      u64 _count) {
+  _lists->assign(_count, nullptr);
+}
+
+template <typename Classes>
+template <size_t N>
+void BasicBestFit<Classes>::makeLists(std::array<Block*, N>* _lists,
+                                      u64 _count) {
+  assert(_count == N);
+  (void)_count;  // unused
+  _lists->fill(nullptr);
+}
+
+template <typename Classes>
+void BasicBestFit<Classes>::resizeLists(std::vector<Block*>* _lists,
+                                        u64 _count) {
+  _lists->resize(_count, nullptr);
+}
+
+template <typename Classes>
+template <size_t N>
+void BasicBestFit<Classes>::resizeLists(std::array<Block*, N>* _lists,
+                                        u64 _count) {
+  // fixed classes never change their count
+  assert(_count == N);
+  (void)_lists;  // unused
+  (void)_count;  // unused
+}
+
+template <typename Classes>
+u64 BasicBestFit<Classes>::listBytes(const std::vector<Block*>& _lists) {
+  return _lists.capacity() * sizeof(Block*);
+}
+
+template <typename Classes>
+template <size_t N>
+u64 BasicBestFit<Classes>::listBytes(const std::array<Block*, N>& _lists) {
+  // the roots are held in the policy
+  (void)_lists;  // unused
+  return 0;
+}
+
+}  // namespace palloc
@@ -0,0 +1,179 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/Bitmap.h"
+
+#include <cassert>
+
+#include <algorithm>
+
+#include "palloc/Block.h"
+
+namespace palloc {
+
+Bitmap::Bitmap(u64 _bits)
+    : bits_(_bits) {
+  // add levels until a level fits in one word
+  u64 bits = bits_;
+  do {
+    u64 words = (bits + 63) / 64;
+    levels_.push_back(std::vector<u64>(words == 0 ? 1 : words, 0));
+    bits = words;
+  } while (bits > 1);
+}
+
+u64 Bitmap::size() const {
+  return bits_;
+}
+
+bool Bitmap::test(u64 _bit) const {
+  assert(_bit < bits_);
+  return (levels_[0][_bit / 64] >> (_bit % 64)) & 1;
+}
+
+void Bitmap::set(u64 _bit) {
+  assert(_bit < bits_);
+  setAt(0, _bit);
+}
+
+void Bitmap::clear(u64 _bit) {
+  assert(_bit < bits_);
+  clearAt(0, _bit);
+}
+
+void Bitmap::setRange(u64 _bit, u64 _count) {
+  assert(_bit + _count <= bits_);
+  // whole words at a time, only words that were zero change the summaries
+  while (_count > 0) {
+    u64 offset = _bit % 64;
+    u64 take = std::min(_count, 64 - offset);
+    u64 mask = (take == 64 ? U64_MAX : ((u64)1 << take) - 1) << offset;
+    u64& word = levels_[0][_bit / 64];
+    bool wasZero = word == 0;
+    word |= mask;
+    if (wasZero && levels_.size() > 1) {
+      setAt(1, _bit / 64);
+    }
+    _bit += take;
+    _count -= take;
+  }
+}
+
+void Bitmap::clearRange(u64 _bit, u64 _count) {
+  assert(_bit + _count <= bits_);
+  // whole words at a time, only words that become zero change the summaries
+  while (_count > 0) {
+    u64 offset = _bit % 64;
+    u64 take = std::min(_count, 64 - offset);
+    u64 mask = (take == 64 ? U64_MAX : ((u64)1 << take) - 1) << offset;
+    u64& word = levels_[0][_bit / 64];
+    bool wasZero = word == 0;
+    word &= ~mask;
+    if (!wasZero && word == 0 && levels_.size() > 1) {
+      clearAt(1, _bit / 64);
+    }
+    _bit += take;
+    _count -= take;
+  }
+}
+
+bool Bitmap::any() const {
+  return levels_.back()[0] != 0;
+}
+
+u64 Bitmap::findNext(u64 _bit) const {
+  if (_bit >= bits_) {
+    return INV;
+  }
+  return findNextAt(0, _bit);
+}
+
+const std::vector<u64>& Bitmap::words() const {
+  return levels_[0];
+}
+
+u64 Bitmap::metadataBytes() const {
+  u64 bytes = levels_.capacity() * sizeof(std::vector<u64>);
+  for (const std::vector<u64>& level : levels_) {
+    bytes += level.capacity() * sizeof(u64);
+  }
+  return bytes;
+}
+
+void Bitmap::setAt(u64 _level, u64 _bit) {
+  // summary bits only change when a word goes from zero to non-zero
+  for (u64 level = _level; level < levels_.size(); level++) {
+    u64& word = levels_[level][_bit / 64];
+    bool wasZero = word == 0;
+    word |= (u64)1 << (_bit % 64);
+    if (!wasZero) {
+      break;
+    }
+    _bit /= 64;
+  }
+}
+
+void Bitmap::clearAt(u64 _level, u64 _bit) {
+  // summary bits only change when a word goes from non-zero to zero
+  for (u64 level = _level; level < levels_.size(); level++) {
+    u64& word = levels_[level][_bit / 64];
+    word &= ~((u64)1 << (_bit % 64));
+    if (word != 0) {
+      break;
+    }
+    _bit /= 64;
+  }
+}
+
+u64 Bitmap::findNextAt(u64 _level, u64 _bit) const {
+  const std::vector<u64>& words = levels_[_level];
+  u64 index = _bit / 64;
+  if (index >= words.size()) {
+    return INV;
+  }
+
+  // check the rest of the word holding the bit
+  u64 word = words[index] & (U64_MAX << (_bit % 64));
+  if (word != 0) {
+    return index * 64 + __builtin_ctzll(word);
+  }
+
+  // otherwise the summary above finds the next non-zero word
+  if (_level + 1 == levels_.size()) {
+    return INV;
+  }
+  index = findNextAt(_level + 1, index + 1);
+  if (index == INV) {
+    return INV;
+  }
+  return index * 64 + __builtin_ctzll(words[index]);
+}
+
+}  // namespace palloc
@@ -0,0 +1,97 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_BITMAP_H_
+#define PALLOC_BITMAP_H_
+
+#include <prim/prim.h>
+
+#include <vector>
+
+namespace palloc {
+
+/*
+ * This is a hierarchical bitmap. Above the bits there are summary levels
+ * where bit 'i' is set when word 'i' of the level below is non-zero, up to a
+ * single top word, so setting, clearing, and finding the next set bit all
+ * take O(log64 bits) word operations.
+ */
+
+class Bitmap {
+ public:
+  // all bits start clear
+  explicit Bitmap(u64 _bits);
+
+  // returns the number of bits
+  u64 size() const;
+
+  // returns true if the bit is set
+  bool test(u64 _bit) const;
+
+  // sets a bit
+  void set(u64 _bit);
+
+  // clears a bit
+  void clear(u64 _bit);
+
+  // sets '_count' bits starting at '_bit'
+  void setRange(u64 _bit, u64 _count);
+
+  // clears '_count' bits starting at '_bit'
+  void clearRange(u64 _bit, u64 _count);
+
+  // returns true if any bit is set
+  bool any() const;
+
+  // returns the first set bit at or after '_bit', INV if none
+  u64 findNext(u64 _bit) const;
+
+  // returns the words holding the bits, bit 'i' is bit 'i % 64' of word
+  //  'i / 64' and the bits past size() are clear
+  const std::vector<u64>& words() const;
+
+  // returns the number of bytes of heap memory used by the bitmap
+  u64 metadataBytes() const;
+
+ private:
+  // these set or clear a bit of a level and update the summaries above it
+  void setAt(u64 _level, u64 _bit);
+  void clearAt(u64 _level, u64 _bit);
+
+  // this returns the first set bit of a level at or after '_bit', INV if none
+  u64 findNextAt(u64 _level, u64 _bit) const;
+
+  const u64 bits_;
+  std::vector<std::vector<u64> > levels_;  // the bits then the summaries
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_BITMAP_H_
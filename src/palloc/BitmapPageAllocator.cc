@@ -0,0 +1,327 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/BitmapPageAllocator.h"
+
+#include <ex/Exception.h>
+
+#include <cassert>
+#include <cstdio>
+
+#include <algorithm>
+
+#include "palloc/Block.h"
+
+namespace palloc {
+
+BitmapPageAllocator::BitmapPageAllocator(u64 _pages, u64 _minBlockSize)
+    : pages_(_pages), minBlockSize_(_minBlockSize),
+      fullWords_(selectFullWords()), freeMap_(_pages), endMap_(_pages),
+      freeBlocks_(1), usedBlocks_(0), freePages_(_pages), usedPages_(0) {
+  // check input parameters
+  if (minBlockSize_ == 0 || minBlockSize_ > pages_) {
+    throw new ex::Exception("minBlockSize must be > 0 and "
+                            "minBlockSize <= pages");
+  }
+
+  // all pages start free
+  freeMap_.setRange(0, pages_);
+}
+
+BitmapPageAllocator::~BitmapPageAllocator() {}
+
+u64 BitmapPageAllocator::createBlock(u64 _pages) {
+  // bail out if user is asking for nothing or too much
+  if (_pages == 0 || _pages > pages_) {
+    return INV;
+  }
+
+  // find the first run that fits
+  u64 pages = std::max(_pages, minBlockSize_);
+  u64 base = findRun(pages);
+  if (base == INV) {
+    return INV;
+  }
+  freeMap_.clearRange(base, pages);
+  endMap_.set(base + pages - 1);
+
+  // perform accounting, the free run remains on the sides that are free
+  freeBlocks_ += isFree(base - 1) + isFree(base + pages) - 1;
+  usedBlocks_ += 1;
+  freePages_ -= pages;
+  usedPages_ += pages;
+
+  return base;
+}
+
+bool BitmapPageAllocator::freeBlock(u64 _block) {
+  // check if the block is a valid used block
+  if (!isUsedBase(_block)) {
+    return false;
+  }
+  u64 end = endMap_.findNext(_block);
+  u64 pages = end - _block + 1;
+  endMap_.clear(end);
+  freeMap_.setRange(_block, pages);
+
+  // perform accounting, free neighbors merge with the block
+  freeBlocks_ += 1 - isFree(_block - 1) - isFree(end + 1);
+  usedBlocks_ -= 1;
+  freePages_ += pages;
+  usedPages_ -= pages;
+
+  return true;
+}
+
+bool BitmapPageAllocator::shrinkBlock(u64 _block, u64 _pages) {
+  // check if the block is a valid used block
+  if (!isUsedBase(_block)) {
+    return false;
+  }
+  u64 end = endMap_.findNext(_block);
+  u64 size = end - _block + 1;
+
+  // check easy cases
+  if (_pages > size) {
+    // can't grow
+    return false;
+  } else if (_pages == 0) {
+    // zero is free
+    return freeBlock(_block);
+  }
+  u64 pages = std::max(_pages, minBlockSize_);
+  if (size - pages < minBlockSize_) {
+    // the remainder is too small to free
+    return true;
+  }
+
+  // free the tail, it merges with a free next block
+  endMap_.clear(end);
+  endMap_.set(_block + pages - 1);
+  freeMap_.setRange(_block + pages, size - pages);
+
+  // perform accounting
+  freeBlocks_ += 1 - isFree(end + 1);
+  freePages_ += size - pages;
+  usedPages_ -= size - pages;
+
+  return true;
+}
+
+bool BitmapPageAllocator::growBlock(u64 _block, u64 _pages) {
+  // check if the block is a valid used block
+  if (!isUsedBase(_block)) {
+    return false;
+  }
+  u64 end = endMap_.findNext(_block);
+  u64 size = end - _block + 1;
+
+  // check easy cases
+  if (_pages <= size) {
+    // can't shrink, but user might already have more than they asked for
+    return true;
+  } else if (_pages > pages_ - _block) {
+    return false;
+  }
+
+  // the following free run must hold the extra pages
+  u64 extra = _pages - size;
+  if (!isFree(end + 1) || runLength(end + 1, extra) < extra) {
+    return false;
+  }
+  freeMap_.clearRange(end + 1, extra);
+  endMap_.clear(end);
+  endMap_.set(_block + _pages - 1);
+
+  // perform accounting, the free run is gone if it was consumed whole
+  freeBlocks_ -= 1 - isFree(_block + _pages);
+  freePages_ -= extra;
+  usedPages_ += extra;
+
+  return true;
+}
+
+u64 BitmapPageAllocator::blockSize(u64 _block) const {
+  if (!isUsedBase(_block)) {
+    return 0;
+  }
+  return endMap_.findNext(_block) - _block + 1;
+}
+
+u64 BitmapPageAllocator::totalBlocks() const {
+  return freeBlocks_ + usedBlocks_;
+}
+
+u64 BitmapPageAllocator::freeBlocks() const {
+  return freeBlocks_;
+}
+
+u64 BitmapPageAllocator::usedBlocks() const {
+  return usedBlocks_;
+}
+
+u64 BitmapPageAllocator::totalPages() const {
+  return pages_;
+}
+
+u64 BitmapPageAllocator::freePages() const {
+  return freePages_;
+}
+
+u64 BitmapPageAllocator::usedPages() const {
+  return usedPages_;
+}
+
+u64 BitmapPageAllocator::metadataBytes() const {
+  return freeMap_.metadataBytes() + endMap_.metadataBytes();
+}
+
+void BitmapPageAllocator::verify(bool _print) const {
+  // scan all blocks in page order
+  if (_print) {
+    printf("blocks in page order:\n");
+  }
+  u64 freeCount = 0;
+  u64 usedCount = 0;
+  u64 freePages = 0;
+  u64 usedPages = 0;
+  u64 page = 0;
+  while (page < pages_) {
+    u64 size;
+    bool used = !freeMap_.test(page);
+    if (used) {
+      // a used block ends at its end bit and has no free pages
+      u64 end = endMap_.findNext(page);
+      assert(end != INV);
+      size = end - page + 1;
+      assert(freeMap_.findNext(page) == INV ||
+             freeMap_.findNext(page) > end);
+      assert(isUsedBase(page));
+      usedCount++;
+      usedPages += size;
+    } else {
+      // a free block has no end bits and ends at a used page
+      size = runLength(page, pages_);
+      assert(endMap_.findNext(page) == INV ||
+             endMap_.findNext(page) >= page + size);
+      freeCount++;
+      freePages += size;
+    }
+    if (_print) {
+      printf("base=%lu size=%lu used=%u\n", page, size, used);
+    }
+    page += size;
+  }
+  assert(page == pages_);
+
+  // verify the counters
+  assert(freeCount == freeBlocks_);
+  assert(usedCount == usedBlocks_);
+  assert(freePages == freePages_);
+  assert(usedPages == usedPages_);
+  assert(freePages_ + usedPages_ == pages_);
+  (void)freeCount;  // unused
+  (void)usedCount;  // unused
+  (void)freePages;  // unused
+  (void)usedPages;  // unused
+}
+
+bool BitmapPageAllocator::isUsedBase(u64 _block) const {
+  // a used page whose previous page is free or ends a used block
+  return _block < pages_ && !freeMap_.test(_block) &&
+      (_block == 0 || freeMap_.test(_block - 1) ||
+       endMap_.test(_block - 1));
+}
+
+bool BitmapPageAllocator::isFree(u64 _page) const {
+  // page INV (i.e., before page 0) wraps around to past the end
+  return _page < pages_ && freeMap_.test(_page);
+}
+
+u64 BitmapPageAllocator::findRun(u64 _pages) const {
+  const std::vector<u64>& words = freeMap_.words();
+  for (u64 page = freeMap_.findNext(0); page != INV;) {
+    u64 idx = page / 64;
+    u64 word = words[idx];
+    if (_pages <= 64) {
+      // runs within the word
+      u64 starts = runStarts(word & (U64_MAX << (page % 64)), _pages);
+      if (starts != 0) {
+        return idx * 64 + __builtin_ctzll(starts);
+      }
+
+      // only a run reaching the top of the word can continue into the next
+      //  word, skip to its start
+      if ((word >> 63) == 0) {
+        page = freeMap_.findNext((idx + 1) * 64);
+        continue;
+      }
+      u64 top = ~word == 0 ? 64 : __builtin_clzll(~word);
+      page = std::max(page, idx * 64 + 64 - top);
+    }
+
+    // measure the run across words
+    u64 run = runLength(page, _pages);
+    if (run >= _pages) {
+      return page;
+    }
+    page = freeMap_.findNext(page + run);
+  }
+  return INV;
+}
+
+u64 BitmapPageAllocator::runLength(u64 _page, u64 _limit) const {
+  const std::vector<u64>& words = freeMap_.words();
+  u64 idx = _page / 64;
+  u64 offset = _page % 64;
+
+  // the run within the first word
+  u64 inverse = ~(words[idx] >> offset);
+  u64 run = inverse == 0 ? 64 : __builtin_ctzll(inverse);
+  if (run < 64 - offset) {
+    return run;
+  }
+
+  // whole free words then the free bits at the bottom of the next word, the
+  //  bits past the last page are clear so the run stops there
+  idx++;
+  if (run < _limit && idx < words.size()) {
+    u64 want = std::min((_limit - run + 63) / 64, (u64)words.size() - idx);
+    u64 full = fullWords_(&words[idx], want);
+    run += full * 64;
+    idx += full;
+    if (full < want) {
+      run += __builtin_ctzll(~words[idx]);
+    }
+  }
+  return run;
+}
+
+}  // namespace palloc
@@ -0,0 +1,138 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_BITMAPPAGEALLOCATOR_H_
+#define PALLOC_BITMAPPAGEALLOCATOR_H_
+
+#include <prim/prim.h>
+
+#include "palloc/Bitmap.h"
+#include "palloc/WordScan.h"
+
+namespace palloc {
+
+/*
+ * This is a bitmap page allocator with the same interface as PageAllocator
+ * for pools of mostly small blocks. There is no per block metadata: a free
+ * map has a bit set per free page and an end map has a bit set at the last
+ * page of each used block, so the metadata is about 2 bits per page plus
+ * the Bitmap summaries. Blocks are placed first fit.
+ *
+ * The free map summaries skip used words and runs of up to 64 pages are
+ * found within a word with shifts, a run continuing past its word is
+ * measured a vector of words at a time (see WordScan.h) with the widest
+ * scan the CPU supports. Counting free blocks only checks the neighbors of
+ * a changed block so all counters are kept in constant time.
+ */
+
+class BitmapPageAllocator {
+ public:
+  // requests are rounded up to '_minBlockSize' pages
+  BitmapPageAllocator(u64 _pages, u64 _minBlockSize);
+  ~BitmapPageAllocator();
+
+  // allocates a block
+  //  returns the base page of the block
+  u64 createBlock(u64 _pages);
+
+  // frees an allocated block
+  //  returns true if success, false otherwise
+  bool freeBlock(u64 _block);
+
+  // shrinks an allocated block
+  //  'pages' is the total requested size
+  //  returns true if success, false otherwise
+  bool shrinkBlock(u64 _block, u64 _pages);
+
+  // grows an allocated block in place into the following free pages
+  //  'pages' is the total requested size
+  //  returns true if success, false otherwise
+  bool growBlock(u64 _block, u64 _pages);
+
+  // returns the number of pages in the used block starting at '_block',
+  //  zero if there is no such block
+  u64 blockSize(u64 _block) const;
+
+  // returns the total number of blocks
+  u64 totalBlocks() const;
+
+  // returns the number of free blocks
+  u64 freeBlocks() const;
+
+  // returns the number of used blocks
+  u64 usedBlocks() const;
+
+  // returns the total number of pages
+  u64 totalPages() const;
+
+  // returns the number of free pages
+  u64 freePages() const;
+
+  // returns the number of used pages
+  u64 usedPages() const;
+
+  // returns the number of bytes of metadata held by the allocator
+  u64 metadataBytes() const;
+
+  // verify internal data structures
+  void verify(bool _print) const;
+
+ private:
+  // this returns true if a used block starts at '_block'
+  bool isUsedBase(u64 _block) const;
+
+  // this returns true if '_page' is a free page, false if used or past the
+  //  end
+  bool isFree(u64 _page) const;
+
+  // this returns the lowest base page of a run of '_pages' free pages, INV
+  //  if none
+  u64 findRun(u64 _pages) const;
+
+  // this returns the length of the free run starting at '_page', it stops
+  //  counting once the length reaches '_limit'
+  u64 runLength(u64 _page, u64 _limit) const;
+
+  const u64 pages_;
+  const u64 minBlockSize_;
+  const FullWordsFunc fullWords_;
+
+  Bitmap freeMap_;  // bit per free page
+  Bitmap endMap_;  // bit at the last page of each used block
+
+  u64 freeBlocks_;
+  u64 usedBlocks_;
+  u64 freePages_;
+  u64 usedPages_;
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_BITMAPPAGEALLOCATOR_H_
@@ -0,0 +1,148 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/BitmapPageAllocator.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <random>
+#include <vector>
+
+#include "palloc/Block.h"
+#include "palloc/PageAllocator.h"
+
+TEST(BitmapPageAllocator, basic) {
+  palloc::BitmapPageAllocator pa(1000, 1);
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  ASSERT_EQ(pa.freePages(), 1000u);
+  ASSERT_LT(pa.metadataBytes(), 1000u / 2);
+
+  u64 b0 = pa.createBlock(10);
+  u64 b1 = pa.createBlock(60);
+  u64 b2 = pa.createBlock(100);
+  u64 b3 = pa.createBlock(1);
+  ASSERT_EQ(b0, 0u);
+  ASSERT_EQ(b1, 10u);
+  ASSERT_EQ(b2, 70u);
+  ASSERT_EQ(b3, 170u);
+  ASSERT_EQ(pa.blockSize(b1), 60u);
+  ASSERT_EQ(pa.blockSize(b1 + 1), 0u);
+  pa.verify(false);
+  ASSERT_EQ(pa.createBlock(0), palloc::INV);
+  ASSERT_EQ(pa.createBlock(830), palloc::INV);
+
+  // holes are reused first fit
+  ASSERT_FALSE(pa.freeBlock(b1 + 1));
+  ASSERT_TRUE(pa.freeBlock(b1));
+  ASSERT_FALSE(pa.freeBlock(b1));
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+  ASSERT_TRUE(pa.freeBlock(b0));
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+  ASSERT_EQ(pa.createBlock(70), 0u);
+  ASSERT_TRUE(pa.freeBlock(b2));
+  ASSERT_EQ(pa.createBlock(101), 171u);
+  ASSERT_EQ(pa.createBlock(100), 70u);
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  ASSERT_EQ(pa.usedBlocks(), 4u);
+}
+
+TEST(BitmapPageAllocator, resize) {
+  palloc::BitmapPageAllocator pa(512, 2);
+  u64 b0 = pa.createBlock(1);
+  ASSERT_EQ(pa.blockSize(b0), 2u);
+  u64 b1 = pa.createBlock(200);
+  ASSERT_EQ(b1, 2u);
+
+  // the tail is freed unless it is too small
+  ASSERT_FALSE(pa.shrinkBlock(b1, 201));
+  ASSERT_TRUE(pa.shrinkBlock(b1, 199));
+  ASSERT_EQ(pa.blockSize(b1), 200u);
+  ASSERT_TRUE(pa.shrinkBlock(b1, 100));
+  ASSERT_EQ(pa.blockSize(b1), 100u);
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  ASSERT_EQ(pa.freePages(), 410u);
+
+  // growing takes the following free pages
+  u64 b2 = pa.createBlock(10);
+  ASSERT_EQ(b2, 102u);
+  ASSERT_TRUE(pa.shrinkBlock(b1, 50));
+  ASSERT_TRUE(pa.growBlock(b1, 20));
+  ASSERT_TRUE(pa.growBlock(b1, 80));
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+  ASSERT_TRUE(pa.growBlock(b1, 100));
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  ASSERT_FALSE(pa.growBlock(b1, 101));
+  ASSERT_TRUE(pa.growBlock(b2, 410));
+  ASSERT_FALSE(pa.growBlock(b2, 411));
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 0u);
+  ASSERT_TRUE(pa.shrinkBlock(b2, 0));
+  ASSERT_TRUE(pa.freeBlock(b0));
+  ASSERT_TRUE(pa.freeBlock(b1));
+  pa.verify(false);
+  ASSERT_EQ(pa.totalBlocks(), 1u);
+}
+
+TEST(BitmapPageAllocator, firstFit) {
+  // with a minimum block size of 1 the placement matches first fit
+  const u64 kPages = 20000;
+  palloc::BitmapPageAllocator pa(kPages, 1);
+  palloc::FirstFitPageAllocator ref(kPages, 1);
+  std::vector<u64> blocks;
+  std::mt19937_64 rnd(12345);
+  for (u64 iter = 0; iter < 40000; iter++) {
+    if (blocks.empty() || rnd() % 5 < 3) {
+      u64 pages = rnd() % 10 == 0 ? 1 + rnd() % 500 : 1 + rnd() % 64;
+      u64 base = pa.createBlock(pages);
+      ASSERT_EQ(base, ref.createBlock(pages));
+      if (base != palloc::INV) {
+        blocks.push_back(base);
+      }
+    } else {
+      u64 pick = rnd() % blocks.size();
+      ASSERT_TRUE(pa.freeBlock(blocks.at(pick)));
+      ASSERT_TRUE(ref.freeBlock(blocks.at(pick)));
+      blocks.at(pick) = blocks.back();
+      blocks.pop_back();
+    }
+    ASSERT_EQ(pa.freeBlocks(), ref.freeBlocks());
+    ASSERT_EQ(pa.freePages(), ref.freePages());
+    if (iter % 4000 == 0) {
+      pa.verify(false);
+    }
+  }
+  pa.verify(false);
+}
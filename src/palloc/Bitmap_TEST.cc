@@ -0,0 +1,104 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/Bitmap.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <random>
+#include <set>
+
+#include "palloc/Block.h"
+
+TEST(Bitmap, basic) {
+  palloc::Bitmap bitmap(100);
+  ASSERT_EQ(bitmap.size(), 100u);
+  ASSERT_FALSE(bitmap.any());
+  ASSERT_EQ(bitmap.findNext(0), palloc::INV);
+  bitmap.set(70);
+  bitmap.set(3);
+  ASSERT_TRUE(bitmap.any());
+  ASSERT_TRUE(bitmap.test(3));
+  ASSERT_FALSE(bitmap.test(4));
+  ASSERT_EQ(bitmap.findNext(0), 3u);
+  ASSERT_EQ(bitmap.findNext(3), 3u);
+  ASSERT_EQ(bitmap.findNext(4), 70u);
+  ASSERT_EQ(bitmap.findNext(71), palloc::INV);
+  ASSERT_EQ(bitmap.findNext(100), palloc::INV);
+  ASSERT_EQ(bitmap.words().at(1), (u64)1 << 6);
+  bitmap.clear(3);
+  bitmap.clear(70);
+  ASSERT_FALSE(bitmap.any());
+
+  palloc::Bitmap one(1);
+  ASSERT_EQ(one.findNext(0), palloc::INV);
+  one.set(0);
+  ASSERT_EQ(one.findNext(0), 0u);
+}
+
+TEST(Bitmap, random) {
+  // three summary levels
+  const u64 kBits = 300000;
+  palloc::Bitmap bitmap(kBits);
+  std::set<u64> bits;
+  std::mt19937_64 rnd(12345);
+  for (u64 iter = 0; iter < 20000; iter++) {
+    u64 bit = rnd() % kBits;
+    if (rnd() % 2 == 0) {
+      bitmap.set(bit);
+      bits.insert(bit);
+    } else {
+      bitmap.clear(bit);
+      bits.erase(bit);
+    }
+    ASSERT_EQ(bitmap.any(), !bits.empty());
+    u64 from = rnd() % kBits;
+    std::set<u64>::const_iterator it = bits.lower_bound(from);
+    ASSERT_EQ(bitmap.findNext(from), it == bits.end() ? palloc::INV : *it);
+  }
+}
+
+TEST(Bitmap, ranges) {
+  palloc::Bitmap bitmap(5000);
+  bitmap.setRange(60, 4000);
+  ASSERT_EQ(bitmap.findNext(0), 60u);
+  ASSERT_TRUE(bitmap.test(4059));
+  ASSERT_FALSE(bitmap.test(4060));
+  bitmap.clearRange(100, 3950);
+  ASSERT_EQ(bitmap.findNext(61), 61u);
+  ASSERT_EQ(bitmap.findNext(100), 4050u);
+  bitmap.clearRange(60, 40);
+  bitmap.clearRange(4050, 10);
+  ASSERT_FALSE(bitmap.any());
+  bitmap.setRange(4999, 1);
+  bitmap.setRange(0, 0);
+  ASSERT_EQ(bitmap.findNext(0), 4999u);
+}
@@ -0,0 +1,57 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/Block.h"
+
+namespace palloc {
+
+Block::Block(u64 _base, u64 _size, bool _used, Block* _prev, Block* _next)
+    : base(_base), size(_size), used(_used), quick(false), linked(false),
+      cached(false), prev(_prev), next(_next), parent(nullptr), left(nullptr),
+      right(nullptr), maxSize(_size) {}
+
+u64 alignedBase(const Block* _block, u64 _pages, u64 _alignment,
+                u64 _minBlockSize) {
+  // round up to the alignment, a leading remainder must be a valid block
+  u64 mask = _alignment - 1;
+  u64 base = (_block->base + mask) & ~mask;
+  if (base > _block->base && base - _block->base < _minBlockSize) {
+    base = (_block->base + _minBlockSize + mask) & ~mask;
+  }
+
+  // check that the aligned range fits in the block
+  u64 end = _block->base + _block->size;
+  if (base > end || end - base < _pages) {
+    return INV;
+  }
+  return base;
+}
+
+}  // namespace palloc
@@ -0,0 +1,70 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_BLOCK_H_
+#define PALLOC_BLOCK_H_
+
+#include <prim/prim.h>
+
+namespace palloc {
+
+const u64 INV = U64_MAX;
+
+// the metadata of a contiguous range of pages
+struct Block {
+  Block(u64 _base, u64 _size, bool _used, Block* _prev, Block* _next);
+  u64 base;  // starting page
+  u64 size;  // number of pages
+  bool used;
+  bool quick;  // free and in a quick list (left/right are the links)
+  bool linked;  // free and in the placement index or a quick list
+  bool cached;  // used and held by a front end cache (see
+                //  ConcurrentPageAllocator.h), the allocator ignores it
+  Block* prev;  // previous block in page order
+  Block* next;  // next block in page order
+  Block* parent;  // free index tree links, owned by the placement policy
+  Block* left;  //  while free and by the allocator's used index while used
+  Block* right;
+  u64 maxSize;  // largest size in the free index subtree (if maintained)
+};
+
+// the most blocks an aligned search checks that are too small to surely
+//  hold the aligned range, bounding the search when no block is that large
+const u64 kAlignedProbes = 64;
+
+// returns the lowest base page in a free block that is a multiple of
+//  '_alignment' and leaves either no leading pages or a leading free block of
+//  at least '_minBlockSize' pages, INV if the aligned range doesn't fit
+u64 alignedBase(const Block* _block, u64 _pages, u64 _alignment,
+                u64 _minBlockSize);
+
+}  // namespace palloc
+
+#endif  // PALLOC_BLOCK_H_
@@ -0,0 +1,386 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/BuddyPageAllocator.h"
+
+#include <bits/bits.h>
+#include <ex/Exception.h>
+
+#include <cassert>
+#include <cstdio>
+
+#include "palloc/Block.h"
+
+namespace palloc {
+
+BuddyPageAllocator::BuddyPageAllocator(u64 _pages, u64 _minBlockSize)
+    : pages_(_pages), minBlockSize_(_minBlockSize),
+      unitShift_(_minBlockSize == 0 ? 0 :
+                 __builtin_ctzll(bits::ceilPow2(_minBlockSize))),
+      units_(_pages >> unitShift_), freeOrderMask_(0),
+      usedOrders_(units_, 0), freeBlocks_(0), usedBlocks_(0),
+      freePages_(_pages), usedPages_(0) {
+  // check input parameters
+  if (minBlockSize_ == 0 || minBlockSize_ > pages_) {
+    throw new ex::Exception("minBlockSize must be > 0 and "
+                            "minBlockSize <= pages");
+  }
+  if ((units_ << unitShift_) != pages_) {
+    throw new ex::Exception("pages must be a multiple of minBlockSize "
+                            "rounded up to a power of 2");
+  }
+
+  // create one free map per order up to the largest block that fits
+  u64 orders = 64 - __builtin_clzll(units_);
+  for (u64 order = 0; order < orders; order++) {
+    freeMaps_.push_back(new Bitmap(units_ >> order));
+  }
+
+  // the pages start as one free block per set bit of the number of units,
+  //  largest first so each block is aligned to its size
+  u64 unit = 0;
+  for (u64 order = orders; order-- > 0;) {
+    if ((units_ >> order) & 1) {
+      linkFreeBlock(order, unit >> order);
+      freeBlocks_ += 1;
+      unit += (u64)1 << order;
+    }
+  }
+}
+
+BuddyPageAllocator::~BuddyPageAllocator() {
+  for (Bitmap* freeMap : freeMaps_) {
+    delete freeMap;
+  }
+}
+
+u64 BuddyPageAllocator::createBlock(u64 _pages) {
+  // bail out if user is asking for nothing or too much
+  if (_pages == 0 || _pages > pages_) {
+    return INV;
+  }
+
+  // find the smallest order with a free block that is large enough
+  u64 order = orderOf(_pages);
+  if (order >= freeMaps_.size() || (freeOrderMask_ >> order) == 0) {
+    return INV;
+  }
+  u64 from = order + __builtin_ctzll(freeOrderMask_ >> order);
+  u64 index = freeMaps_[from]->findNext(0);
+  unlinkFreeBlock(from, index);
+
+  // split it down to size, the upper halves become free blocks
+  while (from > order) {
+    from--;
+    index <<= 1;
+    linkFreeBlock(from, index + 1);
+    freeBlocks_ += 1;
+  }
+  u64 unit = index << order;
+  usedOrders_[unit] = order + 1;
+
+  // perform accounting
+  u64 pages = (u64)1 << (order + unitShift_);
+  freeBlocks_ -= 1;
+  usedBlocks_ += 1;
+  freePages_ -= pages;
+  usedPages_ += pages;
+
+  return unit << unitShift_;
+}
+
+bool BuddyPageAllocator::freeBlock(u64 _block) {
+  // check if the block is a valid used block
+  u8 usedOrder = this->usedOrder(_block);
+  if (usedOrder == 0) {
+    return false;
+  }
+  u64 order = usedOrder - 1;
+  u64 unit = _block >> unitShift_;
+  usedOrders_[unit] = 0;
+
+  // perform accounting
+  u64 pages = (u64)1 << (order + unitShift_);
+  usedBlocks_ -= 1;
+  freePages_ += pages;
+  usedPages_ -= pages;
+
+  releaseBlock(unit, order);
+  return true;
+}
+
+bool BuddyPageAllocator::shrinkBlock(u64 _block, u64 _pages) {
+  // check if the block is a valid used block
+  u8 usedOrder = this->usedOrder(_block);
+  if (usedOrder == 0) {
+    return false;
+  }
+  u64 order = usedOrder - 1;
+
+  // check easy cases
+  if (_pages > ((u64)1 << (order + unitShift_))) {
+    // can't grow
+    return false;
+  } else if (_pages == 0) {
+    // zero is free
+    return freeBlock(_block);
+  }
+  u64 newOrder = orderOf(_pages);
+  if (newOrder == order) {
+    // can stay the same
+    return true;
+  }
+
+  // free the upper halves, their buddies are still used so they don't
+  //  coalesce
+  u64 unit = _block >> unitShift_;
+  usedOrders_[unit] = newOrder + 1;
+  u64 index = unit >> order;
+  for (u64 from = order; from > newOrder;) {
+    from--;
+    index <<= 1;
+    linkFreeBlock(from, index + 1);
+    freeBlocks_ += 1;
+  }
+
+  // perform accounting
+  u64 pages = ((u64)1 << (order + unitShift_)) -
+      ((u64)1 << (newOrder + unitShift_));
+  freePages_ += pages;
+  usedPages_ -= pages;
+  return true;
+}
+
+bool BuddyPageAllocator::growBlock(u64 _block, u64 _pages) {
+  // check if the block is a valid used block
+  u8 usedOrder = this->usedOrder(_block);
+  if (usedOrder == 0) {
+    return false;
+  }
+  u64 order = usedOrder - 1;
+
+  // check easy cases
+  if (_pages <= ((u64)1 << (order + unitShift_))) {
+    // can't shrink, but user might already have more than they asked for
+    return true;
+  } else if (_pages > pages_) {
+    return false;
+  }
+  u64 newOrder = orderOf(_pages);
+  if (newOrder >= freeMaps_.size()) {
+    return false;
+  }
+
+  // the block must be the lower half at each order up to the new one and
+  //  each upper half must be free
+  u64 unit = _block >> unitShift_;
+  for (u64 from = order; from < newOrder; from++) {
+    u64 index = unit >> from;
+    if ((index & 1) != 0 ||
+        index + 1 >= freeMaps_[from]->size() ||
+        !freeMaps_[from]->test(index + 1)) {
+      return false;
+    }
+  }
+
+  // claim the upper halves
+  for (u64 from = order; from < newOrder; from++) {
+    unlinkFreeBlock(from, (unit >> from) + 1);
+    freeBlocks_ -= 1;
+  }
+  usedOrders_[unit] = newOrder + 1;
+
+  // perform accounting
+  u64 pages = ((u64)1 << (newOrder + unitShift_)) -
+      ((u64)1 << (order + unitShift_));
+  freePages_ -= pages;
+  usedPages_ += pages;
+  return true;
+}
+
+u64 BuddyPageAllocator::blockSize(u64 _block) const {
+  u8 usedOrder = this->usedOrder(_block);
+  return usedOrder == 0 ? 0 : (u64)1 << (usedOrder - 1 + unitShift_);
+}
+
+u64 BuddyPageAllocator::unitPages() const {
+  return (u64)1 << unitShift_;
+}
+
+u64 BuddyPageAllocator::totalBlocks() const {
+  return freeBlocks_ + usedBlocks_;
+}
+
+u64 BuddyPageAllocator::freeBlocks() const {
+  return freeBlocks_;
+}
+
+u64 BuddyPageAllocator::usedBlocks() const {
+  return usedBlocks_;
+}
+
+u64 BuddyPageAllocator::totalPages() const {
+  return pages_;
+}
+
+u64 BuddyPageAllocator::freePages() const {
+  return freePages_;
+}
+
+u64 BuddyPageAllocator::usedPages() const {
+  return usedPages_;
+}
+
+u64 BuddyPageAllocator::metadataBytes() const {
+  u64 bytes = freeMaps_.capacity() * sizeof(Bitmap*) +
+      usedOrders_.capacity() * sizeof(u8);
+  for (const Bitmap* freeMap : freeMaps_) {
+    bytes += sizeof(Bitmap) + freeMap->metadataBytes();
+  }
+  return bytes;
+}
+
+void BuddyPageAllocator::verify(bool _print) const {
+  // scan all blocks in page order
+  if (_print) {
+    printf("blocks in page order:\n");
+  }
+  u64 freeCount = 0;
+  u64 usedCount = 0;
+  u64 freePages = 0;
+  u64 usedPages = 0;
+  u64 unit = 0;
+  while (unit < units_) {
+    u64 order;
+    bool used = usedOrders_[unit] != 0;
+    if (used) {
+      order = usedOrders_[unit] - 1;
+      usedCount++;
+      usedPages += (u64)1 << (order + unitShift_);
+    } else {
+      // exactly one order holds a free block here
+      order = INV;
+      for (u64 from = 0; from < freeMaps_.size(); from++) {
+        if ((unit & (((u64)1 << from) - 1)) == 0 &&
+            (unit >> from) < freeMaps_[from]->size() &&
+            freeMaps_[from]->test(unit >> from)) {
+          assert(order == INV);
+          order = from;
+        }
+      }
+      assert(order != INV);
+
+      // free buddies are always coalesced
+      u64 buddy = (unit >> order) ^ 1;
+      (void)buddy;  // unused
+      assert(buddy >= freeMaps_[order]->size() ||
+             !freeMaps_[order]->test(buddy));
+      freeCount++;
+      freePages += (u64)1 << (order + unitShift_);
+    }
+    assert((unit & (((u64)1 << order) - 1)) == 0);
+    for (u64 inner = 1; inner < ((u64)1 << order); inner++) {
+      assert(usedOrders_[unit + inner] == 0);
+    }
+    if (_print) {
+      printf("base=%lu size=%lu used=%u\n", unit << unitShift_,
+             (u64)1 << (order + unitShift_), used);
+    }
+    unit += (u64)1 << order;
+  }
+  assert(unit == units_);
+
+  // the free maps hold only the free blocks and the mask matches them
+  u64 mapCount = 0;
+  for (u64 order = 0; order < freeMaps_.size(); order++) {
+    for (u64 word : freeMaps_[order]->words()) {
+      mapCount += __builtin_popcountll(word);
+    }
+    assert(freeMaps_[order]->any() == (((freeOrderMask_ >> order) & 1) != 0));
+  }
+  assert((freeOrderMask_ >> freeMaps_.size()) == 0);
+  assert(mapCount == freeCount);
+
+  // verify the counters
+  assert(freeCount == freeBlocks_);
+  assert(usedCount == usedBlocks_);
+  assert(freePages == freePages_);
+  assert(usedPages == usedPages_);
+  assert(freePages_ + usedPages_ == pages_);
+  (void)freeCount;  // unused
+  (void)usedCount;  // unused
+  (void)freePages;  // unused
+  (void)usedPages;  // unused
+  (void)mapCount;  // unused
+}
+
+u64 BuddyPageAllocator::orderOf(u64 _pages) const {
+  u64 units = (_pages + ((u64)1 << unitShift_) - 1) >> unitShift_;
+  return units <= 1 ? 0 : 64 - __builtin_clzll(units - 1);
+}
+
+u8 BuddyPageAllocator::usedOrder(u64 _block) const {
+  if (_block >= pages_ || (_block & (((u64)1 << unitShift_) - 1)) != 0) {
+    return 0;
+  }
+  return usedOrders_[_block >> unitShift_];
+}
+
+void BuddyPageAllocator::linkFreeBlock(u64 _order, u64 _index) {
+  freeMaps_[_order]->set(_index);
+  freeOrderMask_ |= (u64)1 << _order;
+}
+
+void BuddyPageAllocator::unlinkFreeBlock(u64 _order, u64 _index) {
+  freeMaps_[_order]->clear(_index);
+  if (!freeMaps_[_order]->any()) {
+    freeOrderMask_ &= ~((u64)1 << _order);
+  }
+}
+
+void BuddyPageAllocator::releaseBlock(u64 _unit, u64 _order) {
+  // merge with the buddy while it is a free block of the same order
+  u64 index = _unit >> _order;
+  freeBlocks_ += 1;
+  while (true) {
+    u64 buddy = index ^ 1;
+    if (buddy >= freeMaps_[_order]->size() ||
+        !freeMaps_[_order]->test(buddy)) {
+      break;
+    }
+    unlinkFreeBlock(_order, buddy);
+    freeBlocks_ -= 1;
+    index >>= 1;
+    _order++;
+  }
+  linkFreeBlock(_order, index);
+}
+
+}  // namespace palloc
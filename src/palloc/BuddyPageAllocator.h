@@ -0,0 +1,147 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_BUDDYPAGEALLOCATOR_H_
+#define PALLOC_BUDDYPAGEALLOCATOR_H_
+
+#include <prim/prim.h>
+
+#include <vector>
+
+#include "palloc/Bitmap.h"
+
+namespace palloc {
+
+/*
+ * This is a binary buddy page allocator with the same interface as
+ * PageAllocator. Blocks are unit x 2^order pages where the unit is
+ * minBlockSize rounded up to a power of 2, and every block is aligned to its
+ * size so the buddy of a block is found by flipping one bit of its index.
+ *
+ * Each order has a Bitmap of its free blocks and a mask marks the orders
+ * that have any, so createBlock(), freeBlock(), shrinkBlock(), and
+ * growBlock() take O(log pages) time in the worst case regardless of how
+ * fragmented the pages are. The price is internal fragmentation: requests
+ * are rounded up to a power of 2 units, the counters report the rounded
+ * sizes. When the number of units isn't a power of 2 the pages start out as
+ * one free block per set bit of the number of units.
+ */
+
+class BuddyPageAllocator {
+ public:
+  // '_pages' must be a multiple of the unit
+  BuddyPageAllocator(u64 _pages, u64 _minBlockSize);
+  ~BuddyPageAllocator();
+
+  // allocates a block
+  //  returns the base page of the block
+  u64 createBlock(u64 _pages);
+
+  // frees an allocated block
+  //  returns true if success, false otherwise
+  bool freeBlock(u64 _block);
+
+  // shrinks an allocated block
+  //  'pages' is the total requested size
+  //  returns true if success, false otherwise
+  bool shrinkBlock(u64 _block, u64 _pages);
+
+  // grows an allocated block in place into its free buddies
+  //  'pages' is the total requested size
+  //  returns true if success, false otherwise
+  bool growBlock(u64 _block, u64 _pages);
+
+  // returns the number of pages in the used block starting at '_block',
+  //  zero if there is no such block
+  u64 blockSize(u64 _block) const;
+
+  // returns the number of pages per unit
+  u64 unitPages() const;
+
+  // returns the total number of blocks
+  u64 totalBlocks() const;
+
+  // returns the number of free blocks
+  u64 freeBlocks() const;
+
+  // returns the number of used blocks
+  u64 usedBlocks() const;
+
+  // returns the total number of pages
+  u64 totalPages() const;
+
+  // returns the number of free pages
+  u64 freePages() const;
+
+  // returns the number of used pages
+  u64 usedPages() const;
+
+  // returns the number of bytes of metadata held by the allocator
+  u64 metadataBytes() const;
+
+  // verify internal data structures
+  void verify(bool _print) const;
+
+ private:
+  // this returns the order of the smallest block holding '_pages' pages
+  u64 orderOf(u64 _pages) const;
+
+  // this returns the used block order plus one of the block starting at
+  //  '_block', zero if there is no such block
+  u8 usedOrder(u64 _block) const;
+
+  // this marks a block free at an order
+  void linkFreeBlock(u64 _order, u64 _index);
+
+  // this unmarks a free block at an order
+  void unlinkFreeBlock(u64 _order, u64 _index);
+
+  // this frees a block of units, coalescing it with its free buddies
+  void releaseBlock(u64 _unit, u64 _order);
+
+  const u64 pages_;
+  const u64 minBlockSize_;
+  const u64 unitShift_;  // log2 of the pages per unit
+  const u64 units_;
+
+  std::vector<Bitmap*> freeMaps_;  // indexed by order, bit per block index
+  u64 freeOrderMask_;  // bit 'i' is set when order 'i' has a free block
+  std::vector<u8> usedOrders_;  // indexed by unit, order plus one at used
+                                //  block bases, zero elsewhere
+
+  u64 freeBlocks_;
+  u64 usedBlocks_;
+  u64 freePages_;
+  u64 usedPages_;
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_BUDDYPAGEALLOCATOR_H_
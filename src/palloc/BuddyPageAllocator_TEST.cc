@@ -0,0 +1,175 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/BuddyPageAllocator.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <random>
+#include <vector>
+
+#include "palloc/Block.h"
+
+TEST(BuddyPageAllocator, basic) {
+  palloc::BuddyPageAllocator pa(1024, 1);
+  pa.verify(false);
+  ASSERT_EQ(pa.unitPages(), 1u);
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  ASSERT_EQ(pa.freePages(), 1024u);
+
+  // requests are rounded up to a power of 2 and split from the bottom
+  u64 b0 = pa.createBlock(3);
+  ASSERT_EQ(b0, 0u);
+  ASSERT_EQ(pa.blockSize(b0), 4u);
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 8u);  // 4, 8, ..., 512
+  ASSERT_EQ(pa.usedPages(), 4u);
+  u64 b1 = pa.createBlock(4);
+  ASSERT_EQ(b1, 4u);
+  u64 b2 = pa.createBlock(100);
+  ASSERT_EQ(b2, 128u);
+  ASSERT_EQ(pa.blockSize(b2), 128u);
+  u64 b3 = pa.createBlock(1);
+  ASSERT_EQ(b3, 8u);
+  pa.verify(false);
+  ASSERT_EQ(pa.createBlock(1024), palloc::INV);
+  ASSERT_EQ(pa.createBlock(0), palloc::INV);
+  ASSERT_EQ(pa.createBlock(2000), palloc::INV);
+
+  // freeing coalesces buddies back into one block
+  ASSERT_FALSE(pa.freeBlock(5));
+  ASSERT_FALSE(pa.freeBlock(2000));
+  ASSERT_TRUE(pa.freeBlock(b1));
+  ASSERT_FALSE(pa.freeBlock(b1));
+  ASSERT_TRUE(pa.freeBlock(b3));
+  ASSERT_TRUE(pa.freeBlock(b2));
+  pa.verify(false);
+  ASSERT_TRUE(pa.freeBlock(b0));
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  ASSERT_EQ(pa.freePages(), 1024u);
+  ASSERT_EQ(pa.createBlock(1024), 0u);
+}
+
+TEST(BuddyPageAllocator, geometry) {
+  // 5 units of 4 pages start as blocks of 4 and 1 units
+  palloc::BuddyPageAllocator pa(20, 3);
+  pa.verify(false);
+  ASSERT_EQ(pa.unitPages(), 4u);
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+  u64 b0 = pa.createBlock(1);
+  ASSERT_EQ(b0, 16u);
+  ASSERT_EQ(pa.blockSize(b0), 4u);
+  ASSERT_EQ(pa.createBlock(5), 0u);
+  ASSERT_EQ(pa.createBlock(8), 8u);
+  ASSERT_EQ(pa.createBlock(1), palloc::INV);
+  ASSERT_FALSE(pa.freeBlock(2));
+  ASSERT_TRUE(pa.freeBlock(b0));
+  pa.verify(false);
+
+  // the last unit has no buddy
+  ASSERT_TRUE(pa.freeBlock(0));
+  ASSERT_TRUE(pa.freeBlock(8));
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+}
+
+TEST(BuddyPageAllocator, resize) {
+  palloc::BuddyPageAllocator pa(64, 1);
+  u64 b0 = pa.createBlock(16);
+  ASSERT_EQ(b0, 0u);
+
+  // shrinking frees the upper halves
+  ASSERT_TRUE(pa.shrinkBlock(b0, 16));
+  ASSERT_FALSE(pa.shrinkBlock(b0, 17));
+  ASSERT_TRUE(pa.shrinkBlock(b0, 3));
+  pa.verify(false);
+  ASSERT_EQ(pa.blockSize(b0), 4u);
+  ASSERT_EQ(pa.usedPages(), 4u);
+  ASSERT_EQ(pa.freeBlocks(), 4u);  // 4, 8, 16, 32
+
+  // growing takes free upper halves in place
+  ASSERT_TRUE(pa.growBlock(b0, 2));
+  ASSERT_EQ(pa.blockSize(b0), 4u);
+  ASSERT_TRUE(pa.growBlock(b0, 30));
+  pa.verify(false);
+  ASSERT_EQ(pa.blockSize(b0), 32u);
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  ASSERT_FALSE(pa.growBlock(b0, 65));
+
+  // but not past a used buddy or from an upper half
+  u64 b1 = pa.createBlock(1);
+  ASSERT_EQ(b1, 32u);
+  ASSERT_FALSE(pa.growBlock(b0, 64));
+  ASSERT_FALSE(pa.growBlock(b1, 64));
+  ASSERT_TRUE(pa.shrinkBlock(b0, 0));
+  ASSERT_FALSE(pa.growBlock(b0, 2));
+  pa.verify(false);
+  ASSERT_EQ(pa.usedBlocks(), 1u);
+  ASSERT_TRUE(pa.freeBlock(b1));
+  ASSERT_EQ(pa.totalBlocks(), 1u);
+}
+
+TEST(BuddyPageAllocator, random) {
+  palloc::BuddyPageAllocator pa(3000, 2);
+  std::vector<u64> blocks;
+  std::mt19937_64 rnd(12345);
+  for (u64 iter = 0; iter < 20000; iter++) {
+    u64 op = rnd() % 8;
+    if (op < 4 || blocks.empty()) {
+      u64 base = pa.createBlock(1 + rnd() % 100);
+      if (base != palloc::INV) {
+        blocks.push_back(base);
+      }
+    } else {
+      u64 pick = rnd() % blocks.size();
+      if (op == 4) {
+        u64 size = pa.blockSize(blocks.at(pick));
+        ASSERT_TRUE(pa.shrinkBlock(blocks.at(pick), 1 + rnd() % size));
+      } else if (op == 5) {
+        pa.growBlock(blocks.at(pick), 1 + rnd() % 200);
+      } else {
+        ASSERT_TRUE(pa.freeBlock(blocks.at(pick)));
+        blocks.at(pick) = blocks.back();
+        blocks.pop_back();
+      }
+    }
+    if (iter % 1000 == 0) {
+      pa.verify(false);
+    }
+  }
+  for (u64 base : blocks) {
+    ASSERT_TRUE(pa.freeBlock(base));
+  }
+  pa.verify(false);
+  ASSERT_EQ(pa.freePages(), 3000u);
+  ASSERT_EQ(pa.freeBlocks(), 7u);  // 1500 units has 7 bits set
+}
@@ -0,0 +1,393 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/ConcurrentPageAllocator.h"
+
+#include <ex/Exception.h>
+
+#include <cassert>
+
+#include <algorithm>
+#include <thread>
+#include <utility>
+
+namespace palloc {
+
+namespace {
+
+// threads are numbered in order of their first allocator call
+std::atomic<u64> nextThreadIndex(0);
+thread_local u64 threadIndexValue = nextThreadIndex++;
+
+}  // namespace
+
+const u64 ConcurrentPageAllocator::kMagazineSize;
+
+ConcurrentPageAllocator::ConcurrentPageAllocator(
+    u64 _pages, u64 _minBlockSize, u64 _shards, u64 _cachePages)
+    : pages_(_pages), minBlockSize_(_minBlockSize),
+      shardPages_(_shards == 0 ? 0 : _pages / _shards),
+      cachePages_(_cachePages), cachedBlocks_(0), cachedPages_(0) {
+  // check input parameters
+  if (_shards == 0 || shardPages_ < minBlockSize_) {
+    throw new ex::Exception("shards must be > 0 and each shard must hold at "
+                            "least minBlockSize pages");
+  }
+
+  // create the shards, the last one takes the remainder
+  for (u64 idx = 0; idx < _shards; idx++) {
+    u64 base = idx * shardPages_;
+    u64 pages = (idx == _shards - 1) ? pages_ - base : shardPages_;
+    shards_.push_back(new Shard(base, pages, minBlockSize_));
+  }
+
+  // create one cache per hardware thread, at least one per shard
+  if (cachePages_ > 0) {
+    u64 caches = std::max(_shards,
+                          (u64)std::thread::hardware_concurrency());
+    for (u64 idx = 0; idx < caches; idx++) {
+      caches_.push_back(new Cache(cachePages_));
+    }
+  }
+}
+
+ConcurrentPageAllocator::~ConcurrentPageAllocator() {
+  for (Cache* cache : caches_) {
+    delete cache;
+  }
+  for (Shard* shard : shards_) {
+    delete shard;
+  }
+}
+
+u64 ConcurrentPageAllocator::createBlock(u64 _pages) {
+  // bail out if user is asking for nothing
+  if (_pages == 0) {
+    return INV;
+  }
+
+  // try the calling thread's cache first
+  u64 pages = std::max(_pages, minBlockSize_);
+  if (pages <= cachePages_) {
+    Cache* cache = caches_.at(threadIndex() % caches_.size());
+    std::lock_guard<std::mutex> guard(cache->lock);
+    std::vector<CachedBlock>& magazine = cache->magazines.at(pages);
+    if (!magazine.empty()) {
+      // the block is used in its shard so the flag is cleared without the
+      //  shard lock
+      CachedBlock cached = magazine.back();
+      magazine.pop_back();
+      cachedBlocks_ -= 1;
+      cachedPages_ -= pages;
+      cached.block->cached = false;
+      return cached.base;
+    }
+  }
+
+  // try the shards
+  u64 block = createShardBlock(_pages);
+
+  // as a last resort release all cached blocks and try again
+  if (block == INV && cachedBlocks_ > 0) {
+    flushCaches();
+    block = createShardBlock(_pages);
+  }
+  return block;
+}
+
+bool ConcurrentPageAllocator::freeBlock(u64 _block) {
+  Shard* shard = shardOf(_block);
+  if (shard == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(shard->lock);
+  u64 block = _block - shard->base;
+  if (isCached(shard, block)) {
+    return false;  // already freed into a cache
+  }
+  return shard->allocator.freeBlock(block);
+}
+
+bool ConcurrentPageAllocator::freeBlock(u64 _block, u64 _pages) {
+  // only small blocks are cached
+  u64 pages = std::max(_pages, minBlockSize_);
+  Shard* shard = shardOf(_block);
+  if (_pages == 0 || pages > cachePages_ || shard == nullptr) {
+    return freeBlock(_block);
+  }
+
+  // mark the block as cached if it is a used block of the given size, the
+  //  size served by its magazine
+  CachedBlock cached = {_block, nullptr};
+  {
+    std::lock_guard<std::mutex> guard(shard->lock);
+    Block* block = shard->allocator.usedBlock(_block - shard->base);
+    if (block == nullptr || block->cached) {
+      return false;  // not a used block or already freed into a cache
+    }
+    if (block->size < pages || block->size - pages >= minBlockSize_) {
+      // the size doesn't match, return it to its shard
+      return shard->allocator.freeBlock(_block - shard->base);
+    }
+    block->cached = true;
+    cached.block = block;
+  }
+
+  // keep the block in the calling thread's cache when there is room
+  {
+    Cache* cache = caches_.at(threadIndex() % caches_.size());
+    std::lock_guard<std::mutex> guard(cache->lock);
+    std::vector<CachedBlock>& magazine = cache->magazines.at(pages);
+    if (magazine.size() < kMagazineSize) {
+      magazine.push_back(cached);
+      cachedBlocks_ += 1;
+      cachedPages_ += pages;
+      return true;
+    }
+  }
+
+  // otherwise return it to its shard
+  std::lock_guard<std::mutex> guard(shard->lock);
+  cached.block->cached = false;
+  return shard->allocator.freeBlock(_block - shard->base);
+}
+
+bool ConcurrentPageAllocator::shrinkBlock(u64 _block, u64 _pages) {
+  Shard* shard = shardOf(_block);
+  if (shard == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(shard->lock);
+  u64 block = _block - shard->base;
+  if (isCached(shard, block)) {
+    return false;  // freed into a cache
+  }
+  return shard->allocator.shrinkBlock(block, _pages);
+}
+
+bool ConcurrentPageAllocator::growBlock(u64 _block, u64 _pages) {
+  Shard* shard = shardOf(_block);
+  if (shard == nullptr) {
+    return false;
+  }
+  std::lock_guard<std::mutex> guard(shard->lock);
+  u64 block = _block - shard->base;
+  if (isCached(shard, block)) {
+    return false;  // freed into a cache
+  }
+  return shard->allocator.growBlock(block, _pages);
+}
+
+void ConcurrentPageAllocator::flushCaches() {
+  // cached blocks and their cached sizes
+  std::vector<std::pair<CachedBlock, u64> > blocks;
+  for (Cache* cache : caches_) {
+    // empty the magazines while holding only the cache lock
+    blocks.clear();
+    {
+      std::lock_guard<std::mutex> guard(cache->lock);
+      for (u64 size = 0; size < cache->magazines.size(); size++) {
+        std::vector<CachedBlock>& magazine = cache->magazines.at(size);
+        for (const CachedBlock& cached : magazine) {
+          blocks.emplace_back(cached, size);
+        }
+        magazine.clear();
+      }
+    }
+
+    // return the blocks to their shards, each block leaves the counters
+    //  before it becomes free in its shard so the used counts never drop
+    //  below the cached counts
+    for (const std::pair<CachedBlock, u64>& cached : blocks) {
+      cachedBlocks_ -= 1;
+      cachedPages_ -= cached.second;
+      Shard* shard = shardOf(cached.first.base);
+      std::lock_guard<std::mutex> guard(shard->lock);
+      cached.first.block->cached = false;
+      bool res = shard->allocator.freeBlock(cached.first.base - shard->base);
+      (void)res;  // unused
+      assert(res);
+    }
+  }
+}
+
+u64 ConcurrentPageAllocator::numShards() const {
+  return shards_.size();
+}
+
+u64 ConcurrentPageAllocator::totalBlocks() const {
+  u64 blocks = 0;
+  for (Shard* shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->lock);
+    blocks += shard->allocator.totalBlocks();
+  }
+  return blocks;
+}
+
+u64 ConcurrentPageAllocator::freeBlocks() const {
+  u64 blocks = cachedBlocks_;
+  for (Shard* shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->lock);
+    blocks += shard->allocator.freeBlocks();
+  }
+  return blocks;
+}
+
+u64 ConcurrentPageAllocator::usedBlocks() const {
+  u64 blocks = 0;
+  for (Shard* shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->lock);
+    blocks += shard->allocator.usedBlocks();
+  }
+
+  // the shards are summed one at a time so a block cached meanwhile may be
+  //  counted as cached but not as used
+  u64 cached = cachedBlocks_;
+  return blocks > cached ? blocks - cached : 0;
+}
+
+u64 ConcurrentPageAllocator::totalPages() const {
+  return pages_;
+}
+
+u64 ConcurrentPageAllocator::freePages() const {
+  u64 pages = cachedPages_;
+  for (Shard* shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->lock);
+    pages += shard->allocator.freePages();
+  }
+  return pages;
+}
+
+u64 ConcurrentPageAllocator::usedPages() const {
+  u64 pages = 0;
+  for (Shard* shard : shards_) {
+    std::lock_guard<std::mutex> guard(shard->lock);
+    pages += shard->allocator.usedPages();
+  }
+
+  // as with usedBlocks(), the sum may miss pages cached meanwhile
+  u64 cached = cachedPages_;
+  return pages > cached ? pages - cached : 0;
+}
+
+void ConcurrentPageAllocator::verify(bool _print) const {
+  u64 marked = 0;
+  for (u64 idx = 0; idx < shards_.size(); idx++) {
+    Shard* shard = shards_.at(idx);
+    if (_print) {
+      printf("shard=%lu base=%lu\n", idx, shard->base);
+    }
+    std::lock_guard<std::mutex> guard(shard->lock);
+    shard->allocator.verify(_print);
+    shard->allocator.forEachUsed([&](u64 _base, u64 _pages) {
+        (void)_pages;  // unused
+        if (shard->allocator.usedBlock(_base)->cached) {
+          marked++;
+        }
+      });
+  }
+
+  // check that the cached counters match the caches and that every cached
+  //  block is marked in its shard
+  u64 blocks = 0;
+  u64 pages = 0;
+  for (Cache* cache : caches_) {
+    std::lock_guard<std::mutex> guard(cache->lock);
+    for (u64 size = 0; size < cache->magazines.size(); size++) {
+      for (const CachedBlock& cached : cache->magazines.at(size)) {
+        Shard* shard = shardOf(cached.base);
+        std::lock_guard<std::mutex> shardGuard(shard->lock);
+        assert(shard->allocator.usedBlock(cached.base - shard->base) ==
+               cached.block);
+        assert(cached.block->cached);
+        (void)shard;  // unused
+        blocks++;
+        pages += size;
+      }
+    }
+  }
+  (void)marked;  // unused
+  (void)blocks;  // unused
+  (void)pages;  // unused
+  assert(marked == blocks);
+  assert(blocks == cachedBlocks_);
+  assert(pages == cachedPages_);
+}
+
+/*** private below here ***/
+
+ConcurrentPageAllocator::Shard::Shard(u64 _base, u64 _pages,
+                                      u64 _minBlockSize)
+    : allocator(_pages, _minBlockSize), base(_base) {}
+
+ConcurrentPageAllocator::Cache::Cache(u64 _cachePages)
+    : magazines(_cachePages + 1) {
+  for (std::vector<CachedBlock>& magazine : magazines) {
+    magazine.reserve(kMagazineSize);
+  }
+}
+
+u64 ConcurrentPageAllocator::threadIndex() {
+  return threadIndexValue;
+}
+
+ConcurrentPageAllocator::Shard* ConcurrentPageAllocator::shardOf(
+    u64 _page) const {
+  if (_page >= pages_) {
+    return nullptr;
+  }
+  u64 idx = std::min(_page / shardPages_, (u64)shards_.size() - 1);
+  return shards_.at(idx);
+}
+
+bool ConcurrentPageAllocator::isCached(Shard* _shard, u64 _block) const {
+  if (cachePages_ == 0) {
+    return false;
+  }
+  const Block* block = _shard->allocator.usedBlock(_block);
+  return block != nullptr && block->cached;
+}
+
+u64 ConcurrentPageAllocator::createShardBlock(u64 _pages) {
+  // start at the home shard then walk the neighbors
+  u64 home = threadIndex() % shards_.size();
+  for (u64 offset = 0; offset < shards_.size(); offset++) {
+    Shard* shard = shards_.at((home + offset) % shards_.size());
+    std::lock_guard<std::mutex> guard(shard->lock);
+    u64 block = shard->allocator.createBlock(_pages);
+    if (block != INV) {
+      return shard->base + block;
+    }
+  }
+  return INV;
+}
+
+}  // namespace palloc
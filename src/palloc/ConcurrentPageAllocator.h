@@ -0,0 +1,181 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_CONCURRENTPAGEALLOCATOR_H_
+#define PALLOC_CONCURRENTPAGEALLOCATOR_H_
+
+#include <prim/prim.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include "palloc/PageAllocator.h"
+
+namespace palloc {
+
+/*
+ * This is a thread safe front end to PageAllocator. The page space is split
+ * evenly into independently locked shards, each managed by a PageAllocator.
+ * Threads allocate from a home shard chosen by thread and fall back to the
+ * neighboring shards when it is exhausted. Blocks never span shards.
+ *
+ * Small blocks released with the sized freeBlock() are kept in caches
+ * (magazines of exact block sizes) and are handed back out by createBlock().
+ * There is one cache per hardware thread, at least one per shard, and a
+ * thread uses cache threadIndex() % the number of caches, so threads beyond
+ * that share caches. Each cache has its own lock. Cached blocks are reported
+ * as free pages and free blocks. Cached pages are counted with the size given
+ * to freeBlock(), which can be less than the real block size by up to
+ * minBlockSize - 1 pages when createBlock() absorbed a small remainder.
+ *
+ * A cached block stays used in its shard and is marked by the 'cached' flag
+ * of its Block, so freeing, shrinking, or growing it fails. The sized
+ * freeBlock() takes the shard lock once to check the size and set the flag.
+ * A cache hit clears the flag through the Block kept in the magazine, so it
+ * takes no shard lock and allocates nothing. Only the thread holding the
+ * block touches the flag then, as the block isn't free in its shard.
+ *
+ * The counts are summed one shard at a time so they are only exact while no
+ * other thread changes the allocator.
+ */
+
+class ConcurrentPageAllocator {
+ public:
+  // '_shards' is the number of independently locked shards
+  // '_cachePages' is the largest block size kept in the caches, zero disables
+  //  caching
+  ConcurrentPageAllocator(u64 _pages, u64 _minBlockSize, u64 _shards,
+                          u64 _cachePages);
+  ~ConcurrentPageAllocator();
+
+  // allocates a block
+  //  returns the base page of the block
+  u64 createBlock(u64 _pages);
+
+  // frees an allocated block
+  //  returns true if success, false otherwise
+  bool freeBlock(u64 _block);
+
+  // frees an allocated block of a known size
+  //  'pages' must be the current size of the block as requested by the user
+  //  blocks small enough are kept in the calling thread's cache, a block
+  //  whose size doesn't match 'pages' is returned to its shard instead
+  //  returns true if success, false otherwise
+  bool freeBlock(u64 _block, u64 _pages);
+
+  // shrinks an allocated block
+  //  'pages' is the total requested size
+  //  returns true if success, false otherwise
+  bool shrinkBlock(u64 _block, u64 _pages);
+
+  // grows an allocated block
+  //  'pages' is the total requested size
+  //  Note: blocks can't grow beyond the end of their shard
+  //  returns true if success, false otherwise
+  bool growBlock(u64 _block, u64 _pages);
+
+  // returns all cached blocks to the shards
+  void flushCaches();
+
+  // returns the number of shards
+  u64 numShards() const;
+
+  // returns the total number of blocks
+  u64 totalBlocks() const;
+
+  // returns the number of free blocks
+  u64 freeBlocks() const;
+
+  // returns the number of used blocks
+  u64 usedBlocks() const;
+
+  // returns the total number of pages
+  u64 totalPages() const;
+
+  // returns the number of free pages
+  u64 freePages() const;
+
+  // returns the number of used pages
+  u64 usedPages() const;
+
+  // verify internal data structures
+  void verify(bool _print) const;
+
+ private:
+  struct Shard {
+    Shard(u64 _base, u64 _pages, u64 _minBlockSize);
+    mutable std::mutex lock;
+    PageAllocator allocator;
+    const u64 base;  // first page of the shard
+  };
+
+  struct CachedBlock {
+    u64 base;  // first page of the block
+    Block* block;  // the block in its shard, marked as cached
+  };
+
+  struct Cache {
+    explicit Cache(u64 _cachePages);
+    mutable std::mutex lock;
+    std::vector<std::vector<CachedBlock> > magazines;  // indexed by size
+  };
+
+  // the number of blocks each magazine holds
+  static const u64 kMagazineSize = 64;
+
+  // this returns the index of the calling thread
+  static u64 threadIndex();
+
+  // this returns the shard that owns a page
+  Shard* shardOf(u64 _page) const;
+
+  // this returns true if a block of a shard is held by a cache, the shard
+  //  lock must be held
+  bool isCached(Shard* _shard, u64 _block) const;
+
+  // this allocates a block from the shards starting at the home shard
+  u64 createShardBlock(u64 _pages);
+
+  const u64 pages_;
+  const u64 minBlockSize_;
+  const u64 shardPages_;  // pages per shard except the last
+  const u64 cachePages_;
+
+  std::vector<Shard*> shards_;
+  std::vector<Cache*> caches_;
+
+  std::atomic<u64> cachedBlocks_;
+  std::atomic<u64> cachedPages_;
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_CONCURRENTPAGEALLOCATOR_H_
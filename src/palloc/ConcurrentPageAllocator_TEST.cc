@@ -0,0 +1,188 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/ConcurrentPageAllocator.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST(ConcurrentPageAllocator, single) {
+  palloc::ConcurrentPageAllocator pa(1024, 1, 4, 8);
+  ASSERT_EQ(pa.numShards(), 4u);
+  ASSERT_EQ(pa.totalPages(), 1024u);
+  ASSERT_EQ(pa.createBlock(0), palloc::INV);
+
+  // blocks never span shards
+  ASSERT_EQ(pa.createBlock(257), palloc::INV);
+
+  // fill the whole space, this walks to the neighboring shards
+  std::vector<u64> blocks;
+  for (u64 idx = 0; idx < 4; idx++) {
+    u64 b = pa.createBlock(256);
+    ASSERT_NE(b, palloc::INV);
+    blocks.push_back(b);
+  }
+  ASSERT_EQ(pa.freePages(), 0u);
+  ASSERT_EQ(pa.createBlock(1), palloc::INV);
+  for (u64 b : blocks) {
+    ASSERT_TRUE(pa.freeBlock(b));
+    ASSERT_FALSE(pa.freeBlock(b));
+  }
+  pa.verify(false);
+  ASSERT_EQ(pa.freePages(), 1024u);
+
+  // cached blocks are counted as free and reused
+  u64 b0 = pa.createBlock(4);
+  ASSERT_NE(b0, palloc::INV);
+  ASSERT_TRUE(pa.freeBlock(b0, 4));
+  ASSERT_EQ(pa.freePages(), 1024u);
+  ASSERT_EQ(pa.usedPages(), 0u);
+  ASSERT_EQ(pa.freeBlocks(), 5u);
+  ASSERT_EQ(pa.usedBlocks(), 0u);
+  pa.verify(false);
+  ASSERT_EQ(pa.createBlock(4), b0);
+  ASSERT_EQ(pa.usedPages(), 4u);
+  ASSERT_TRUE(pa.growBlock(b0, 6));
+  ASSERT_TRUE(pa.shrinkBlock(b0, 2));
+  ASSERT_TRUE(pa.freeBlock(b0, 2));
+  pa.flushCaches();
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 4u);
+  ASSERT_EQ(pa.freePages(), 1024u);
+}
+
+TEST(ConcurrentPageAllocator, sizedFree) {
+  palloc::ConcurrentPageAllocator pa(1024, 1, 1, 16);
+
+  // a cached block can't be freed again
+  u64 b = pa.createBlock(4);
+  ASSERT_TRUE(pa.freeBlock(b, 4));
+  ASSERT_FALSE(pa.freeBlock(b, 4));
+  ASSERT_FALSE(pa.freeBlock(b));
+  ASSERT_FALSE(pa.shrinkBlock(b, 2));
+  ASSERT_FALSE(pa.growBlock(b, 8));
+  ASSERT_EQ(pa.freePages(), 1024u);
+  pa.verify(false);
+  u64 b0 = pa.createBlock(4);
+  u64 b1 = pa.createBlock(4);
+  ASSERT_EQ(b0, b);
+  ASSERT_NE(b1, b0);
+  ASSERT_TRUE(pa.freeBlock(b0, 4));
+  ASSERT_TRUE(pa.freeBlock(b1));
+
+  // a block freed with the wrong size isn't cached
+  u64 c = pa.createBlock(2);
+  u64 d = pa.createBlock(8);
+  ASSERT_TRUE(pa.freeBlock(c, 8));
+  ASSERT_FALSE(pa.freeBlock(c, 2));
+  u64 e = pa.createBlock(8);
+  ASSERT_NE(e, c);
+  ASSERT_NE(e, d);
+  ASSERT_TRUE(pa.freeBlock(d, 8));
+  ASSERT_TRUE(pa.freeBlock(e, 8));
+  ASSERT_FALSE(pa.freeBlock(pa.totalPages() - 1, 4));
+  pa.verify(false);
+  pa.flushCaches();
+  ASSERT_EQ(pa.freePages(), 1024u);
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  pa.verify(false);
+}
+
+TEST(ConcurrentPageAllocator, threads) {
+  const u64 kThreads = 8;
+  const u64 kShards = 4;
+  palloc::ConcurrentPageAllocator pa(1 << 16, 1, kShards, 16);
+
+  std::vector<std::thread> threads;
+  for (u64 t = 0; t < kThreads; t++) {
+    threads.push_back(std::thread([&pa, t]() {
+      std::vector<std::pair<u64, u64> > blocks;
+      for (u64 iter = 0; iter < 20000; iter++) {
+        u64 pages = 1 + ((iter * 7 + t * 13) % 32);
+        if (blocks.size() < 64 && (iter % 3) != 2) {
+          u64 b = pa.createBlock(pages);
+          ASSERT_NE(b, palloc::INV);
+          blocks.push_back(std::make_pair(b, pages));
+        } else if (!blocks.empty()) {
+          std::pair<u64, u64> p = blocks.back();
+          blocks.pop_back();
+          if (iter % 2) {
+            ASSERT_TRUE(pa.freeBlock(p.first, p.second));
+          } else {
+            ASSERT_TRUE(pa.freeBlock(p.first));
+          }
+        }
+      }
+      for (const std::pair<u64, u64>& p : blocks) {
+        ASSERT_TRUE(pa.freeBlock(p.first, p.second));
+      }
+    }));
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+
+  pa.verify(false);
+  ASSERT_EQ(pa.usedPages(), 0u);
+  ASSERT_EQ(pa.freePages(), 1u << 16);
+  pa.flushCaches();
+  ASSERT_EQ(pa.freeBlocks(), kShards);
+}
+
+TEST(ConcurrentPageAllocator, countersDuringFlush) {
+  // the used counts never wrap while cached blocks are flushed
+  palloc::ConcurrentPageAllocator pa(1024, 1, 2, 8);
+  std::atomic<bool> done(false);
+  std::thread flusher([&pa, &done]() {
+    for (u64 iter = 0; iter < 2000; iter++) {
+      std::vector<u64> blocks;
+      for (u64 idx = 0; idx < 16; idx++) {
+        blocks.push_back(pa.createBlock(4));
+      }
+      for (u64 b : blocks) {
+        ASSERT_TRUE(pa.freeBlock(b, 4));
+      }
+      pa.flushCaches();
+    }
+    done = true;
+  });
+  bool wrapped = false;
+  while (!done) {
+    wrapped |= pa.usedBlocks() > 16 || pa.usedPages() > 64;
+  }
+  flusher.join();
+  ASSERT_FALSE(wrapped);
+  pa.verify(false);
+  ASSERT_EQ(pa.usedPages(), 0u);
+}
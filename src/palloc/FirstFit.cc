@@ -0,0 +1,195 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/FirstFit.h"
+
+#include <cassert>
+#include <cstdio>
+
+namespace palloc {
+
+FirstFit::FirstFit(u64 _pages, u64 _minBlockSize)
+    : minBlockSize_(_minBlockSize), root_(nullptr), search_({0, 0}) {
+  (void)_pages;  // unused
+}
+
+void FirstFit::link(Block* _block) {
+  Tree::insert(&root_, _block);
+}
+
+void FirstFit::unlink(Block* _block) {
+  Tree::remove(&root_, _block);
+}
+
+Block* FirstFit::find(u64 _pages) const {
+  PALLOC_STAT(search_.probes++);
+  return findFrom(root_, 0, _pages);
+}
+
+Block* FirstFit::findAligned(u64 _pages, u64 _alignment,
+                             u64* _base) const {
+  // any block this large holds an aligned range
+  u64 guaranteed = _pages + minBlockSize_ + _alignment - 1;
+  if (guaranteed <= _pages) {
+    guaranteed = U64_MAX;
+  }
+  u64 probes = kAlignedProbes;
+  PALLOC_STAT(search_.probes++);
+  return findAlignedFrom(root_, _pages, guaranteed, _alignment, &probes,
+                         _base);
+}
+
+u64 FirstFit::largest() const {
+  return root_ == nullptr ? 0 : root_->maxSize;
+}
+
+Block* FirstFit::floor(u64 _page) const {
+  // find the last block with a base page of at most '_page'
+  PALLOC_STAT(search_.probes++);
+  Block* best = nullptr;
+  for (Block* block = root_; block != nullptr;) {
+    PALLOC_STAT(search_.walked++);
+    if (block->base <= _page) {
+      best = block;
+      block = block->right;
+    } else {
+      block = block->left;
+    }
+  }
+  return best;
+}
+
+bool FirstFit::resize(u64 _pages) {
+  (void)_pages;  // unused
+  return true;
+}
+
+SearchCount FirstFit::takeSearchCount() const {
+  SearchCount count = search_;
+  search_ = {0, 0};
+  return count;
+}
+
+u64 FirstFit::metadataBytes() const {
+  // the tree links live in the blocks
+  return 0;
+}
+
+u64 FirstFit::verify(bool _print) const {
+  // print the free blocks
+  if (_print) {
+    printf("free blocks in page order:\n");
+  }
+  assert(root_ == nullptr || root_->parent == nullptr);
+  u64 treeCount = Tree::verify(root_);
+  u64 count = 0;
+  Block* last = nullptr;
+  for (Block* block = Tree::first(root_); block != nullptr;
+       block = Tree::next(block)) {
+    count++;
+    if (_print) {
+      printf("this=0x%lX base=%lu size=%lu used=%u prev=0x%lX next=0x%lX\n",
+             (u64)block, block->base, block->size, block->used,
+             (u64)block->prev, (u64)block->next);
+    }
+    assert(block->used == false);
+    assert(block->quick == false);
+    assert(last == nullptr || AddressOrder::less(last, block));
+    last = block;
+  }
+  (void)last;  // unused
+  (void)treeCount;  // unused
+  assert(treeCount == count);
+  return count;
+}
+
+/*** protected below here ***/
+
+bool FirstFit::AddressOrder::less(const Block* _a, const Block* _b) {
+  return _a->base < _b->base;
+}
+
+Block* FirstFit::findFrom(Block* _root, u64 _page, u64 _pages) const {
+  // skip subtrees without a large enough block
+  if (_root == nullptr) {
+    return nullptr;
+  }
+  PALLOC_STAT(search_.walked++);
+  if (_root->maxSize < _pages) {
+    return nullptr;
+  }
+
+  // blocks below '_page' are skipped by searching only the right subtree
+  if (_root->base < _page) {
+    return findFrom(_root->right, _page, _pages);
+  }
+
+  // otherwise the left subtree holds lower addresses
+  Block* block = findFrom(_root->left, _page, _pages);
+  if (block != nullptr) {
+    return block;
+  }
+  if (_root->size >= _pages) {
+    return _root;
+  }
+  return findFrom(_root->right, _page, _pages);
+}
+
+Block* FirstFit::findAlignedFrom(Block* _root, u64 _pages, u64 _guaranteed,
+                                 u64 _alignment, u64* _probes,
+                                 u64* _base) const {
+  // skip subtrees without a large enough block, only blocks of the
+  //  guaranteed size are large enough once the probes run out
+  if (_root == nullptr) {
+    return nullptr;
+  }
+  PALLOC_STAT(search_.walked++);
+  if (_root->maxSize < (*_probes > 0 ? _pages : _guaranteed)) {
+    return nullptr;
+  }
+
+  // check the blocks in page order
+  Block* block = findAlignedFrom(_root->left, _pages, _guaranteed, _alignment,
+                                 _probes, _base);
+  if (block != nullptr) {
+    return block;
+  }
+  if (_root->size >= (*_probes > 0 ? _pages : _guaranteed)) {
+    *_base = alignedBase(_root, _pages, _alignment, minBlockSize_);
+    if (*_base != INV) {
+      return _root;
+    }
+    (*_probes)--;
+  }
+  return findAlignedFrom(_root->right, _pages, _guaranteed, _alignment,
+                         _probes, _base);
+}
+
+}  // namespace palloc
@@ -0,0 +1,117 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_FIRSTFIT_H_
+#define PALLOC_FIRSTFIT_H_
+
+#include <prim/prim.h>
+
+#include "palloc/Block.h"
+#include "palloc/Stats.h"
+#include "palloc/Treap.h"
+
+namespace palloc {
+
+/*
+ * This is the address ordered first fit placement policy. Free blocks are
+ * kept in a single treap ordered by base page where every node also holds
+ * the largest size in its subtree, so the lowest addressed block that fits
+ * is found in logarithmic time. This gives lower fragmentation than best
+ * fit for long lived pools.
+ */
+
+class FirstFit {
+ public:
+  FirstFit(u64 _pages, u64 _minBlockSize);
+
+  // links a free block into the index
+  void link(Block* _block);
+
+  // unlinks a free block from the index
+  void unlink(Block* _block);
+
+  // returns the lowest addressed free block with at least '_pages' pages,
+  //  nullptr if none
+  Block* find(u64 _pages) const;
+
+  // returns the lowest addressed free block holding an aligned range of
+  //  '_pages' pages and sets '_base' to the aligned base page, nullptr if none
+  //  after kAlignedProbes blocks too small to surely hold the range failed
+  //  only blocks that large are searched, so this takes
+  //  O(kAlignedProbes * log n) time and can miss a lower addressed fit
+  Block* findAligned(u64 _pages, u64 _alignment, u64* _base) const;
+
+  // returns the size of the largest free block, 0 if none
+  u64 largest() const;
+
+  // returns the free block with the highest base page of at most '_page',
+  //  nullptr if none
+  Block* floor(u64 _page) const;
+
+  // changes the number of pages, the index doesn't depend on it
+  //  returns true
+  bool resize(u64 _pages);
+
+  // returns the work done by the searches since the last call and resets it
+  //  (only counted with PALLOC_STATS)
+  SearchCount takeSearchCount() const;
+
+  // returns the number of bytes of heap memory used by the index
+  u64 metadataBytes() const;
+
+  // verifies the index, returns the number of free blocks in it
+  u64 verify(bool _print) const;
+
+ protected:
+  struct AddressOrder {
+    static bool less(const Block* _a, const Block* _b);
+    static const bool kAugmented = true;
+  };
+  typedef Treap<AddressOrder> Tree;
+
+  // this returns the lowest addressed block of a subtree with a base page of
+  //  at least '_page' and at least '_pages' pages, nullptr if none
+  Block* findFrom(Block* _root, u64 _page, u64 _pages) const;
+
+  // this returns the lowest addressed block of a subtree holding an aligned
+  //  range, nullptr if none
+  //  '_probes' counts down the failed blocks smaller than '_guaranteed'
+  //  pages, when it is 0 only blocks of at least '_guaranteed' pages match
+  Block* findAlignedFrom(Block* _root, u64 _pages, u64 _guaranteed,
+                         u64 _alignment, u64* _probes, u64* _base) const;
+
+  const u64 minBlockSize_;
+  Block* root_;
+  mutable SearchCount search_;
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_FIRSTFIT_H_
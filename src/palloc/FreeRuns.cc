@@ -0,0 +1,261 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/FreeRuns.h"
+
+#include <cassert>
+
+#include <algorithm>
+
+namespace palloc {
+
+const u64 FreeRuns::kMinPoolChunk;
+
+FreeRuns::FreeRuns()
+    : poolNodes_(0), freeNodes_(nullptr), root_(nullptr), count_(0) {}
+
+void FreeRuns::insert(u64 _base, u64 _pages) {
+  // grow the pool geometrically when it is exhausted
+  if (freeNodes_ == nullptr) {
+    u64 nodes = std::max(poolNodes_, kMinPoolChunk);
+    poolChunks_.emplace_back(new Node[nodes]);
+    Node* chunk = poolChunks_.back().get();
+    poolNodes_ += nodes;
+    for (u64 idx = nodes; idx > 0; idx--) {
+      chunk[idx - 1].left = freeNodes_;
+      freeNodes_ = &chunk[idx - 1];
+    }
+  }
+  Node* node = freeNodes_;
+  freeNodes_ = node->left;
+  node->base = _base;
+  node->pages = _pages;
+  root_ = insert(root_, node);
+  count_++;
+}
+
+void FreeRuns::remove(u64 _base) {
+  Node* node = nullptr;
+  root_ = remove(root_, _base, &node);
+  assert(node != nullptr);
+  count_--;
+
+  // push the node onto the unused node stack
+  node->left = freeNodes_;
+  freeNodes_ = node;
+}
+
+u64 FreeRuns::find(u64 _page, u64* _pages) const {
+  // find the last run with a base page of at most '_page'
+  const Node* best = nullptr;
+  for (const Node* node = root_; node != nullptr;) {
+    if (node->base <= _page) {
+      best = node;
+      node = node->right;
+    } else {
+      node = node->left;
+    }
+  }
+  if (best == nullptr || best->base + best->pages <= _page) {
+    return INV;
+  }
+  *_pages = best->pages;
+  return best->base;
+}
+
+u64 FreeRuns::largest() const {
+  return root_ == nullptr ? 0 : root_->maxPages;
+}
+
+bool FreeRuns::findAligned(u64 _pages, u64 _alignment,
+                           u64 _minBlockSize) const {
+  // any run this large holds an aligned range
+  u64 guaranteed = _pages + _minBlockSize + _alignment - 1;
+  if (guaranteed <= _pages) {
+    guaranteed = U64_MAX;
+  }
+  u64 probes = kAlignedProbes;
+  return findAligned(root_, _pages, guaranteed, _alignment, _minBlockSize,
+                     &probes);
+}
+
+u64 FreeRuns::metadataBytes() const {
+  return poolNodes_ * sizeof(Node) +
+      poolChunks_.capacity() * sizeof(std::unique_ptr<Node[]>);
+}
+
+u64 FreeRuns::verify() const {
+  u64 end = 0;
+  u64 count = verify(root_, &end);
+  (void)count;  // unused
+  assert(count == count_);
+  return count_;
+}
+
+/*** private below here ***/
+
+u64 FreeRuns::priority(const Node* _node) {
+  // a mix of the node's address, stable while the node is in the index
+  u64 hash = (u64)_node;
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDlu;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+void FreeRuns::update(Node* _node) {
+  _node->maxPages = _node->pages;
+  if (_node->left != nullptr) {
+    _node->maxPages = std::max(_node->maxPages, _node->left->maxPages);
+  }
+  if (_node->right != nullptr) {
+    _node->maxPages = std::max(_node->maxPages, _node->right->maxPages);
+  }
+}
+
+FreeRuns::Node* FreeRuns::insert(Node* _root, Node* _node) {
+  // the node takes the place of the first node of a lower priority and the
+  //  subtree found there is split between the node's children
+  if (_root == nullptr || priority(_node) > priority(_root)) {
+    split(_root, _node->base, &_node->left, &_node->right);
+    update(_node);
+    return _node;
+  }
+  if (_node->base < _root->base) {
+    _root->left = insert(_root->left, _node);
+  } else {
+    _root->right = insert(_root->right, _node);
+  }
+  update(_root);
+  return _root;
+}
+
+FreeRuns::Node* FreeRuns::remove(Node* _root, u64 _base, Node** _node) {
+  // the children of the node are merged into its place
+  assert(_root != nullptr);
+  if (_root->base == _base) {
+    *_node = _root;
+    return merge(_root->left, _root->right);
+  }
+  if (_base < _root->base) {
+    _root->left = remove(_root->left, _base, _node);
+  } else {
+    _root->right = remove(_root->right, _base, _node);
+  }
+  update(_root);
+  return _root;
+}
+
+void FreeRuns::split(Node* _root, u64 _base, Node** _lower, Node** _upper) {
+  if (_root == nullptr) {
+    *_lower = nullptr;
+    *_upper = nullptr;
+    return;
+  }
+  if (_root->base < _base) {
+    *_lower = _root;
+    split(_root->right, _base, &_root->right, _upper);
+  } else {
+    *_upper = _root;
+    split(_root->left, _base, _lower, &_root->left);
+  }
+  update(_root);
+}
+
+FreeRuns::Node* FreeRuns::merge(Node* _lower, Node* _upper) {
+  if (_lower == nullptr) {
+    return _upper;
+  }
+  if (_upper == nullptr) {
+    return _lower;
+  }
+  if (priority(_lower) > priority(_upper)) {
+    _lower->right = merge(_lower->right, _upper);
+    update(_lower);
+    return _lower;
+  } else {
+    _upper->left = merge(_lower, _upper->left);
+    update(_upper);
+    return _upper;
+  }
+}
+
+bool FreeRuns::findAligned(const Node* _root, u64 _pages, u64 _guaranteed,
+                           u64 _alignment, u64 _minBlockSize, u64* _probes) {
+  // skip subtrees without a large enough run, only runs of the guaranteed
+  //  size are large enough once the probes run out
+  if (_root == nullptr ||
+      _root->maxPages < (*_probes > 0 ? _pages : _guaranteed)) {
+    return false;
+  }
+
+  // check the runs in page order
+  if (findAligned(_root->left, _pages, _guaranteed, _alignment, _minBlockSize,
+                  _probes)) {
+    return true;
+  }
+  if (_root->pages >= (*_probes > 0 ? _pages : _guaranteed)) {
+    Block run(_root->base, _root->pages, false, nullptr, nullptr);
+    if (alignedBase(&run, _pages, _alignment, _minBlockSize) != INV) {
+      return true;
+    }
+    (*_probes)--;
+  }
+  return findAligned(_root->right, _pages, _guaranteed, _alignment,
+                     _minBlockSize, _probes);
+}
+
+u64 FreeRuns::verify(const Node* _root, u64* _end) {
+  if (_root == nullptr) {
+    return 0;
+  }
+  u64 count = verify(_root->left, _end);
+  assert(_root->left == nullptr || priority(_root->left) <= priority(_root));
+  assert(_root->right == nullptr ||
+         priority(_root->right) <= priority(_root));
+
+  // the runs are disjoint, in page order, and the largest is kept
+  assert(_root->pages > 0);
+  assert(*_end <= _root->base);
+  *_end = _root->base + _root->pages;
+  count += 1 + verify(_root->right, _end);
+  u64 maxPages = _root->pages;
+  if (_root->left != nullptr) {
+    maxPages = std::max(maxPages, _root->left->maxPages);
+  }
+  if (_root->right != nullptr) {
+    maxPages = std::max(maxPages, _root->right->maxPages);
+  }
+  (void)maxPages;  // unused
+  assert(_root->maxPages == maxPages);
+  return count;
+}
+
+}  // namespace palloc
@@ -0,0 +1,132 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_FREERUNS_H_
+#define PALLOC_FREERUNS_H_
+
+#include <prim/prim.h>
+
+#include <memory>
+#include <vector>
+
+#include "palloc/Block.h"
+
+namespace palloc {
+
+/*
+ * This is an index of disjoint runs of free pages ordered by base page. Each
+ * node also holds the largest run in its subtree so the largest run is known
+ * in O(1) time. It is a treap of pooled nodes with priorities hashed from the
+ * node address. Insertion and removal split and merge subtrees in expected
+ * O(log n) time.
+ */
+class FreeRuns {
+ public:
+  FreeRuns();
+
+  // adds a run, it must not overlap the runs in the index
+  void insert(u64 _base, u64 _pages);
+
+  // removes the run starting at '_base'
+  void remove(u64 _base);
+
+  // returns the base page of the run holding '_page' and sets '_pages' to its
+  //  number of pages, INV if no run holds it
+  u64 find(u64 _page, u64* _pages) const;
+
+  // returns the number of pages of the largest run, 0 if none
+  u64 largest() const;
+
+  // returns true if a run holds '_pages' pages at a multiple of '_alignment'
+  //  (see alignedBase()), at most kAlignedProbes runs that are too small to
+  //  surely hold them are checked
+  bool findAligned(u64 _pages, u64 _alignment, u64 _minBlockSize) const;
+
+  // returns the number of runs in the index
+  u64 count() const {
+    return count_;
+  }
+
+  // returns the number of bytes of heap memory used by the index, this only
+  //  grows because the node pool is never shrunk
+  u64 metadataBytes() const;
+
+  // verifies the index, returns the number of runs in it
+  u64 verify() const;
+
+ private:
+  struct Node {
+    u64 base;
+    u64 pages;
+    u64 maxPages;  // largest run in the subtree
+    Node* left;  // also links the unused nodes
+    Node* right;
+  };
+
+  static const u64 kMinPoolChunk = 64;
+
+  // this returns the priority of a node
+  static u64 priority(const Node* _node);
+
+  // this recomputes the largest run of a subtree from its children
+  static void update(Node* _node);
+
+  // this inserts a node into a subtree, returns the new subtree root
+  static Node* insert(Node* _root, Node* _node);
+
+  // this removes the node starting at '_base' from a subtree, returns the new
+  //  subtree root and sets '_node' to the removed node
+  static Node* remove(Node* _root, u64 _base, Node** _node);
+
+  // this splits a subtree into the nodes below '_base' and the others
+  static void split(Node* _root, u64 _base, Node** _lower, Node** _upper);
+
+  // this merges two subtrees, all of '_lower' is below all of '_upper'
+  static Node* merge(Node* _lower, Node* _upper);
+
+  // this searches a subtree for an aligned range in page order
+  static bool findAligned(const Node* _root, u64 _pages, u64 _guaranteed,
+                          u64 _alignment, u64 _minBlockSize, u64* _probes);
+
+  // this verifies a subtree, returns its number of nodes and sets '_end' to
+  //  the end of its last run
+  static u64 verify(const Node* _root, u64* _end);
+
+  std::vector<std::unique_ptr<Node[]> > poolChunks_;
+  u64 poolNodes_;  // total number of nodes in the pool
+  Node* freeNodes_;  // stack of unused nodes linked by 'left'
+
+  Node* root_;
+  u64 count_;
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_FREERUNS_H_
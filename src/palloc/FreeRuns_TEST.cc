@@ -0,0 +1,104 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/FreeRuns.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <random>
+
+TEST(FreeRuns, findAndLargest) {
+  // runs of 1 to 8 pages in slots of 10 pages are added and removed at random
+  const u64 kSlots = 1000;
+  palloc::FreeRuns runs;
+  ASSERT_EQ(runs.largest(), 0u);
+  u64 pages;
+  ASSERT_EQ(runs.find(0, &pages), palloc::INV);
+  std::map<u64, u64> expected;
+  std::mt19937_64 rnd(12345);
+  for (u64 iter = 0; iter < 20000; iter++) {
+    u64 base = (rnd() % kSlots) * 10;
+    if (expected.count(base) == 0) {
+      u64 size = 1 + rnd() % 8;
+      runs.insert(base, size);
+      expected[base] = size;
+    } else {
+      runs.remove(base);
+      expected.erase(base);
+    }
+    ASSERT_EQ(runs.count(), expected.size());
+
+    u64 largest = 0;
+    for (const auto& run : expected) {
+      largest = std::max(largest, run.second);
+    }
+    ASSERT_EQ(runs.largest(), largest);
+
+    u64 page = rnd() % (kSlots * 10 + 10);
+    auto it = expected.upper_bound(page);
+    u64 found = palloc::INV;
+    if (it != expected.begin() && std::prev(it)->first +
+        std::prev(it)->second > page) {
+      found = std::prev(it)->first;
+      ASSERT_EQ(runs.find(page, &pages), found);
+      ASSERT_EQ(pages, std::prev(it)->second);
+    } else {
+      ASSERT_EQ(runs.find(page, &pages), found);
+    }
+    if (iter % 1000 == 0) {
+      ASSERT_EQ(runs.verify(), expected.size());
+    }
+  }
+  ASSERT_GT(runs.metadataBytes(), 0u);
+}
+
+TEST(FreeRuns, findAligned) {
+  palloc::FreeRuns runs;
+  ASSERT_FALSE(runs.findAligned(1, 1, 1));
+
+  // no run holds 4 pages at a multiple of 8 without a leading remainder of
+  //  less than 2 pages
+  runs.insert(3, 6);
+  runs.insert(17, 5);
+  runs.insert(41, 4);
+  ASSERT_TRUE(runs.findAligned(4, 1, 2));
+  ASSERT_FALSE(runs.findAligned(4, 8, 2));
+
+  // this one does
+  runs.insert(86, 7);
+  ASSERT_TRUE(runs.findAligned(4, 8, 2));
+  runs.remove(86);
+  ASSERT_FALSE(runs.findAligned(4, 8, 2));
+  ASSERT_EQ(runs.verify(), 3u);
+}
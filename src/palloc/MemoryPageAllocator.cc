@@ -0,0 +1,198 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/MemoryPageAllocator.h"
+
+#include <bits/bits.h>
+#include <ex/Exception.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cassert>
+
+#include <algorithm>
+
+namespace palloc {
+
+namespace {
+
+s32 releaseAdvice(bool _lazyRelease) {
+#ifdef MADV_FREE
+  return _lazyRelease ? MADV_FREE : MADV_DONTNEED;
+#else
+  (void)_lazyRelease;
+  return MADV_DONTNEED;
+#endif  // MADV_FREE
+}
+
+}  // namespace
+
+const u64 MemoryPageAllocator::kHugePageBytes;
+
+MemoryPageAllocator::MemoryPageAllocator(
+    u64 _pages, u64 _minBlockSize, u64 _pageSize, u64 _releasePages,
+    bool _lazyRelease, bool _hugePages)
+    : pageSize_(_pageSize), releasePages_(_releasePages),
+      releaseAdvice_(releaseAdvice(_lazyRelease)), hugePages_(_hugePages),
+      allocator_(_pages, _minBlockSize), releasedPages_(0) {
+  // check input parameters
+  u64 osPageSize = sysconf(_SC_PAGESIZE);
+  if (!bits::isPow2(pageSize_) || pageSize_ < osPageSize) {
+    throw new ex::Exception("pageSize must be a power of 2 and a multiple of "
+                            "the OS page size");
+  }
+  if (_pages > (U64_MAX - kHugePageBytes) / pageSize_) {
+    throw new ex::Exception("pages x pageSize is too large");
+  }
+
+  // reserve the arena, with slack to align it to a huge page if needed
+  u64 alignment = hugePages_ ? std::max(kHugePageBytes, pageSize_) :
+      pageSize_;
+  mappingBytes_ = _pages * pageSize_ + (alignment - osPageSize);
+  mapping_ = mmap(nullptr, mappingBytes_, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mapping_ == MAP_FAILED) {
+    throw new ex::Exception("unable to reserve the arena");
+  }
+  u64 start = reinterpret_cast<u64>(mapping_);
+  arena_ = reinterpret_cast<u8*>((start + alignment - 1) & ~(alignment - 1));
+}
+
+MemoryPageAllocator::~MemoryPageAllocator() {
+  munmap(mapping_, mappingBytes_);
+}
+
+void* MemoryPageAllocator::createBlock(u64 _pages) {
+  u64 base = allocator_.createBlock(_pages);
+  if (base == INV) {
+    return nullptr;
+  }
+  if (hugePages_) {
+    adviseHugePages(base, allocator_.blockSize(base));
+  }
+  return address(base);
+}
+
+void* MemoryPageAllocator::createAlignedBlock(u64 _pages, u64 _alignment) {
+  u64 base = allocator_.createAlignedBlock(_pages, _alignment);
+  if (base == INV) {
+    return nullptr;
+  }
+  if (hugePages_) {
+    adviseHugePages(base, allocator_.blockSize(base));
+  }
+  return address(base);
+}
+
+bool MemoryPageAllocator::freeBlock(void* _block) {
+  u64 base = page(_block);
+  if (base == INV) {
+    return false;
+  }
+  u64 pages = allocator_.blockSize(base);
+  if (!allocator_.freeBlock(base)) {
+    return false;
+  }
+  release(base, pages);
+  return true;
+}
+
+bool MemoryPageAllocator::shrinkBlock(void* _block, u64 _pages) {
+  u64 base = page(_block);
+  if (base == INV) {
+    return false;
+  }
+  u64 pages = allocator_.blockSize(base);
+  if (!allocator_.shrinkBlock(base, _pages)) {
+    return false;
+  }
+
+  // the block keeps a tail too small to split off, zero pages frees it
+  u64 kept = allocator_.blockSize(base);
+  release(base + kept, pages - kept);
+  return true;
+}
+
+u64 MemoryPageAllocator::page(const void* _address) const {
+  const u8* address = static_cast<const u8*>(_address);
+  if (address < arena_) {
+    return INV;
+  }
+  u64 offset = address - arena_;
+  if (offset % pageSize_ != 0 ||
+      offset / pageSize_ >= allocator_.totalPages()) {
+    return INV;
+  }
+  return offset / pageSize_;
+}
+
+void* MemoryPageAllocator::address(u64 _page) const {
+  assert(_page < allocator_.totalPages());
+  return arena_ + _page * pageSize_;
+}
+
+u64 MemoryPageAllocator::pageSize() const {
+  return pageSize_;
+}
+
+u64 MemoryPageAllocator::releasedPages() const {
+  return releasedPages_;
+}
+
+const PageAllocator& MemoryPageAllocator::allocator() const {
+  return allocator_;
+}
+
+void MemoryPageAllocator::release(u64 _base, u64 _pages) {
+  if (releasePages_ == 0 || _pages < releasePages_) {
+    return;
+  }
+  if (madvise(address(_base), _pages * pageSize_, releaseAdvice_) == 0) {
+    releasedPages_ += _pages;
+  }
+}
+
+void MemoryPageAllocator::adviseHugePages(u64 _base, u64 _pages) {
+#ifdef MADV_HUGEPAGE
+  // only advise the huge pages the block covers entirely
+  u64 start = reinterpret_cast<u64>(address(_base));
+  u64 end = start + _pages * pageSize_;
+  start = (start + kHugePageBytes - 1) & ~(kHugePageBytes - 1);
+  end &= ~(kHugePageBytes - 1);
+  if (start < end) {
+    madvise(reinterpret_cast<void*>(start), end - start, MADV_HUGEPAGE);
+  }
+#else
+  (void)_base;
+  (void)_pages;
+#endif  // MADV_HUGEPAGE
+}
+
+}  // namespace palloc
@@ -0,0 +1,128 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_MEMORYPAGEALLOCATOR_H_
+#define PALLOC_MEMORYPAGEALLOCATOR_H_
+
+#include <prim/prim.h>
+
+#include "palloc/PageAllocator.h"
+
+namespace palloc {
+
+/*
+ * This binds a PageAllocator to real memory. It reserves an anonymous mapping
+ * of pages x pageSize bytes up front and hands out pointers into it. The
+ * reservation doesn't commit memory, the OS backs each page when it is first
+ * touched.
+ *
+ * Freed ranges of at least releasePages pages (including the tail given back
+ * by shrinkBlock()) are returned to the OS with madvise(). MADV_DONTNEED
+ * releases them immediately and they read as zeros when reused. MADV_FREE
+ * (lazy release) lets the OS reclaim them only under memory pressure, so
+ * their contents are undefined when reused. Smaller ranges stay resident.
+ *
+ * With huge pages enabled the reservation is aligned to kHugePageBytes and
+ * every block is advised with MADV_HUGEPAGE over the aligned huge pages it
+ * covers entirely, so transparent huge pages back large blocks (use
+ * createAlignedBlock() to align them) without inflating small ones. The
+ * advice stays with the pages after the block is freed.
+ */
+
+class MemoryPageAllocator {
+ public:
+  // the transparent huge page size on x86-64 and most arm64 kernels
+  static const u64 kHugePageBytes = (u64)2 << 20;
+
+  // '_pageSize' is the number of bytes per page, it must be a power of 2 and
+  //  a multiple of the OS page size
+  // '_releasePages' is the smallest freed range returned to the OS, zero
+  //  disables releasing
+  // '_lazyRelease' selects MADV_FREE over MADV_DONTNEED (when available)
+  // '_hugePages' enables transparent huge page advice
+  MemoryPageAllocator(u64 _pages, u64 _minBlockSize, u64 _pageSize,
+                      u64 _releasePages, bool _lazyRelease, bool _hugePages);
+  ~MemoryPageAllocator();
+
+  // allocates a block
+  //  returns the address of the block, nullptr if none
+  void* createBlock(u64 _pages);
+
+  // allocates a block whose base page is a multiple of '_alignment' pages
+  //  '_alignment' must be a power of 2
+  //  returns the address of the block, nullptr if none
+  void* createAlignedBlock(u64 _pages, u64 _alignment);
+
+  // frees an allocated block, releasing it to the OS if large enough
+  //  returns true if success, false otherwise
+  bool freeBlock(void* _block);
+
+  // shrinks an allocated block, releasing the tail to the OS if large enough
+  //  'pages' is the total requested size
+  //  returns true if success, false otherwise
+  bool shrinkBlock(void* _block, u64 _pages);
+
+  // returns the page at an address, INV if outside the reservation
+  u64 page(const void* _address) const;
+
+  // returns the address of a page
+  void* address(u64 _page) const;
+
+  // returns the number of bytes per page
+  u64 pageSize() const;
+
+  // returns the total number of pages released to the OS
+  u64 releasedPages() const;
+
+  // returns the page allocator
+  const PageAllocator& allocator() const;
+
+ private:
+  // this returns a range of pages to the OS if large enough
+  void release(u64 _base, u64 _pages);
+
+  // this advises the huge pages covered by a range of pages
+  void adviseHugePages(u64 _base, u64 _pages);
+
+  const u64 pageSize_;
+  const u64 releasePages_;
+  const s32 releaseAdvice_;  // MADV_DONTNEED or MADV_FREE
+  const bool hugePages_;
+
+  PageAllocator allocator_;
+  u8* arena_;  // first page
+  void* mapping_;  // the whole mapping including the alignment slack
+  u64 mappingBytes_;
+  u64 releasedPages_;
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_MEMORYPAGEALLOCATOR_H_
@@ -0,0 +1,126 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/MemoryPageAllocator.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <cstring>
+
+TEST(MemoryPageAllocator, pointers) {
+  palloc::MemoryPageAllocator mpa(256, 1, 4096, 0, false, false);
+  ASSERT_EQ(mpa.pageSize(), 4096u);
+  u8* b0 = static_cast<u8*>(mpa.createBlock(10));
+  u8* b1 = static_cast<u8*>(mpa.createBlock(20));
+  ASSERT_NE(b0, nullptr);
+  ASSERT_NE(b1, nullptr);
+  ASSERT_EQ(mpa.page(b0), 0u);
+  ASSERT_EQ(mpa.page(b1), 10u);
+  ASSERT_EQ(mpa.address(10), b1);
+  ASSERT_EQ(mpa.page(b1 + 1), palloc::INV);
+  ASSERT_EQ(mpa.page(b0 - 4096), palloc::INV);
+  ASSERT_EQ(mpa.page(b0 + 256 * 4096), palloc::INV);
+
+  // the memory is usable
+  memset(b0, 0xAB, 10 * 4096);
+  memset(b1, 0xCD, 20 * 4096);
+  ASSERT_EQ(b0[10 * 4096 - 1], 0xAB);
+  ASSERT_EQ(b1[0], 0xCD);
+
+  // nothing is released with a zero threshold
+  ASSERT_TRUE(mpa.freeBlock(b0));
+  ASSERT_FALSE(mpa.freeBlock(b0));
+  ASSERT_FALSE(mpa.freeBlock(b1 + 1));
+  ASSERT_TRUE(mpa.freeBlock(b1));
+  ASSERT_EQ(mpa.releasedPages(), 0u);
+  ASSERT_EQ(mpa.createBlock(300), nullptr);
+  mpa.allocator().verify(false);
+}
+
+TEST(MemoryPageAllocator, release) {
+  palloc::MemoryPageAllocator mpa(256, 1, 4096, 8, false, false);
+  u8* b0 = static_cast<u8*>(mpa.createBlock(4));
+  u8* b1 = static_cast<u8*>(mpa.createBlock(16));
+  memset(b0, 0xAB, 4 * 4096);
+  memset(b1, 0xCD, 16 * 4096);
+
+  // small ranges stay resident
+  ASSERT_TRUE(mpa.freeBlock(b0));
+  ASSERT_EQ(mpa.releasedPages(), 0u);
+  ASSERT_EQ(b0[0], 0xAB);
+
+  // large ranges are released and read as zeros
+  ASSERT_TRUE(mpa.shrinkBlock(b1, 4));
+  ASSERT_EQ(mpa.releasedPages(), 12u);
+  ASSERT_EQ(b1[4 * 4096 - 1], 0xCD);
+  ASSERT_EQ(b1[4 * 4096], 0);
+  ASSERT_EQ(b1[16 * 4096 - 1], 0);
+  ASSERT_TRUE(mpa.shrinkBlock(b1, 2));
+  ASSERT_EQ(mpa.releasedPages(), 12u);
+  ASSERT_TRUE(mpa.freeBlock(b1));
+  ASSERT_EQ(mpa.releasedPages(), 12u);
+
+  u8* b2 = static_cast<u8*>(mpa.createBlock(200));
+  memset(b2, 0xEF, 200 * 4096);
+  ASSERT_TRUE(mpa.freeBlock(b2));
+  ASSERT_EQ(mpa.releasedPages(), 212u);
+  ASSERT_EQ(b2[100 * 4096], 0);
+  mpa.allocator().verify(false);
+
+  // lazy release leaves the contents undefined but the memory usable
+  palloc::MemoryPageAllocator lazy(256, 1, 4096, 8, true, false);
+  u8* b3 = static_cast<u8*>(lazy.createBlock(100));
+  memset(b3, 0xAB, 100 * 4096);
+  ASSERT_TRUE(lazy.freeBlock(b3));
+  ASSERT_EQ(lazy.releasedPages(), 100u);
+  b3 = static_cast<u8*>(lazy.createBlock(100));
+  memset(b3, 0xCD, 100 * 4096);
+  ASSERT_EQ(b3[50 * 4096], 0xCD);
+}
+
+TEST(MemoryPageAllocator, hugePages) {
+  const u64 kHugePages = palloc::MemoryPageAllocator::kHugePageBytes / 4096;
+  palloc::MemoryPageAllocator mpa(4 * kHugePages, 1, 4096, kHugePages, false,
+                                  true);
+
+  // the arena starts on a huge page so aligned blocks are huge page aligned
+  void* b0 = mpa.createBlock(3);
+  void* b1 = mpa.createAlignedBlock(2 * kHugePages, kHugePages);
+  ASSERT_EQ(mpa.page(b0), 0u);
+  ASSERT_EQ(mpa.page(b1), kHugePages);
+  ASSERT_EQ(reinterpret_cast<u64>(b1) %
+            palloc::MemoryPageAllocator::kHugePageBytes, 0u);
+  memset(b1, 0xAB, palloc::MemoryPageAllocator::kHugePageBytes * 2);
+  ASSERT_TRUE(mpa.freeBlock(b1));
+  ASSERT_EQ(mpa.releasedPages(), 2 * kHugePages);
+  ASSERT_TRUE(mpa.freeBlock(b0));
+  mpa.allocator().verify(false);
+}
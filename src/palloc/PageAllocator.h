@@ -34,30 +34,99 @@
 #include <ex/Exception.h>
 #include <prim/prim.h>
 
-#include <list>
-#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <string>
 #include <vector>
 
+#include "palloc/BestFit.h"
+#include "palloc/Block.h"
+#include "palloc/FirstFit.h"
+#include "palloc/FreeRuns.h"
+#include "palloc/NextFit.h"
+#include "palloc/SizeClasses.h"
+#include "palloc/Snapshot.h"
+#include "palloc/Stats.h"
+#include "palloc/Trace.h"
+#include "palloc/Treap.h"
+
 namespace palloc {
 
-const u64 INV = U64_MAX;
+// a range of pages whose contents move from one base page to another
+struct Move {
+  u64 from;  // old base page
+  u64 to;  // new base page
+  u64 pages;  // number of pages to copy, zero if nothing moves
+};
 
 /*
- * This is an implementation of an exponential (i.e., powers of 2), sorted
- * (e.g., best memory utilization) segregated fit free list allocator.
- * Unlike common allocators, the metadata is stored in this class, not
- * in the memory itself.
+ * This is a page allocator whose free block placement is chosen at compile
+ * time by the 'Placement' policy. Unlike common allocators, the metadata is
+ * stored in this class, not in the memory itself.
+ *
+ * The policy owns the index of free blocks and decides which one satisfies
+ * a request. It links blocks through the intrusive tree fields of the blocks
+ * so linking and unlinking never allocates. The policies are:
+ *  BestFit   exponential (i.e., powers of 2) sorted segregated fit (default)
+ *  StaticBestFit<Pages, MinBlockSize>  best fit of a fixed geometry (see
+ *            StaticPageAllocator.h)
+ *  FirstFit  lowest addressed fit from an address ordered tree
+ *  NextFit   first fit starting from the previous allocation
+ * A policy provides:
+ *  Placement(u64 _pages, u64 _minBlockSize);
+ *  void link(Block* _block);
+ *  void unlink(Block* _block);
+ *  Block* find(u64 _pages);
+ *  Block* findAligned(u64 _pages, u64 _alignment, u64* _base) const;
+ *  u64 largest() const;  // size of the largest indexed block, 0 if none
+ *  Block* floor(u64 _page) const;  // last indexed block at or before a page
+ *  bool resize(u64 _pages);  // false if the policy can't change its pages
+ *  SearchCount takeSearchCount() const;  // see Stats.h (counts are mutable)
+ *  u64 metadataBytes() const;  // heap memory used by the index
+ *  u64 verify(bool _print) const;  // returns the number of indexed blocks
+ *
+ * Block metadata is carved out of large pool chunks and recycled through a
+ * stack of unused slots, so splitting and coalescing blocks never calls the
+ * system allocator once the pool is large enough. Used blocks are found by
+ * base page in a flat open addressing table of block pointers.
  */
 
-class PageAllocator {
+template <typename Placement>
+class BasicPageAllocator {
  public:
-  PageAllocator(u64 _pages, u64 _minBlockSize);
-  ~PageAllocator();
+  // '_reserveBlocks' preallocates block metadata for that many blocks so
+  //  the pool doesn't need to grow until more blocks than that exist
+  BasicPageAllocator(u64 _pages, u64 _minBlockSize, u64 _reserveBlocks = 0);
+  ~BasicPageAllocator();
 
   // allocates a block
   //  returns the base page of the block
   u64 createBlock(u64 _pages);
 
+  // allocates a block whose base page is a multiple of '_alignment'
+  //  '_alignment' must be a power of 2
+  //  the unaligned leading pages are split off as a free block
+  //  when no free block is large enough to surely hold the aligned range,
+  //  the placement policy only checks kAlignedProbes smaller blocks (see
+  //  Block.h) so this can fail even though an aligned range is free
+  //  returns the base page of the block
+  u64 createAlignedBlock(u64 _pages, u64 _alignment);
+
+  // allocates a block at a fixed base page (e.g., a reserved region)
+  //  every page of the range must be free, the free block holding it is
+  //  found by page in O(log n) time and the leading and trailing free pages
+  //  are split off as free blocks
+  //  the leading free pages must be either none or at least minBlockSize
+  //  returns true if success, false otherwise (nothing is allocated)
+  bool createBlockAt(u64 _base, u64 _pages);
+
+  // allocates a batch of blocks at fixed base pages, all or nothing
+  //  '_bases' and '_pages' hold the ranges, which may be in any order
+  //  the ranges are sorted then each is found by page, so this takes
+  //  O(k log k + k log n) time for k ranges rather than a walk per range
+  //  returns true if success, false otherwise (nothing is allocated)
+  bool reserveRanges(const u64* _bases, const u64* _pages, u64 _count);
+
   // frees an allocated block
   //  returns true if success, false otherwise
   bool freeBlock(u64 _block);
@@ -67,12 +136,161 @@ class PageAllocator {
   //  returns true if success, false otherwise
   bool shrinkBlock(u64 _block, u64 _pages);
 
+  // frees '_pages' pages starting '_offset' pages into an allocated block
+  //  the pages before the gap stay a block at '_block' and the pages after
+  //  it become a block at '_block' + '_offset' + '_pages'
+  //  the gap is coalesced with free neighbors and is reusable at once,
+  //  nothing is copied
+  //  releasing the whole block frees it, otherwise the gap must have at
+  //  least minBlockSize pages
+  //  returns true if success, false otherwise (nothing changes)
+  bool releaseRange(u64 _block, u64 _offset, u64 _pages);
+
   // grows an allocated block
   //  'pages' is the total requested size
   //  Note: this does not do any page migration
   //  returns the base page of the block if success, INV otherwise
   bool growBlock(u64 _block, u64 _pages);
 
+  // resizes an allocated block, moving it only when needed
+  //  'pages' is the total requested size
+  //  this tries, in order, to shrink or grow forward in place, grow backward
+  //  into the previous free block (after consuming the next free block if
+  //  needed), and finally to relocate to a new block
+  //  '_move' receives the pages the caller must copy, the ranges overlap when
+  //  growing backward so the copy must be memmove safe
+  //  returns the base page of the block if success, INV otherwise (nothing
+  //  changes)
+  u64 resizeBlock(u64 _block, u64 _pages, Move* _move);
+
+  // allocates a batch of blocks, all or nothing
+  //  '_pages' holds the requested sizes and '_blocks' receives the base pages
+  //  the batch is carved contiguously from one free block when possible
+  //  returns true if success, false otherwise (nothing is allocated)
+  bool createBlocks(const u64* _pages, u64 _count, u64* _blocks);
+
+  // frees a batch of allocated blocks
+  //  the blocks are freed in page order and coalesced in a single pass
+  //  returns true if success, false otherwise (nothing is freed)
+  bool freeBlocks(const u64* _blocks, u64 _count);
+
+  // appends '_morePages' free pages to the end of the space (e.g., hot added
+  //  memory), they are coalesced with a trailing free block
+  //  a new trailing free block must have at least minBlockSize pages
+  //  only the size classes that change are refiled, this fails with a fixed
+  //  geometry (see StaticPageAllocator.h)
+  //  returns true if success, false otherwise (nothing changes)
+  bool extend(u64 _morePages);
+
+  // removes the pages at and beyond '_newPages' from the end of the space
+  //  all of the removed pages must be free and what is left of their free
+  //  block must be either nothing or at least minBlockSize pages
+  //  only the size classes that change are refiled, this fails with a fixed
+  //  geometry (see StaticPageAllocator.h)
+  //  returns true if success, false otherwise (no allocation changes)
+  bool truncate(u64 _newPages);
+
+  // configures deferred coalescing, which is disabled by default
+  //  freed blocks of at most '_quickPages' pages are kept uncoalesced in
+  //  quick lists of exact sizes and reused first by createBlock
+  //  all blocks are coalesced when an allocation can't otherwise be
+  //  satisfied or when the quick listed pages exceed '_threshold' times the
+  //  free pages
+  //  '_quickPages' of zero disables deferred coalescing
+  void setDeferredCoalescing(u64 _quickPages, f64 _threshold);
+
+  // coalesces all adjacent free blocks in a single pass over the blocks
+  //  this also empties the quick lists
+  void coalesceAll();
+
+  // plans a compaction that packs used blocks toward page 0 to make the
+  //  largest free block within a budget
+  //  the plan picks the run of consecutive free blocks with the most free
+  //  pages whose used blocks in between total at most '_budget' pages, then
+  //  slides those used blocks down in page order so the run becomes one
+  //  free block, this takes O(n) time
+  //  an empty plan means no moves within the budget beat the largest free
+  //  block
+  //  '_plan' receives the moves in the order they must be committed
+  //  returns the number of pages the plan moves
+  u64 planCompaction(u64 _budget, std::vector<Move>* _plan) const;
+
+  // commits one planned move to the blocks
+  //  the block must still start at 'from' and the free pages directly before
+  //  it must start at 'to', the ranges may overlap
+  //  returns true if success, false if the move is no longer valid (no
+  //  allocation changes)
+  bool commitMove(const Move& _move);
+
+  // commits up to '_count' moves of a plan starting at move '_first'
+  //  '_copy' is called after each move is committed so the caller can copy
+  //  the contents with memmove, a plan may be committed across many calls to
+  //  bound pauses as long as no other calls change the allocator in between
+  //  returns the number of moves committed
+  u64 commitCompaction(const std::vector<Move>& _plan, u64 _first,
+                       u64 _count,
+                       const std::function<void(const Move&)>& _copy);
+
+  // starts recording every call that changes the allocator to a binary trace
+  //  file (see Trace.h), replacing any trace in progress
+  //  the trace replays exactly only when started on a fresh allocator
+  //  returns true if success, false otherwise
+  bool startTrace(const std::string& _path);
+
+  // stops recording and closes the trace file
+  //  returns true if the whole trace was written, false otherwise
+  bool stopTrace();
+
+  // saves the blocks to a snapshot file (see Snapshot.h)
+  //  returns true if success, false otherwise
+  bool saveSnapshot(const std::string& _path) const;
+
+  // replaces the blocks with those of a snapshot file, the snapshot must
+  //  have the same number of pages and minimum block size
+  //  the file is mapped and walked once, adjacent free blocks are merged
+  //  and the deferred coalescing setting is kept
+  //  returns true if success, false otherwise (nothing changes)
+  bool loadSnapshot(const std::string& _path);
+
+  // returns the size of the largest free block once adjacent free blocks
+  //  are coalesced, 0 if none
+  //  the placement index gives its largest block in O(1) time with first and
+  //  next fit and O(log n) time with best fit, runs of adjacent free blocks
+  //  left by deferred coalescing are kept in an index of their own as blocks
+  //  are linked and unlinked, which gives its largest run in O(1) time
+  u64 largestFreeBlock() const;
+
+  // returns true if createBlock() would succeed, possibly after coalescing
+  //  quick listed blocks, nothing changes
+  bool canAllocate(u64 _pages) const;
+
+  // returns true if createAlignedBlock() would succeed, possibly after
+  //  coalescing quick listed blocks, nothing changes
+  //  when the largest free block doesn't settle it the placement policy
+  //  searches as createAlignedBlock() would, as do the runs of adjacent free
+  //  blocks left by deferred coalescing
+  bool canAllocate(u64 _pages, u64 _alignment) const;
+
+  // returns the number of size classes of free blocks (see SizeClasses.h)
+  u64 numClasses() const;
+
+  // returns the number of free blocks in a size class
+  u64 freeBlocksInClass(u64 _index) const;
+
+  // returns the number of free pages in a size class
+  u64 freePagesInClass(u64 _index) const;
+
+  // fills in a snapshot of the free space and the event counters
+  //  the free space by size class is kept as blocks are linked and
+  //  unlinked so this takes O(classes) time, quick listed blocks count as
+  //  separate free blocks but the largest free block and fragmentation are
+  //  those after coalescing (see largestFreeBlock())
+  //  the counters are only kept when built with PALLOC_STATS (see Stats.h)
+  void getStats(Stats* _stats) const;
+
+  // clears the event counters
+  void resetStats();
+
   // returns the total number of blocks
   u64 totalBlocks() const;
 
@@ -91,31 +309,161 @@ class PageAllocator {
   // returns the number of used pages
   u64 usedPages() const;
 
+  // returns the number of pages in the used block starting at '_block',
+  //  which can exceed the requested size by less than minBlockSize pages,
+  //  zero if there is no such block
+  u64 blockSize(u64 _block) const;
+
+  // returns the used block starting at '_block', nullptr if there is no such
+  //  block, the caller may only change its 'cached' flag
+  Block* usedBlock(u64 _block);
+
+  // calls '_visit(base, pages)' for every used block in page order
+  //  this walks the blocks from page 0 and never allocates, the visitor must
+  //  not change the allocator
+  template <typename Visitor>
+  void forEachUsed(Visitor&& _visit) const;
+
+  // calls '_visit(base, pages)' for every free block in page order, quick
+  //  listed blocks are visited separately
+  //  this walks the blocks from page 0 and never allocates, the visitor must
+  //  not change the allocator
+  template <typename Visitor>
+  void forEachFree(Visitor&& _visit) const;
+
+  // calls '_visit(base, pages, used)' for every block holding pages in
+  //  ['_lo', '_hi') in page order
+  //  the walk starts at the last free block at or before '_lo', found in
+  //  O(log n) time, and also touches the used blocks between it and the
+  //  range unless the range index is enabled (see setRangeIndex())
+  //  this never allocates, the visitor must not change the allocator
+  template <typename Visitor>
+  void forEachBlockInRange(u64 _lo, u64 _hi, Visitor&& _visit) const;
+
+  // enables or disables the range index, an address index of the used blocks
+  //  that lets forEachBlockInRange() start next to the range in O(log n)
+  //  time whatever the used blocks before it
+  //  it is disabled by default as every allocation and free pays an O(log n)
+  //  update while enabled, enabling it takes O(n log n) time
+  void setRangeIndex(bool _enable);
+
+  // returns the number of bytes of metadata held by the allocator, this only
+  //  grows because the block pool and used map are never shrunk
+  u64 metadataBytes() const;
+
   // verify internal data structures
   void verify(bool _print) const;
 
  private:
-  struct Block {
-    Block(u64 _base, u64 _size, bool _used, Block* _prev, Block* _next);
-    u64 base;  // starting page
-    u64 size;  // number of pages
-    bool used;
-    Block* prev;
-    Block* next;
+  // these implement the public calls of the same names, calls within the
+  //  allocator use them so only the outermost call is traced
+  u64 createBlockImpl(u64 _pages);
+  u64 createAlignedBlockImpl(u64 _pages, u64 _alignment);
+  bool createBlockAtImpl(u64 _base, u64 _pages);
+  bool reserveRangesImpl(const u64* _bases, const u64* _pages, u64 _count);
+  bool freeBlockImpl(u64 _block);
+  bool shrinkBlockImpl(u64 _block, u64 _pages);
+  bool releaseRangeImpl(u64 _block, u64 _offset, u64 _pages);
+  bool growBlockImpl(u64 _block, u64 _pages);
+  u64 resizeBlockImpl(u64 _block, u64 _pages, Move* _move);
+  bool createBlocksImpl(const u64* _pages, u64 _count, u64* _blocks);
+  bool freeBlocksImpl(const u64* _blocks, u64 _count);
+  void setDeferredCoalescingImpl(u64 _quickPages, f64 _threshold);
+  void coalesceAllImpl();
+  bool commitMoveImpl(const Move& _move);
+  bool extendImpl(u64 _morePages);
+  bool truncateImpl(u64 _newPages);
+
+  // the minimum number of blocks in a pool chunk
+  static const u64 kMinPoolChunk = 1024;
+
+  // this replaces the blocks with those of a mapped snapshot file
+  //  returns true if success, false otherwise (nothing changes)
+  bool restoreSnapshot(const void* _data, u64 _size);
+
+  // this adds a chunk of '_blocks' blocks to the block pool
+  void growPool(u64 _blocks);
+
+  // this takes a block from the block pool
+  Block* newBlock(u64 _base, u64 _size, bool _used, Block* _prev, Block* _next);
+
+  // this returns a block to the block pool
+  void deleteBlock(Block* _block);
+
+  // the range index orders the used blocks by page over the free index
+  //  links, which the placement policy only uses for free blocks
+  struct UsedOrder {
+    static bool less(const Block* _a, const Block* _b);
+    static const bool kAugmented = false;
   };
+  typedef Treap<UsedOrder> UsedTree;
+
+  // this returns the home slot of a base page in the used map
+  u64 usedMapSlot(u64 _base) const;
+
+  // this returns the used block starting at '_base', nullptr if none
+  Block* findUsedBlock(u64 _base) const;
+
+  // this adds a used block to the used map and the range index
+  void insertUsedBlock(Block* _block);
+
+  // this removes a used block from the used map and the range index
+  void eraseUsedBlock(Block* _block);
+
+  // this returns the last used block with a base page of at most '_page',
+  //  nullptr if none or the range index is disabled
+  const Block* findUsedFloor(u64 _page) const;
+
+  // this returns a free block with at least '_pages' pages as chosen by the
+  //  placement policy, nullptr if none
+  Block* findFreeBlock(u64 _pages);
 
-  // this returns the index of the corresponding free list
-  u64 freeListIndex(u64 _pages) const;
+  // this returns a free block holding an aligned range of '_pages' pages as
+  //  chosen by the placement policy and sets '_base' to the aligned base
+  //  page, nullptr if none
+  Block* findAlignedFreeBlock(u64 _pages, u64 _alignment, u64* _base);
 
-  // this links a free block into its free list
+  // this returns the free block holding the range of '_pages' pages at
+  //  '_base' with either no leading pages or at least minBlockSize leading
+  //  pages, nullptr if none
+  Block* findRangeFreeBlock(u64 _base, u64 _pages);
+
+  // this allocates the range of '_pages' pages at '_base' from a linked
+  //  free block, splitting off the leading and trailing free pages
+  //  returns the used block
+  Block* allocateRange(Block* _block, u64 _base, u64 _pages);
+
+  // this adds the work of the last search to the histograms
+  void countSearch();
+
+  // this adds or removes a free block from the size class tallies
+  void countFreeBlock(const Block* _block, bool _add);
+
+  // this returns the tally of a size class, the last class sums the tallies
+  //  of all larger classes
+  u64 foldClass(const std::vector<u64>& _tally, u64 _index) const;
+
+  // this links a free block into the placement index
   void linkFreeBlock(Block* _block);
 
-  // this unlinks a free block from its free list
+  // this links a free block into the quick list of its size
+  void linkQuickBlock(Block* _block);
+
+  // this unlinks a free block from the placement index or its quick list
   void unlinkFreeBlock(Block* _block);
 
+  // this adds a free block being linked to the free runs
+  void linkRun(Block* _block);
+
+  // this removes a free block being unlinked from the free runs
+  void unlinkRun(Block* _block);
+
   // this splits a block into two smaller blocks if possible
   void splitBlock(Block* _block, u64 _pages, bool _coalesce);
 
+  // this grows a used block backward into the previous free block
+  void growBlockBackward(Block* _block, u64 _pages);
+
   // this coalesces a free block in the forward direction
   //  return true if coalescing occurred, false otherwise
   bool coalesceBlockForward(Block* _block);
@@ -124,13 +472,41 @@ class PageAllocator {
   //  return true if coalescing occurred, false otherwise
   bool coalesceBlockBackward(Block* _block);
 
-  const u64 pages_;
+  u64 pages_;
   const u64 minBlockSize_;
 
-  u64 numFreeLists_;
-  std::vector<std::list<Block*> > freeLists_;
-  std::vector<u64> freeListSizes_;
-  std::unordered_map<u64, Block*> usedMap_;
+  Placement placement_;  // the free block index
+  SizeClasses classes_;  // of all free blocks, for the queries
+  const SizeClasses tallyClasses_;  // of the largest space, so the tallies
+                                    //  never change when pages_ changes
+  std::vector<u64> classBlocks_;  // free blocks per tally class
+  std::vector<u64> classPages_;  // free pages per tally class
+  std::vector<Block*> usedMap_;  // linear probing, power of 2 size
+  u64 usedMapShift_;  // 64 - log2(usedMap_.size())
+  bool rangeIndex_;
+  Block* usedRoot_;  // all used blocks in page order (see UsedTree), nullptr
+                     //  without the range index
+
+  std::vector<Block*> poolChunks_;
+  u64 poolBlocks_;  // total number of blocks in the pool
+  Block* freeSlots_;  // stack of unused blocks linked by 'next'
+
+  Block* head_;  // the block at page 0
+  Block* tail_;  // the block at the last page
+
+  u64 quickPages_;  // largest quick listed size, 0 if coalescing is eager
+  f64 quickThreshold_;
+  u64 quickListedPages_;
+  std::vector<Block*> quickLists_;  // indexed by size
+  FreeRuns runs_;  // runs of adjacent free blocks and lone quick listed
+                   //  blocks, lone indexed blocks are left to placement_
+
+  std::vector<u64> batch_;  // scratch space for batch operations
+
+  std::unique_ptr<TraceWriter> trace_;  // nullptr when not tracing
+
+  // nullptr without PALLOC_STATS, the layout doesn't depend on it
+  std::unique_ptr<StatCounters> counters_;
 
   u64 freeBlocks_;
   u64 usedBlocks_;
@@ -138,7 +514,18 @@ class PageAllocator {
   u64 usedPages_;
 };
 
+// the default allocator uses best fit placement
+typedef BasicPageAllocator<BestFit> PageAllocator;
+typedef BasicPageAllocator<FirstFit> FirstFitPageAllocator;
+typedef BasicPageAllocator<NextFit> NextFitPageAllocator;
+
+// these are explicitly instantiated in PageAllocator.cc
+extern template class BasicPageAllocator<BestFit>;
+extern template class BasicPageAllocator<FirstFit>;
+extern template class BasicPageAllocator<NextFit>;
 
 }  // namespace palloc
 
+#include "palloc/PageAllocator.tcc"
+
 #endif  // PALLOC_PAGEALLOCATOR_H_
@@ -0,0 +1,2068 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <bits/bits.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <new>
+#include <utility>
+
+namespace palloc {
+
+template <typename Placement>
+const u64 BasicPageAllocator<Placement>::kMinPoolChunk;
+
+template <typename Placement>
+BasicPageAllocator<Placement>::BasicPageAllocator(u64 _pages,
+                                                  u64 _minBlockSize,
+                                                  u64 _reserveBlocks)
+    : pages_(_pages), minBlockSize_(_minBlockSize),
+      placement_(_pages, _minBlockSize), classes_(_pages, _minBlockSize),
+      tallyClasses_(INV, _minBlockSize),
+      classBlocks_(tallyClasses_.count(), 0),
+      classPages_(tallyClasses_.count(), 0) {
+  // check input parameters
+  if (pages_ == 0 || pages_ == INV) {
+    throw new ex::Exception("pages must > 0 and < INV (%lu)", INV);
+  }
+  if (minBlockSize_ == 0 || minBlockSize_ > pages_) {
+    throw new ex::Exception("minBlockSize must be > 0 and "
+                            "minBlockSize <= pages");
+  }
+
+  // the counters are only allocated when they are kept
+  PALLOC_STAT(counters_.reset(new StatCounters()));
+
+  // create the block pool
+  poolBlocks_ = 0;
+  freeSlots_ = nullptr;
+  growPool(std::max(_reserveBlocks, kMinPoolChunk));
+  usedMap_.resize(std::max(
+      bits::ceilPow2(_reserveBlocks + _reserveBlocks / 3 + 1), (u64)64),
+                  nullptr);
+  usedMapShift_ = 64 - __builtin_ctzll(usedMap_.size());
+  rangeIndex_ = false;
+  usedRoot_ = nullptr;
+
+  // coalescing is eager by default
+  quickPages_ = 0;
+  quickThreshold_ = 0.0;
+  quickListedPages_ = 0;
+
+  // initialize the entire memory space as one large free block
+  Block* freeBlock = newBlock(0, pages_, false, nullptr, nullptr);
+  linkFreeBlock(freeBlock);
+  head_ = freeBlock;
+  tail_ = freeBlock;
+
+  // initialize status counters
+  freeBlocks_ = 1;
+  usedBlocks_ = 0;
+  freePages_ = pages_;
+  usedPages_ = 0;
+}
+
+template <typename Placement>
+BasicPageAllocator<Placement>::~BasicPageAllocator() {
+  // release the block pool, blocks are trivially destructible
+  for (Block* chunk : poolChunks_) {
+    ::operator delete(chunk);
+  }
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::createBlock(u64 _pages) {
+  PALLOC_LATENCY(u64 start = cycles());
+  u64 base = createBlockImpl(_pages);
+  PALLOC_LATENCY(counters_->latency[kTraceCreateBlock].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceCreateBlock, _pages, 0, base);
+  }
+  return base;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::createAlignedBlock(u64 _pages,
+                                                      u64 _alignment) {
+  PALLOC_LATENCY(u64 start = cycles());
+  u64 base = createAlignedBlockImpl(_pages, _alignment);
+  PALLOC_LATENCY(counters_->latency[kTraceCreateAlignedBlock].add(
+      cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceCreateAlignedBlock, _pages, _alignment, base);
+  }
+  return base;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::createBlockAt(u64 _base, u64 _pages) {
+  PALLOC_LATENCY(u64 start = cycles());
+  bool res = createBlockAtImpl(_base, _pages);
+  PALLOC_LATENCY(counters_->latency[kTraceCreateBlockAt].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceCreateBlockAt, _base, _pages, res);
+  }
+  return res;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::reserveRanges(const u64* _bases,
+                                                  const u64* _pages,
+                                                  u64 _count) {
+  PALLOC_LATENCY(u64 start = cycles());
+  bool res = reserveRangesImpl(_bases, _pages, _count);
+  PALLOC_LATENCY(counters_->latency[kTraceReserveRanges].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceReserveRanges, _count, 0, res);
+    for (u64 idx = 0; idx < _count; idx++) {
+      trace_->record(kTraceBatchItem, _bases[idx], _pages[idx], 0);
+    }
+  }
+  return res;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::freeBlock(u64 _block) {
+  PALLOC_LATENCY(u64 start = cycles());
+  bool res = freeBlockImpl(_block);
+  PALLOC_LATENCY(counters_->latency[kTraceFreeBlock].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceFreeBlock, _block, 0, res);
+  }
+  return res;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::shrinkBlock(u64 _block, u64 _pages) {
+  PALLOC_LATENCY(u64 start = cycles());
+  bool res = shrinkBlockImpl(_block, _pages);
+  PALLOC_LATENCY(counters_->latency[kTraceShrinkBlock].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceShrinkBlock, _block, _pages, res);
+  }
+  return res;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::releaseRange(u64 _block, u64 _offset,
+                                                 u64 _pages) {
+  PALLOC_LATENCY(u64 start = cycles());
+  bool res = releaseRangeImpl(_block, _offset, _pages);
+  PALLOC_LATENCY(counters_->latency[kTraceReleaseRange].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceReleaseRange, _block, _offset, res);
+    trace_->record(kTraceBatchItem, _pages, 0, 0);
+  }
+  return res;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::growBlock(u64 _block, u64 _pages) {
+  PALLOC_LATENCY(u64 start = cycles());
+  bool res = growBlockImpl(_block, _pages);
+  PALLOC_LATENCY(counters_->latency[kTraceGrowBlock].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceGrowBlock, _block, _pages, res);
+  }
+  return res;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::resizeBlock(u64 _block, u64 _pages,
+                                               Move* _move) {
+  PALLOC_LATENCY(u64 start = cycles());
+  u64 base = resizeBlockImpl(_block, _pages, _move);
+  PALLOC_LATENCY(counters_->latency[kTraceResizeBlock].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceResizeBlock, _block, _pages, base);
+  }
+  return base;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::createBlocks(const u64* _pages, u64 _count,
+                                                 u64* _blocks) {
+  PALLOC_LATENCY(u64 start = cycles());
+  bool res = createBlocksImpl(_pages, _count, _blocks);
+  PALLOC_LATENCY(counters_->latency[kTraceCreateBlocks].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceCreateBlocks, _count, 0, res);
+    for (u64 idx = 0; idx < _count; idx++) {
+      trace_->record(kTraceBatchItem, _pages[idx], 0,
+                     res ? _blocks[idx] : INV);
+    }
+  }
+  return res;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::freeBlocks(const u64* _blocks,
+                                               u64 _count) {
+  PALLOC_LATENCY(u64 start = cycles());
+  bool res = freeBlocksImpl(_blocks, _count);
+  PALLOC_LATENCY(counters_->latency[kTraceFreeBlocks].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceFreeBlocks, _count, 0, res);
+    for (u64 idx = 0; idx < _count; idx++) {
+      trace_->record(kTraceBatchItem, _blocks[idx], 0, 0);
+    }
+  }
+  return res;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::extend(u64 _morePages) {
+  PALLOC_LATENCY(u64 start = cycles());
+  bool res = extendImpl(_morePages);
+  PALLOC_LATENCY(counters_->latency[kTraceExtend].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceExtend, _morePages, 0, res);
+  }
+  return res;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::truncate(u64 _newPages) {
+  PALLOC_LATENCY(u64 start = cycles());
+  bool res = truncateImpl(_newPages);
+  PALLOC_LATENCY(counters_->latency[kTraceTruncate].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceTruncate, _newPages, 0, res);
+  }
+  return res;
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::setDeferredCoalescing(u64 _quickPages,
+                                                          f64 _threshold) {
+  PALLOC_LATENCY(u64 start = cycles());
+  setDeferredCoalescingImpl(_quickPages, _threshold);
+  PALLOC_LATENCY(counters_->latency[kTraceSetDeferredCoalescing].add(
+      cycles() - start));
+  if (trace_) {
+    u64 threshold;
+    memcpy(&threshold, &_threshold, sizeof(threshold));
+    trace_->record(kTraceSetDeferredCoalescing, _quickPages, threshold, 0);
+  }
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::coalesceAll() {
+  PALLOC_LATENCY(u64 start = cycles());
+  coalesceAllImpl();
+  PALLOC_LATENCY(counters_->latency[kTraceCoalesceAll].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceCoalesceAll, 0, 0, 0);
+  }
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::planCompaction(
+    u64 _budget, std::vector<Move>* _plan) const {
+  // slide a window over the free blocks, keeping the used pages between its
+  //  first and last free blocks within the budget, and keep the window with
+  //  the most free pages (the fewest moved pages on ties)
+  _plan->clear();
+  const Block* first = nullptr;  // first block of the window
+  u64 free = 0;  // free pages in the window
+  u64 moved = 0;  // used pages in the window
+  u64 pending = 0;  // used pages after the window
+  const Block* bestFirst = nullptr;
+  const Block* bestLast = nullptr;
+  u64 bestFree = 0;
+  u64 bestMoved = 0;
+  for (const Block* block = head_; block != nullptr; block = block->next) {
+    if (block->used) {
+      pending += block->size;
+      continue;
+    }
+    if (first == nullptr) {
+      first = block;
+    } else {
+      moved += pending;
+    }
+    pending = 0;
+    free += block->size;
+
+    // drop the leading free blocks and the used blocks after them until the
+    //  window fits the budget
+    while (moved > _budget) {
+      for (; first->used == false; first = first->next) {
+        free -= first->size;
+      }
+      for (; first->used == true; first = first->next) {
+        moved -= first->size;
+      }
+    }
+    if (free > bestFree || (free == bestFree && moved < bestMoved)) {
+      bestFirst = first;
+      bestLast = block;
+      bestFree = free;
+      bestMoved = moved;
+    }
+  }
+
+  // slide the used blocks of the best window down into the hole that starts
+  //  at its first free page, each move leaves the hole directly after the
+  //  moved block
+  if (bestFirst != nullptr) {
+    u64 hole = bestFirst->base;
+    for (const Block* block = bestFirst; block != bestLast;
+         block = block->next) {
+      if (block->used) {
+        _plan->push_back({block->base, hole, block->size});
+        hole += block->size;
+      }
+    }
+  }
+  return bestMoved;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::commitMove(const Move& _move) {
+  PALLOC_LATENCY(u64 start = cycles());
+  bool res = commitMoveImpl(_move);
+  PALLOC_LATENCY(counters_->latency[kTraceCommitMove].add(cycles() - start));
+  if (trace_) {
+    trace_->record(kTraceCommitMove, _move.from, _move.to,
+                   res ? _move.pages : 0);
+  }
+  return res;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::commitCompaction(
+    const std::vector<Move>& _plan, u64 _first, u64 _count,
+    const std::function<void(const Move&)>& _copy) {
+  u64 committed = 0;
+  for (u64 idx = _first; idx < _plan.size() && committed < _count; idx++) {
+    if (!commitMove(_plan.at(idx))) {
+      break;
+    }
+    if (_copy) {
+      _copy(_plan.at(idx));
+    }
+    committed++;
+  }
+  return committed;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::startTrace(const std::string& _path) {
+  std::unique_ptr<TraceWriter> trace(new TraceWriter());
+  if (!trace->open(_path, pages_, minBlockSize_)) {
+    return false;
+  }
+  trace_ = std::move(trace);
+  return true;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::stopTrace() {
+  if (!trace_) {
+    return false;
+  }
+  bool res = trace_->close();
+  trace_.reset();
+  return res;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::saveSnapshot(
+    const std::string& _path) const {
+  // the used flag takes the top bit of the size
+  if (pages_ >= kSnapshotUsed) {
+    return false;
+  }
+  FILE* file = fopen(_path.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  SnapshotHeader header;
+  makeSnapshotHeader(pages_, minBlockSize_, freeBlocks_ + usedBlocks_,
+                     &header);
+  bool res = fwrite(&header, sizeof(header), 1, file) == 1;
+
+  // write the blocks in page order through a buffer
+  const u64 kBufferWords = 512;
+  u64 buffer[kBufferWords];
+  u64 count = 0;
+  for (const Block* block = head_; block != nullptr; block = block->next) {
+    buffer[count++] = block->size | (block->used ? kSnapshotUsed : 0);
+    if (count == kBufferWords || block->next == nullptr) {
+      res = res && fwrite(buffer, sizeof(u64), count, file) == count;
+      count = 0;
+    }
+  }
+  res = (fclose(file) == 0) && res;
+  return res;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::loadSnapshot(const std::string& _path) {
+  // map the file
+  s32 fd = open(_path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 ||
+      (u64)status.st_size < sizeof(SnapshotHeader)) {
+    close(fd);
+    return false;
+  }
+  u64 size = status.st_size;
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  madvise(data, size, MADV_SEQUENTIAL);
+
+  bool res = restoreSnapshot(data, size);
+  munmap(data, size);
+  return res;
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::getStats(Stats* _stats) const {
+  _stats->classBlocks.resize(classes_.count());
+  _stats->classPages.resize(classes_.count());
+  for (u64 index = 0; index < classes_.count(); index++) {
+    _stats->classBlocks[index] = foldClass(classBlocks_, index);
+    _stats->classPages[index] = foldClass(classPages_, index);
+  }
+  _stats->largestFreeBlock = largestFreeBlock();
+  _stats->fragmentation = (freePages_ == 0) ? 0.0 :
+      1.0 - (f64)_stats->largestFreeBlock / freePages_;
+
+  if (counters_) {
+    _stats->counters = *counters_;
+  } else {
+    _stats->counters.clear();
+  }
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::largestFreeBlock() const {
+  // a run of adjacent free blocks is what coalescing would make of it
+  return std::max(placement_.largest(), runs_.largest());
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::canAllocate(u64 _pages) const {
+  return _pages > 0 && std::max(_pages, minBlockSize_) <= largestFreeBlock();
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::canAllocate(u64 _pages,
+                                                u64 _alignment) const {
+  if (_pages == 0 || _alignment == 0 || (_alignment & (_alignment - 1))) {
+    return false;
+  }
+  if (_alignment == 1) {
+    return canAllocate(_pages);
+  }
+
+  // settle it by the largest free block when possible
+  u64 pages = std::max(_pages, minBlockSize_);
+  u64 largest = largestFreeBlock();
+  if (largest < pages) {
+    return false;
+  }
+  u64 guaranteed = pages + minBlockSize_ + _alignment - 1;
+  if (guaranteed > pages && largest >= guaranteed) {
+    return true;
+  }
+
+  // otherwise search, the search isn't counted in the statistics, the runs
+  //  are searched too as createAlignedBlock() coalesces them when needed
+  u64 base;
+  bool res = placement_.findAligned(pages, _alignment, &base) != nullptr;
+  PALLOC_STAT(placement_.takeSearchCount());
+  return res || runs_.findAligned(pages, _alignment, minBlockSize_);
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::numClasses() const {
+  return classes_.count();
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::freeBlocksInClass(u64 _index) const {
+  return foldClass(classBlocks_, _index);
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::freePagesInClass(u64 _index) const {
+  return foldClass(classPages_, _index);
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::resetStats() {
+  PALLOC_STAT(counters_->clear());
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::totalBlocks() const {
+  return freeBlocks_ + usedBlocks_;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::freeBlocks() const {
+  return freeBlocks_;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::usedBlocks() const {
+  return usedBlocks_;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::totalPages() const {
+  return freePages_ + usedPages_;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::freePages() const {
+  return freePages_;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::usedPages() const {
+  return usedPages_;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::blockSize(u64 _block) const {
+  const Block* block = findUsedBlock(_block);
+  return block == nullptr ? 0 : block->size;
+}
+
+template <typename Placement>
+Block* BasicPageAllocator<Placement>::usedBlock(u64 _block) {
+  return findUsedBlock(_block);
+}
+
+template <typename Placement>
+template <typename Visitor>
+void BasicPageAllocator<Placement>::forEachUsed(Visitor&& _visit) const {
+  for (const Block* block = head_; block != nullptr; block = block->next) {
+    if (block->used) {
+      _visit(block->base, block->size);
+    }
+  }
+}
+
+template <typename Placement>
+template <typename Visitor>
+void BasicPageAllocator<Placement>::forEachFree(Visitor&& _visit) const {
+  for (const Block* block = head_; block != nullptr; block = block->next) {
+    if (block->used == false) {
+      _visit(block->base, block->size);
+    }
+  }
+}
+
+template <typename Placement>
+template <typename Visitor>
+void BasicPageAllocator<Placement>::forEachBlockInRange(
+    u64 _lo, u64 _hi, Visitor&& _visit) const {
+  if (_lo >= _hi || _lo >= pages_) {
+    return;
+  }
+
+  // start at the last indexed free or used block at or before the range,
+  //  with the range index only quick listed blocks can lie between it and
+  //  the range, the search isn't counted in the statistics
+  const Block* block = placement_.floor(_lo);
+  PALLOC_STAT(placement_.takeSearchCount());
+  const Block* used = findUsedFloor(_lo);
+  if (block == nullptr || (used != nullptr && used->base > block->base)) {
+    block = used;
+  }
+  if (block == nullptr) {
+    block = head_;
+  }
+
+  // skip the blocks before the range, then visit until its end
+  while (block->base + block->size <= _lo) {
+    block = block->next;
+  }
+  for (; block != nullptr && block->base < _hi; block = block->next) {
+    _visit(block->base, block->size, block->used);
+  }
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::setRangeIndex(bool _enable) {
+  if (_enable == rangeIndex_) {
+    return;
+  }
+  rangeIndex_ = _enable;
+  usedRoot_ = nullptr;
+  if (rangeIndex_) {
+    for (Block* block = head_; block != nullptr; block = block->next) {
+      if (block->used) {
+        UsedTree::insert(&usedRoot_, block);
+      }
+    }
+  }
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::metadataBytes() const {
+  return sizeof(*this) + placement_.metadataBytes() +
+      poolBlocks_ * sizeof(Block) +
+      poolChunks_.capacity() * sizeof(Block*) +
+      usedMap_.capacity() * sizeof(Block*) +
+      quickLists_.capacity() * sizeof(Block*) + runs_.metadataBytes() +
+      batch_.capacity() * sizeof(u64) +
+      (counters_ ? sizeof(StatCounters) : 0);
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::verify(bool _print) const {
+  // start at the head block
+  Block* block = head_;
+  assert(block->prev == nullptr);
+  assert(block->base == 0);
+
+  // scan all blocks forward, checking the backward links on the way
+  if (_print) {
+    printf("blocks in page order:\n");
+  }
+  u64 blockCount = 0;
+  u64 pages = 0;
+  u64 unusedCount1 = 0;
+  u64 quickCount1 = 0;
+  u64 largest = 0;
+  u64 runCount = 0;
+  u64 runBase = 0;
+  u64 runBlocks = 0;
+  std::vector<u64> classBlocks(tallyClasses_.count(), 0);
+  std::vector<u64> classPages(tallyClasses_.count(), 0);
+  do {
+    assert(block->linked == !block->used);
+    if (block->used == false) {
+      unusedCount1++;
+      classBlocks.at(tallyClasses_.index(block->size))++;
+      classPages.at(tallyClasses_.index(block->size)) += block->size;
+      if (block->quick) {
+        quickCount1++;
+      }
+      // adjacent free blocks are only left behind by deferred coalescing
+      assert(quickPages_ > 0 || block->next == nullptr || block->next->used);
+
+      // a run of adjacent free blocks is in the free runs unless it is a
+      //  lone indexed block
+      if (block->prev == nullptr || block->prev->used) {
+        runBase = block->base;
+        runBlocks = 0;
+      }
+      runBlocks++;
+      if (block->next == nullptr || block->next->used) {
+        u64 runPages = block->base + block->size - runBase;
+        largest = std::max(largest, runPages);
+        u64 foundPages = 0;
+        u64 found = runs_.find(runBase, &foundPages);
+        (void)found;  // unused
+        (void)foundPages;  // unused
+        if (runBlocks > 1 || block->quick) {
+          runCount++;
+          assert(found == runBase && foundPages == runPages);
+        } else {
+          assert(found == INV);
+        }
+      }
+    } else {
+      assert(findUsedBlock(block->base) == block);
+      assert(block->quick == false);
+    }
+    assert(block->base == pages);
+    assert(block->next == nullptr || block->next->prev == block);
+    assert(block->next != nullptr || block == tail_);
+    blockCount++;
+    pages += block->size;
+    if (_print) {
+      printf("this=0x%lX base=%lu size=%lu used=%u prev=0x%lX next=0x%lX\n",
+             (u64)block, block->base, block->size, block->used,
+             (u64)block->prev, (u64)block->next);
+    }
+    block = block->next;
+  } while (block != nullptr);
+  assert(blockCount == totalBlocks());
+  assert(pages == pages_);
+  assert(largest == largestFreeBlock());
+  assert(runCount == runs_.verify());
+  assert(classBlocks == classBlocks_);
+  assert(classPages == classPages_);
+  (void)blockCount;  // unused
+  (void)pages;  // unused
+  (void)largest;  // unused
+  (void)runCount;  // unused
+
+  // verify the range index
+  u64 usedCount = UsedTree::verify(usedRoot_);
+  (void)usedCount;  // unused
+  assert(usedCount == (rangeIndex_ ? usedBlocks_ : 0));
+
+  // verify the placement index
+  u64 unusedCount2 = placement_.verify(_print);
+
+  // print quick lists
+  if (_print && quickPages_ > 0) {
+    printf("quick lists:\n");
+  }
+  u64 quickCount2 = 0;
+  u64 quickPages = 0;
+  for (u64 size = 0; size < quickLists_.size(); size++) {
+    Block* prev = nullptr;
+    for (Block* block = quickLists_.at(size); block != nullptr;
+         block = block->right) {
+      unusedCount2++;
+      quickCount2++;
+      quickPages += block->size;
+      if (_print) {
+        printf("this=0x%lX base=%lu size=%lu used=%u prev=0x%lX next=0x%lX\n",
+               (u64)block, block->base, block->size, block->used,
+               (u64)block->prev, (u64)block->next);
+      }
+      assert(block->used == false);
+      assert(block->quick == true);
+      assert(block->size == size);
+      assert(block->left == prev);
+      prev = block;
+    }
+    (void)prev;  // unused
+  }
+  (void)quickPages;  // unused
+  assert(quickCount1 == quickCount2);
+  assert(quickPages == quickListedPages_);
+  assert(unusedCount1 == unusedCount2);
+}
+
+/*** private below here ***/
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::createBlockImpl(u64 _pages) {
+  // bail out if user is asking for nothing
+  if (_pages == 0) {
+    return INV;
+  }
+
+  // determine the real size of the block
+  u64 pages = std::max(_pages, minBlockSize_);
+
+  // reuse a quick listed block of the exact size if there is one
+  if (pages <= quickPages_ && quickLists_[pages] != nullptr) {
+    Block* quickBlock = quickLists_[pages];
+    unlinkFreeBlock(quickBlock);
+
+    // perform accounting
+    freeBlocks_ -= 1;
+    usedBlocks_ += 1;
+    freePages_ -= pages;
+    usedPages_ += pages;
+
+    // add block to the used map
+    quickBlock->used = true;
+    insertUsedBlock(quickBlock);
+    return quickBlock->base;
+  }
+
+  // find a free block to use
+  Block* newBlock = findFreeBlock(pages);
+  if (newBlock == nullptr && runs_.largest() >= pages) {
+    // coalesce the runs of adjacent free blocks and try again
+    coalesceAllImpl();
+    newBlock = findFreeBlock(pages);
+  }
+  if (newBlock == nullptr) {
+    // detect failure to find eligible block
+    PALLOC_STAT(counters_->failures++);
+    return INV;
+  }
+  unlinkFreeBlock(newBlock);
+
+  // perform accounting
+  freeBlocks_ -= 1;
+  usedBlocks_ += 1;
+  freePages_ -= newBlock->size;
+  usedPages_ += newBlock->size;
+
+  // add block to the used map
+  newBlock->used = true;
+  insertUsedBlock(newBlock);
+
+  // split the block
+  splitBlock(newBlock, pages, false);  // coalescing isn't need here
+
+  // return the block
+  return newBlock->base;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::createAlignedBlockImpl(u64 _pages,
+                                                          u64 _alignment) {
+  // bail out if user is asking for nothing or an invalid alignment
+  if (_pages == 0 || _alignment == 0 || (_alignment & (_alignment - 1))) {
+    return INV;
+  }
+  if (_alignment == 1) {
+    return createBlockImpl(_pages);
+  }
+
+  // determine the real size of the block
+  u64 pages = std::max(_pages, minBlockSize_);
+
+  // find a free block holding an aligned range
+  u64 base;
+  Block* block = findAlignedFreeBlock(pages, _alignment, &base);
+  if (block == nullptr && runs_.count() > 0) {
+    // coalesce deferred blocks and try again
+    coalesceAllImpl();
+    block = findAlignedFreeBlock(pages, _alignment, &base);
+  }
+  if (block == nullptr) {
+    // detect failure to find eligible block
+    PALLOC_STAT(counters_->failures++);
+    return INV;
+  }
+
+  // allocate the aligned range
+  return allocateRange(block, base, pages)->base;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::createBlockAtImpl(u64 _base, u64 _pages) {
+  // bail out if user is asking for nothing or pages beyond the last
+  if (_pages == 0 || _base >= pages_) {
+    return false;
+  }
+
+  // determine the real size of the block
+  u64 pages = std::max(_pages, minBlockSize_);
+  if (pages > pages_ - _base) {
+    return false;
+  }
+
+  // find the free block holding the range
+  Block* block = findRangeFreeBlock(_base, pages);
+  if (block == nullptr && runs_.count() > 0) {
+    // coalesce deferred blocks and try again
+    coalesceAllImpl();
+    block = findRangeFreeBlock(_base, pages);
+  }
+  if (block == nullptr) {
+    // detect a range that isn't free
+    PALLOC_STAT(counters_->failures++);
+    return false;
+  }
+
+  // allocate the range
+  allocateRange(block, _base, pages);
+  return true;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::reserveRangesImpl(const u64* _bases,
+                                                      const u64* _pages,
+                                                      u64 _count) {
+  // check the bounds of the ranges and sort them in page order
+  batch_.clear();
+  for (u64 idx = 0; idx < _count; idx++) {
+    if (_pages[idx] == 0 || _bases[idx] >= pages_ ||
+        std::max(_pages[idx], minBlockSize_) > pages_ - _bases[idx]) {
+      return false;
+    }
+    batch_.push_back(idx);
+  }
+  if (_count == 0) {
+    return true;
+  }
+  std::sort(batch_.begin(), batch_.end(), [_bases](u64 _a, u64 _b) {
+      return _bases[_a] < _bases[_b];
+    });
+
+  // every free page must be in the placement index
+  if (runs_.count() > 0) {
+    coalesceAllImpl();
+  }
+
+  // check that every range is free before changing anything, ranges that
+  //  share a free block must not overlap and must leave either no pages or
+  //  at least minBlockSize pages between them
+  u64 end = 0;  // the end of the previous range
+  for (u64 pos : batch_) {
+    u64 base = _bases[pos];
+    u64 pages = std::max(_pages[pos], minBlockSize_);
+    if (base < end) {
+      return false;
+    }
+    Block* block = findRangeFreeBlock(base, pages);
+    if (block == nullptr) {
+      PALLOC_STAT(counters_->failures++);
+      return false;
+    }
+    u64 gap = base - std::max(end, block->base);
+    if (gap > 0 && gap < minBlockSize_) {
+      return false;
+    }
+    end = base + pages;
+  }
+
+  // allocate the ranges in page order, each one leaves the rest of its free
+  //  block linked for the ranges that follow
+  for (u64 pos : batch_) {
+    u64 pages = std::max(_pages[pos], minBlockSize_);
+    Block* block = findRangeFreeBlock(_bases[pos], pages);
+    assert(block != nullptr);
+    allocateRange(block, _bases[pos], pages);
+  }
+  return true;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::freeBlockImpl(u64 _block) {
+  // check if the block is a valid used block
+  Block* block = findUsedBlock(_block);
+  if (block == nullptr) {
+    return false;
+  }
+
+  // remove block from used map
+  eraseUsedBlock(block);
+  block->used = false;
+
+  // accounting
+  freeBlocks_ += 1;
+  usedBlocks_ -= 1;
+  freePages_ += block->size;
+  usedPages_ -= block->size;
+
+  // defer coalescing of small blocks by quick listing them
+  if (block->size <= quickPages_) {
+    linkQuickBlock(block);
+    if (quickListedPages_ > quickThreshold_ * freePages_) {
+      coalesceAllImpl();
+    }
+    return true;
+  }
+
+  // coalesce free block
+  coalesceBlockBackward(block);
+  coalesceBlockForward(block);
+
+  // link the free block in a free list
+  linkFreeBlock(block);
+
+  // return success
+  return true;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::shrinkBlockImpl(u64 _block, u64 _pages) {
+  // check if the block is a valid used block
+  Block* block = findUsedBlock(_block);
+  if (block == nullptr) {
+    return false;
+  }
+
+  // check easy cases
+  if (_pages > block->size) {
+    // can't grow
+    return false;
+  } else if (_pages == block->size) {
+    // can stay the same
+    return true;
+  } else if (_pages == 0) {
+    // zero is free
+    return freeBlockImpl(_block);
+  }
+
+  // split the block
+  splitBlock(block, _pages, true);  // attempt to coalesce
+  return true;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::releaseRangeImpl(u64 _block, u64 _offset,
+                                                     u64 _pages) {
+  // check if the block is a valid used block holding the range
+  Block* block = findUsedBlock(_block);
+  if (block == nullptr || _pages == 0 || _pages > block->size ||
+      _offset > block->size - _pages) {
+    return false;
+  }
+
+  // check easy cases
+  if (_pages == block->size) {
+    // the whole block is free
+    return freeBlockImpl(_block);
+  } else if (_pages < minBlockSize_) {
+    // the gap can't be a block
+    return false;
+  } else if (_offset + _pages == block->size) {
+    // the gap is the end of the block
+    splitBlock(block, _offset, true);  // attempt to coalesce
+    return true;
+  }
+
+  // split off the pages after the gap as a new used block
+  u64 trailing = block->size - _offset - _pages;
+  Block* rest = newBlock(block->base + _offset + _pages, trailing, true,
+                         block, block->next);
+  if (rest->next) {
+    rest->next->prev = rest;
+  } else {
+    tail_ = rest;
+  }
+  block->size -= trailing;
+  block->next = rest;
+  insertUsedBlock(rest);
+  usedBlocks_ += 1;
+  PALLOC_STAT(counters_->splits++);
+
+  if (_offset > 0) {
+    // the gap is now the end of the block
+    splitBlock(block, _offset, false);  // the next block is used
+    return true;
+  }
+
+  // the whole block is the gap, free it
+  eraseUsedBlock(block);
+  block->used = false;
+  freeBlocks_ += 1;
+  usedBlocks_ -= 1;
+  freePages_ += block->size;
+  usedPages_ -= block->size;
+  coalesceBlockBackward(block);
+  linkFreeBlock(block);
+  return true;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::growBlockImpl(u64 _block, u64 _pages) {
+  // check if the block is a valid used block
+  Block* block = findUsedBlock(_block);
+  if (block == nullptr) {
+    return false;
+  }
+
+  // check easy cases
+  if (_pages < block->size) {
+    // can't shrink, but user might already have more than they asked for
+    return true;
+  } else if (_pages == block->size) {
+    // can stay the same
+    return true;
+  }
+
+  // check if the adjacent block forward is free and if the combined
+  //  space would be enough
+  Block* nextBlock = block->next;
+  if ((nextBlock == nullptr) ||
+      (nextBlock->used == true) ||
+      (block->size + nextBlock->size < _pages)) {
+    // consuming the next block won't work
+    return false;
+  }
+
+  // coalesce the next block
+  freePages_ -= nextBlock->size;
+  usedPages_ += nextBlock->size;
+  //  this unlinks, changes size, deletes, and block accounting
+  bool coalesced = coalesceBlockForward(block);
+  (void)coalesced;  // ununsed
+  assert(coalesced);
+  assert(block->size >= _pages);
+
+  // split the block
+  splitBlock(block, _pages, false);  // coalescing isn't need here
+
+  // return the block
+  return true;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::resizeBlockImpl(u64 _block, u64 _pages,
+                                                   Move* _move) {
+  // nothing moves unless the block relocates or grows backward
+  _move->from = _block;
+  _move->to = _block;
+  _move->pages = 0;
+
+  // check if the block is a valid used block
+  Block* block = findUsedBlock(_block);
+  if (block == nullptr || _pages == 0) {
+    return INV;
+  }
+
+  // determine the free space on both sides of the block
+  Block* prevBlock = block->prev;
+  Block* nextBlock = block->next;
+  u64 prevFree = (prevBlock != nullptr && prevBlock->used == false) ?
+      prevBlock->size : 0;
+  u64 nextFree = (nextBlock != nullptr && nextBlock->used == false) ?
+      nextBlock->size : 0;
+
+  // shrink or grow forward in place
+  if (_pages <= block->size + nextFree) {
+    bool res = (_pages <= block->size) ?
+        shrinkBlockImpl(_block, _pages) : growBlockImpl(_block, _pages);
+    (void)res;  // unused
+    assert(res);
+    return _block;
+  }
+
+  // grow backward, first consuming the forward block if both are needed
+  u64 oldSize = block->size;
+  if (_pages <= block->size + prevFree + nextFree) {
+    if (nextFree > 0) {
+      freePages_ -= nextFree;
+      usedPages_ += nextFree;
+      bool coalesced = coalesceBlockForward(block);
+      (void)coalesced;  // unused
+      assert(coalesced);
+    }
+    growBlockBackward(block, _pages);
+    _move->to = block->base;
+    _move->pages = oldSize;
+    return block->base;
+  }
+
+  // relocate the block
+  u64 newBase = createBlockImpl(_pages);
+  if (newBase == INV) {
+    return INV;
+  }
+  _move->to = newBase;
+  _move->pages = oldSize;
+  bool res = freeBlockImpl(_block);
+  (void)res;  // unused
+  assert(res);
+  return newBase;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::createBlocksImpl(const u64* _pages,
+                                                     u64 _count,
+                                                     u64* _blocks) {
+  // determine the total size of the batch
+  u64 total = 0;
+  for (u64 idx = 0; idx < _count; idx++) {
+    if (_pages[idx] == 0) {
+      return false;
+    }
+    u64 pages = std::max(_pages[idx], minBlockSize_);
+    if (pages > freePages_ - total) {
+      return false;
+    }
+    total += pages;
+  }
+  if (_count == 0) {
+    return true;
+  }
+
+  // carve the whole batch out of a single free block if one is large enough
+  Block* block = findFreeBlock(total);
+  if (block != nullptr) {
+    unlinkFreeBlock(block);
+    block->used = true;
+
+    // perform accounting
+    freeBlocks_ -= 1;
+    usedBlocks_ += _count;
+    freePages_ -= block->size;
+    usedPages_ += block->size;
+
+    // cut the blocks off the front in order, the remainder is always large
+    //  enough for the rest of the batch
+    for (u64 idx = 0; idx < _count - 1; idx++) {
+      u64 pages = std::max(_pages[idx], minBlockSize_);
+      Block* rest = newBlock(block->base + pages, block->size - pages, true,
+                             block, block->next);
+      if (rest->next) {
+        rest->next->prev = rest;
+      } else {
+        tail_ = rest;
+      }
+      block->size = pages;
+      block->next = rest;
+      insertUsedBlock(block);
+      PALLOC_STAT(counters_->splits++);
+      _blocks[idx] = block->base;
+      block = rest;
+    }
+
+    // the last block returns any excess to the free lists
+    insertUsedBlock(block);
+    splitBlock(block, std::max(_pages[_count - 1], minBlockSize_), false);
+    _blocks[_count - 1] = block->base;
+    return true;
+  }
+
+  // otherwise allocate the blocks individually, largest first
+  batch_.clear();
+  for (u64 idx = 0; idx < _count; idx++) {
+    batch_.push_back(idx);
+  }
+  std::sort(batch_.begin(), batch_.end(), [_pages](u64 _a, u64 _b) {
+      return _pages[_a] > _pages[_b];
+    });
+  for (u64 idx = 0; idx < _count; idx++) {
+    u64 pos = batch_[idx];
+    _blocks[pos] = createBlockImpl(_pages[pos]);
+    if (_blocks[pos] == INV) {
+      // undo the whole batch, full coalescing restores the free space exactly
+      for (u64 undo = 0; undo < idx; undo++) {
+        bool res = freeBlockImpl(_blocks[batch_[undo]]);
+        (void)res;  // unused
+        assert(res);
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::freeBlocksImpl(const u64* _blocks,
+                                                   u64 _count) {
+  // check that all blocks are valid, distinct, used blocks
+  batch_.clear();
+  for (u64 idx = 0; idx < _count; idx++) {
+    Block* block = findUsedBlock(_blocks[idx]);
+    if (block == nullptr) {
+      return false;
+    }
+    batch_.push_back(block->base);
+  }
+  std::sort(batch_.begin(), batch_.end());
+  if (std::adjacent_find(batch_.begin(), batch_.end()) != batch_.end()) {
+    return false;
+  }
+
+  // free the blocks in page order, merging runs of adjacent blocks directly
+  //  and only linking each merged run into a free list once
+  Block* pending = nullptr;
+  for (u64 base : batch_) {
+    Block* block = findUsedBlock(base);
+    eraseUsedBlock(block);
+    block->used = false;
+
+    // accounting
+    freeBlocks_ += 1;
+    usedBlocks_ -= 1;
+    freePages_ += block->size;
+    usedPages_ -= block->size;
+
+    if (pending != nullptr && block->prev == pending) {
+      // extend the pending run
+      pending->size += block->size;
+      pending->next = block->next;
+      if (pending->next) {
+        pending->next->prev = pending;
+      } else {
+        tail_ = pending;
+      }
+      deleteBlock(block);
+      freeBlocks_ -= 1;
+      PALLOC_STAT(counters_->coalesces++);
+    } else {
+      // finish the pending run and start a new one
+      if (pending != nullptr) {
+        coalesceBlockForward(pending);
+        linkFreeBlock(pending);
+      }
+      coalesceBlockBackward(block);
+      pending = block;
+    }
+  }
+  if (pending != nullptr) {
+    coalesceBlockForward(pending);
+    linkFreeBlock(pending);
+  }
+  return true;
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::setDeferredCoalescingImpl(u64 _quickPages,
+                                                              f64 _threshold) {
+  // start from a fully coalesced state
+  coalesceAllImpl();
+
+  quickPages_ = _quickPages;
+  quickThreshold_ = _threshold;
+  quickLists_.assign(quickPages_ == 0 ? 0 : quickPages_ + 1, nullptr);
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::coalesceAllImpl() {
+  // walk the blocks in page order merging each free block with all free
+  //  blocks that follow it, this also empties the quick lists
+  for (Block* block = head_; block != nullptr; block = block->next) {
+    if (block->used == false &&
+        (block->quick ||
+         (block->next != nullptr && block->next->used == false))) {
+      unlinkFreeBlock(block);
+      while (coalesceBlockForward(block)) {}
+      linkFreeBlock(block);
+    }
+  }
+  assert(quickListedPages_ == 0);
+  assert(runs_.count() == 0);
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::commitMoveImpl(const Move& _move) {
+  // check that the block is still used with the planned size
+  Block* block = findUsedBlock(_move.from);
+  if (block == nullptr || block->size != _move.pages) {
+    return false;
+  }
+
+  // check that the free pages directly before the block start at 'to'
+  Block* first = block->prev;
+  if (first == nullptr || first->used == true) {
+    return false;
+  }
+  while (first->prev != nullptr && first->prev->used == false) {
+    first = first->prev;
+  }
+  if (first->base != _move.to) {
+    return false;
+  }
+
+  // merge the free pages before the block into one hole
+  Block* hole = block->prev;
+  unlinkFreeBlock(hole);
+  while (coalesceBlockBackward(hole)) {}
+
+  // swap the block and the hole
+  eraseUsedBlock(block);
+  block->base = hole->base;
+  hole->base = block->base + block->size;
+  block->prev = hole->prev;
+  hole->next = block->next;
+  block->next = hole;
+  hole->prev = block;
+  if (block->prev) {
+    block->prev->next = block;
+  } else {
+    head_ = block;
+  }
+  if (hole->next) {
+    hole->next->prev = hole;
+  } else {
+    tail_ = hole;
+  }
+  insertUsedBlock(block);
+
+  // merge the hole with the free pages after it
+  while (coalesceBlockForward(hole)) {}
+  linkFreeBlock(hole);
+  return true;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::extendImpl(u64 _morePages) {
+  // bail out if user is asking for nothing or too many pages
+  if (_morePages == 0 || _morePages >= INV - pages_ ||
+      (tail_->used && _morePages < minBlockSize_)) {
+    return false;
+  }
+  u64 pages = pages_ + _morePages;
+
+  // refile the free blocks of the size classes that change
+  if (!placement_.resize(pages)) {
+    return false;
+  }
+  classes_.resize(pages);
+
+  if (tail_->used == false) {
+    // grow the trailing free block
+    unlinkFreeBlock(tail_);
+    tail_->size += _morePages;
+    linkFreeBlock(tail_);
+  } else {
+    // append a new free block
+    Block* block = newBlock(pages_, _morePages, false, tail_, nullptr);
+    tail_->next = block;
+    tail_ = block;
+    linkFreeBlock(block);
+    freeBlocks_ += 1;
+  }
+
+  // accounting
+  freePages_ += _morePages;
+  pages_ = pages;
+  return true;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::truncateImpl(u64 _newPages) {
+  // bail out if the new size is invalid or the tail is used
+  if (_newPages < minBlockSize_ || _newPages > pages_ || tail_->used) {
+    return false;
+  }
+  if (_newPages == pages_) {
+    return true;
+  }
+
+  // merge the trailing free block with any quick listed blocks before it
+  Block* block = tail_;
+  unlinkFreeBlock(block);
+  while (coalesceBlockBackward(block)) {}
+
+  // the removed pages must all be in the trailing free block and leave a
+  //  valid block, then the size classes that change are refiled
+  u64 leading = (block->base > _newPages) ? INV : _newPages - block->base;
+  if (leading == INV || (leading > 0 && leading < minBlockSize_) ||
+      !placement_.resize(_newPages)) {
+    linkFreeBlock(block);
+    return false;
+  }
+  classes_.resize(_newPages);
+
+  if (leading == 0) {
+    // remove the trailing free block
+    tail_ = block->prev;
+    tail_->next = nullptr;
+    deleteBlock(block);
+    freeBlocks_ -= 1;
+  } else {
+    // shrink the trailing free block
+    block->size = leading;
+    linkFreeBlock(block);
+  }
+
+  // accounting
+  freePages_ -= pages_ - _newPages;
+  pages_ = _newPages;
+  return true;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::restoreSnapshot(const void* _data,
+                                                    u64 _size) {
+  // check the header against the geometry of this allocator
+  const SnapshotHeader* header = static_cast<const SnapshotHeader*>(_data);
+  u64 bytes = _size - sizeof(SnapshotHeader);
+  if (!validSnapshotHeader(*header) ||
+      header->pages != pages_ ||
+      header->minBlockSize != minBlockSize_ ||
+      bytes % sizeof(u64) != 0 ||
+      bytes / sizeof(u64) != header->blocks) {
+    return false;
+  }
+  const u64* words = reinterpret_cast<const u64*>(header + 1);
+  u64 blocks = header->blocks;
+
+  // check that the blocks exactly cover the pages before changing anything
+  u64 pages = 0;
+  u64 used = 0;
+  for (u64 idx = 0; idx < blocks; idx++) {
+    u64 size = words[idx] & ~kSnapshotUsed;
+    if (size == 0 || size > pages_ - pages) {
+      return false;
+    }
+    pages += size;
+    used += (words[idx] & kSnapshotUsed) ? 1 : 0;
+  }
+  if (pages != pages_) {
+    return false;
+  }
+
+  // return all blocks to the pool
+  for (Block* block = head_; block != nullptr;) {
+    Block* next = block->next;
+    if (block->used == false) {
+      unlinkFreeBlock(block);
+    }
+    deleteBlock(block);
+    block = next;
+  }
+  assert(quickListedPages_ == 0);
+  head_ = nullptr;
+  freeBlocks_ = 0;
+  usedBlocks_ = 0;
+  freePages_ = 0;
+  usedPages_ = 0;
+
+  // size the pool and used map for the snapshot up front
+  if (blocks > poolBlocks_) {
+    growPool(blocks - poolBlocks_);
+  }
+  usedMap_.assign(std::max(bits::ceilPow2(used + used / 3 + 1), (u64)64),
+                  nullptr);
+  usedMapShift_ = 64 - __builtin_ctzll(usedMap_.size());
+  usedRoot_ = nullptr;
+
+  // rebuild the blocks in page order, adjacent free blocks (e.g., quick
+  //  listed ones) are merged and linked once their size is final
+  Block* prev = nullptr;
+  Block* pending = nullptr;
+  u64 base = 0;
+  for (u64 idx = 0; idx < blocks; idx++) {
+    u64 size = words[idx] & ~kSnapshotUsed;
+    bool isUsed = (words[idx] & kSnapshotUsed) != 0;
+    base += size;
+    if (!isUsed && pending != nullptr) {
+      pending->size += size;
+      freePages_ += size;
+      continue;
+    }
+    Block* block = newBlock(base - size, size, isUsed, prev, nullptr);
+    if (prev != nullptr) {
+      prev->next = block;
+    } else {
+      head_ = block;
+    }
+    prev = block;
+    if (isUsed) {
+      if (pending != nullptr) {
+        linkFreeBlock(pending);
+        pending = nullptr;
+      }
+      usedBlocks_ += 1;
+      usedPages_ += size;
+      insertUsedBlock(block);
+    } else {
+      freeBlocks_ += 1;
+      freePages_ += size;
+      pending = block;
+    }
+  }
+  if (pending != nullptr) {
+    linkFreeBlock(pending);
+  }
+  tail_ = prev;
+
+  // the counters restart with the loaded state
+  PALLOC_STAT(counters_->clear());
+  return true;
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::growPool(u64 _blocks) {
+  // allocate raw storage for the chunk, blocks are constructed when used
+  Block* chunk = static_cast<Block*>(::operator new(sizeof(Block) * _blocks));
+  poolChunks_.push_back(chunk);
+  poolBlocks_ += _blocks;
+
+  // push the slots onto the free slot stack, lowest address on top
+  for (u64 idx = _blocks; idx > 0; idx--) {
+    Block* slot = &chunk[idx - 1];
+    slot->next = freeSlots_;
+    freeSlots_ = slot;
+  }
+}
+
+template <typename Placement>
+Block* BasicPageAllocator<Placement>::newBlock(
+    u64 _base, u64 _size, bool _used, Block* _prev, Block* _next) {
+  // grow the pool geometrically when it is exhausted
+  if (freeSlots_ == nullptr) {
+    growPool(poolBlocks_);
+  }
+
+  // pop a slot and construct the block in place
+  Block* slot = freeSlots_;
+  freeSlots_ = slot->next;
+  return new (slot) Block(_base, _size, _used, _prev, _next);
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::deleteBlock(Block* _block) {
+  // push the slot onto the free slot stack
+  _block->next = freeSlots_;
+  freeSlots_ = _block;
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::usedMapSlot(u64 _base) const {
+  // fibonacci hashing, the top bits of the product select the slot
+  return (_base * 0x9E3779B97F4A7C15lu) >> usedMapShift_;
+}
+
+template <typename Placement>
+Block* BasicPageAllocator<Placement>::findUsedBlock(u64 _base) const {
+  // linear probe until the block or an empty slot is found
+  u64 mask = usedMap_.size() - 1;
+  for (u64 slot = usedMapSlot(_base); true; slot = (slot + 1) & mask) {
+    Block* block = usedMap_[slot];
+    if (block == nullptr || block->base == _base) {
+      return block;
+    }
+  }
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::insertUsedBlock(Block* _block) {
+  // keep the load factor at or below 3/4
+  if ((usedBlocks_ + 1) * 4 > usedMap_.size() * 3) {
+    std::vector<Block*> old(usedMap_.size() * 2, nullptr);
+    old.swap(usedMap_);
+    usedMapShift_--;
+    u64 mask = usedMap_.size() - 1;
+    for (Block* block : old) {
+      if (block != nullptr) {
+        u64 slot = usedMapSlot(block->base);
+        while (usedMap_[slot] != nullptr) {
+          slot = (slot + 1) & mask;
+        }
+        usedMap_[slot] = block;
+      }
+    }
+  }
+
+  // linear probe to the first empty slot
+  u64 mask = usedMap_.size() - 1;
+  u64 slot = usedMapSlot(_block->base);
+  while (usedMap_[slot] != nullptr) {
+    assert(usedMap_[slot]->base != _block->base);
+    slot = (slot + 1) & mask;
+  }
+  usedMap_[slot] = _block;
+  if (rangeIndex_) {
+    UsedTree::insert(&usedRoot_, _block);
+  }
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::eraseUsedBlock(Block* _block) {
+  // find the slot holding the block
+  u64 mask = usedMap_.size() - 1;
+  u64 slot = usedMapSlot(_block->base);
+  while (usedMap_[slot] != _block) {
+    assert(usedMap_[slot] != nullptr);
+    slot = (slot + 1) & mask;
+  }
+
+  // shift following entries back into the hole so that probe sequences
+  //  stay unbroken without tombstones
+  u64 hole = slot;
+  for (slot = (slot + 1) & mask; usedMap_[slot] != nullptr;
+       slot = (slot + 1) & mask) {
+    u64 home = usedMapSlot(usedMap_[slot]->base);
+    // move the entry if its home isn't cyclically within (hole, slot]
+    if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+      usedMap_[hole] = usedMap_[slot];
+      hole = slot;
+    }
+  }
+  usedMap_[hole] = nullptr;
+  if (rangeIndex_) {
+    UsedTree::remove(&usedRoot_, _block);
+  }
+}
+
+template <typename Placement>
+const Block* BasicPageAllocator<Placement>::findUsedFloor(u64 _page) const {
+  // find the last used block with a base page of at most '_page'
+  const Block* best = nullptr;
+  for (const Block* block = usedRoot_; block != nullptr;) {
+    if (block->base <= _page) {
+      best = block;
+      block = block->right;
+    } else {
+      block = block->left;
+    }
+  }
+  return best;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::UsedOrder::less(const Block* _a,
+                                                    const Block* _b) {
+  return _a->base < _b->base;
+}
+
+template <typename Placement>
+Block* BasicPageAllocator<Placement>::findFreeBlock(u64 _pages) {
+  Block* block = placement_.find(_pages);
+  PALLOC_STAT(countSearch());
+  return block;
+}
+
+template <typename Placement>
+Block* BasicPageAllocator<Placement>::findAlignedFreeBlock(u64 _pages,
+                                                          u64 _alignment,
+                                                          u64* _base) {
+  Block* block = placement_.findAligned(_pages, _alignment, _base);
+  PALLOC_STAT(countSearch());
+  return block;
+}
+
+template <typename Placement>
+Block* BasicPageAllocator<Placement>::findRangeFreeBlock(u64 _base,
+                                                        u64 _pages) {
+  Block* block = placement_.floor(_base);
+  PALLOC_STAT(countSearch());
+  if (block == nullptr || _base - block->base >= block->size) {
+    return nullptr;
+  }
+  u64 leading = _base - block->base;
+  if ((leading > 0 && leading < minBlockSize_) ||
+      block->size - leading < _pages) {
+    return nullptr;
+  }
+  return block;
+}
+
+template <typename Placement>
+Block* BasicPageAllocator<Placement>::allocateRange(Block* _block, u64 _base,
+                                                    u64 _pages) {
+  assert(_block->used == false);
+  assert(_base >= _block->base);
+  assert(_base + _pages <= _block->base + _block->size);
+  unlinkFreeBlock(_block);
+
+  // split off the leading pages as a free block
+  if (_base > _block->base) {
+    Block* rangeBlock = newBlock(_base, _block->base + _block->size - _base,
+                                 false, _block, _block->next);
+    if (rangeBlock->next) {
+      rangeBlock->next->prev = rangeBlock;
+    } else {
+      tail_ = rangeBlock;
+    }
+    _block->size = _base - _block->base;
+    _block->next = rangeBlock;
+    linkFreeBlock(_block);
+    PALLOC_STAT(counters_->splits++);
+    freeBlocks_ += 1;
+    _block = rangeBlock;
+  }
+
+  // perform accounting
+  freeBlocks_ -= 1;
+  usedBlocks_ += 1;
+  freePages_ -= _block->size;
+  usedPages_ += _block->size;
+
+  // add block to the used map
+  _block->used = true;
+  insertUsedBlock(_block);
+
+  // split off the trailing pages
+  splitBlock(_block, _pages, false);  // coalescing isn't need here
+  return _block;
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::countSearch() {
+  SearchCount count = placement_.takeSearchCount();
+  counters_->probes.add(count.probes);
+  counters_->walked.add(count.walked);
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::countFreeBlock(const Block* _block,
+                                                   bool _add) {
+  // free block sizes only change while unlinked
+  u64 index = tallyClasses_.index(_block->size);
+  if (_add) {
+    classBlocks_[index] += 1;
+    classPages_[index] += _block->size;
+  } else {
+    classBlocks_[index] -= 1;
+    classPages_[index] -= _block->size;
+  }
+}
+
+template <typename Placement>
+u64 BasicPageAllocator<Placement>::foldClass(const std::vector<u64>& _tally,
+                                             u64 _index) const {
+  if (_index + 1 < classes_.count()) {
+    return _tally.at(_index);
+  }
+  assert(_index + 1 == classes_.count());
+  u64 sum = 0;
+  for (u64 index = _index; index < _tally.size(); index++) {
+    sum += _tally[index];
+  }
+  return sum;
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::linkFreeBlock(Block* _block) {
+  countFreeBlock(_block, true);
+  placement_.link(_block);
+  linkRun(_block);
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::linkQuickBlock(Block* _block) {
+  // push the block onto the quick list of its size
+  Block** head = &quickLists_[_block->size];
+  _block->quick = true;
+  _block->parent = nullptr;
+  _block->left = nullptr;
+  _block->right = *head;
+  if (*head != nullptr) {
+    (*head)->left = _block;
+  }
+  *head = _block;
+  quickListedPages_ += _block->size;
+  countFreeBlock(_block, true);
+  linkRun(_block);
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::unlinkFreeBlock(Block* _block) {
+  countFreeBlock(_block, false);
+  unlinkRun(_block);
+
+  // quick listed blocks are removed from their doubly linked quick list
+  if (_block->quick) {
+    if (_block->left != nullptr) {
+      _block->left->right = _block->right;
+    } else {
+      quickLists_[_block->size] = _block->right;
+    }
+    if (_block->right != nullptr) {
+      _block->right->left = _block->left;
+    }
+    _block->quick = false;
+    _block->left = nullptr;
+    _block->right = nullptr;
+    quickListedPages_ -= _block->size;
+    return;
+  }
+
+  // otherwise the block is in the placement index
+  placement_.unlink(_block);
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::linkRun(Block* _block) {
+  // a lone indexed block is left to the placement index, otherwise the block
+  //  joins the runs of the linked blocks next to it, a block in no run is a
+  //  run of one
+  _block->linked = true;
+  bool run = _block->quick;
+  u64 base = _block->base;
+  u64 end = _block->base + _block->size;
+  u64 pages;
+  Block* prevBlock = _block->prev;
+  if (prevBlock != nullptr && prevBlock->linked) {
+    base = runs_.find(prevBlock->base, &pages);
+    if (base != INV) {
+      runs_.remove(base);
+    } else {
+      base = prevBlock->base;
+    }
+    run = true;
+  }
+  Block* nextBlock = _block->next;
+  if (nextBlock != nullptr && nextBlock->linked) {
+    u64 next = runs_.find(nextBlock->base, &pages);
+    if (next != INV) {
+      runs_.remove(next);
+      end = next + pages;
+    } else {
+      end = nextBlock->base + nextBlock->size;
+    }
+    run = true;
+  }
+  if (run) {
+    runs_.insert(base, end - base);
+  }
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::unlinkRun(Block* _block) {
+  // nothing changes for a lone indexed block
+  assert(_block->linked);
+  _block->linked = false;
+  Block* prevBlock = _block->prev;
+  Block* nextBlock = _block->next;
+  bool prevLinked = prevBlock != nullptr && prevBlock->linked;
+  bool nextLinked = nextBlock != nullptr && nextBlock->linked;
+  if (!_block->quick && !prevLinked && !nextLinked) {
+    return;
+  }
+
+  // the run is split around the block, what is left on either side stays a
+  //  run unless it is a lone indexed block
+  u64 pages = 0;
+  u64 base = runs_.find(_block->base, &pages);
+  assert(base != INV);
+  runs_.remove(base);
+  u64 end = base + pages;
+  if (prevLinked && (prevBlock->base != base || prevBlock->quick)) {
+    runs_.insert(base, _block->base - base);
+  }
+  u64 next = _block->base + _block->size;
+  if (nextLinked && (nextBlock->base + nextBlock->size != end ||
+                     nextBlock->quick)) {
+    runs_.insert(next, end - next);
+  }
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::splitBlock(Block* _block, u64 _pages,
+                                               bool _coalesce) {
+  assert(_block->size >= _pages);
+  u64 freeSize = _block->size - _pages;
+
+  if (freeSize >= minBlockSize_) {
+    // create the new free block
+    Block* freeBlock = newBlock(_block->base + _pages, freeSize, false, _block,
+                                _block->next);
+    // shrink the existing used block
+    _block->size = _pages;
+    _block->next = freeBlock;
+    if (freeBlock->next) {
+      freeBlock->next->prev = freeBlock;
+    } else {
+      tail_ = freeBlock;
+    }
+
+    // accounting
+    freeBlocks_ += 1;
+    freePages_ += freeSize;
+    usedPages_ -= freeSize;
+    PALLOC_STAT(counters_->splits++);
+
+    // coalesce (forward only)
+    if (_coalesce) {
+      coalesceBlockForward(freeBlock);
+    }
+
+    // link the free block in a free list
+    linkFreeBlock(freeBlock);
+  }
+}
+
+template <typename Placement>
+void BasicPageAllocator<Placement>::growBlockBackward(Block* _block,
+                                                      u64 _pages) {
+  Block* prevBlock = _block->prev;
+  assert(prevBlock != nullptr && prevBlock->used == false);
+  assert(_block->size < _pages && _block->size + prevBlock->size >= _pages);
+  unlinkFreeBlock(prevBlock);
+
+  // the base changes so the used map entry is replaced
+  eraseUsedBlock(_block);
+
+  // take only the needed pages unless the remainder would be too small
+  u64 take = _pages - _block->size;
+  if (prevBlock->size - take < minBlockSize_) {
+    take = prevBlock->size;
+  }
+  freePages_ -= take;
+  usedPages_ += take;
+  _block->base -= take;
+  _block->size += take;
+
+  if (take == prevBlock->size) {
+    // consume the previous block
+    _block->prev = prevBlock->prev;
+    if (_block->prev) {
+      _block->prev->next = _block;
+    } else {
+      head_ = _block;
+    }
+    deleteBlock(prevBlock);
+    freeBlocks_ -= 1;
+  } else {
+    // shrink the previous block
+    prevBlock->size -= take;
+    linkFreeBlock(prevBlock);
+  }
+  insertUsedBlock(_block);
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::coalesceBlockForward(Block* _block) {
+  // get the block next to this one in the forward direction
+  Block* nextBlock = _block->next;
+  if (nextBlock != nullptr && nextBlock->used == false) {
+    // unlink the block to be coalesced with this one
+    unlinkFreeBlock(nextBlock);
+
+    // consume the next block
+    _block->size += nextBlock->size;
+    _block->next = nextBlock->next;
+    if (_block->next) {
+      _block->next->prev = _block;
+    } else {
+      tail_ = _block;
+    }
+    deleteBlock(nextBlock);
+
+    // accouting
+    freeBlocks_ -= 1;
+    PALLOC_STAT(counters_->coalesces++);
+    return true;
+  }
+  return false;
+}
+
+template <typename Placement>
+bool BasicPageAllocator<Placement>::coalesceBlockBackward(Block* _block) {
+  // get the block previous to this one in the backward direction
+  Block* prevBlock = _block->prev;
+  if (prevBlock != nullptr && prevBlock->used == false) {
+    // unlink the block to be coalesced with this one
+    unlinkFreeBlock(prevBlock);
+
+    // consume the previous block
+    _block->base = prevBlock->base;
+    _block->size += prevBlock->size;
+    _block->prev = prevBlock->prev;
+    if (_block->prev) {
+      _block->prev->next = _block;
+    } else {
+      head_ = _block;
+    }
+    deleteBlock(prevBlock);
+
+    // accounting
+    freeBlocks_ -= 1;
+    PALLOC_STAT(counters_->coalesces++);
+    return true;
+  }
+  return false;
+}
+
+}  // namespace palloc
@@ -32,8 +32,13 @@
 
 #include <gtest/gtest.h>
 #include <prim/prim.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
 
 TEST(PageAllocator, full) {
   u64 b0, b1, b2, b3, b4, b5;
@@ -158,3 +163,1115 @@ TEST(PageAllocator, full) {
     pa.verify(verbose);
   }
 }
+
+TEST(PageAllocator, batch) {
+  for (u64 mbs = 1; mbs <= 8; mbs++) {
+    palloc::PageAllocator pa(1000, mbs);
+    const u64 sizes[] = {5, 1, 30, 7, 2};
+    u64 blocks[5];
+
+    // the batch is carved contiguously from the single free block
+    ASSERT_TRUE(pa.createBlocks(sizes, 5, blocks));
+    pa.verify(false);
+    ASSERT_EQ(pa.usedBlocks(), 5u);
+    for (u64 idx = 1; idx < 5; idx++) {
+      ASSERT_EQ(blocks[idx],
+                blocks[idx - 1] + std::max(sizes[idx - 1], mbs));
+    }
+
+    // invalid and duplicate frees don't free anything
+    const u64 dup[] = {blocks[0], blocks[2], blocks[0]};
+    ASSERT_FALSE(pa.freeBlocks(dup, 3));
+    const u64 bad[] = {blocks[1], palloc::INV};
+    ASSERT_FALSE(pa.freeBlocks(bad, 2));
+    ASSERT_EQ(pa.usedBlocks(), 5u);
+
+    // adjacent blocks coalesce into a single free block
+    const u64 some[] = {blocks[3], blocks[1], blocks[2]};
+    ASSERT_TRUE(pa.freeBlocks(some, 3));
+    pa.verify(false);
+    ASSERT_EQ(pa.usedBlocks(), 2u);
+    ASSERT_EQ(pa.freeBlocks(), 2u);
+
+    // a batch that doesn't fit allocates nothing
+    const u64 big[] = {500, 400, 200};
+    u64 out[3];
+    ASSERT_FALSE(pa.createBlocks(big, 3, out));
+    pa.verify(false);
+    ASSERT_EQ(pa.usedBlocks(), 2u);
+
+    // a batch that fits only in pieces is allocated individually
+    u64 gap = std::max(sizes[1], mbs) + sizes[2] + std::max(sizes[3], mbs);
+    const u64 pieces[] = {30, pa.freePages() - gap - 2};
+    ASSERT_TRUE(pa.createBlocks(pieces, 2, out));
+    pa.verify(false);
+    ASSERT_EQ(pa.usedBlocks(), 4u);
+
+    const u64 all[] = {out[0], out[1], blocks[4], blocks[0]};
+    ASSERT_TRUE(pa.freeBlocks(all, 4));
+    pa.verify(false);
+    ASSERT_EQ(pa.freeBlocks(), 1u);
+    ASSERT_EQ(pa.freePages(), 1000u);
+  }
+}
+
+TEST(PageAllocator, deferred) {
+  palloc::PageAllocator pa(1024, 1);
+  pa.setDeferredCoalescing(16, 0.5);
+
+  // freed small blocks stay uncoalesced and are reused at the same place
+  u64 b0 = pa.createBlock(8);
+  u64 b1 = pa.createBlock(8);
+  u64 b2 = pa.createBlock(100);
+  ASSERT_TRUE(pa.freeBlock(b1));
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+  ASSERT_EQ(pa.createBlock(8), b1);
+  ASSERT_TRUE(pa.freeBlock(b1));
+  ASSERT_TRUE(pa.freeBlock(b0));
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 3u);
+
+  // an explicit sweep merges the adjacent free blocks
+  pa.coalesceAll();
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+  ASSERT_EQ(pa.freePages(), 1024u - 100u);
+
+  // an allocation that can't be satisfied triggers coalescing
+  ASSERT_TRUE(pa.freeBlock(b2));
+  b0 = pa.createBlock(16);
+  b1 = pa.createBlock(16);
+  ASSERT_TRUE(pa.freeBlock(b0));
+  ASSERT_TRUE(pa.freeBlock(b1));
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 3u);
+  ASSERT_NE(pa.createBlock(1024), palloc::INV);
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), 0u);
+
+  // disabling deferred coalescing coalesces everything
+  palloc::PageAllocator pb(1024, 1);
+  pb.setDeferredCoalescing(16, 1.0);
+  u64 c0 = pb.createBlock(4);
+  ASSERT_TRUE(pb.freeBlock(c0));
+  ASSERT_EQ(pb.freeBlocks(), 2u);
+  pb.setDeferredCoalescing(0, 0.0);
+  pb.verify(false);
+  ASSERT_EQ(pb.freeBlocks(), 1u);
+}
+
+TEST(PageAllocator, resize) {
+  palloc::PageAllocator pa(100, 4);
+  palloc::Move move;
+
+  u64 b0 = pa.createBlock(10);
+  u64 b1 = pa.createBlock(10);
+  u64 b2 = pa.createBlock(10);
+  u64 b3 = pa.createBlock(10);
+  ASSERT_EQ(pa.resizeBlock(palloc::INV, 10, &move), palloc::INV);
+  ASSERT_EQ(pa.resizeBlock(b0, 0, &move), palloc::INV);
+
+  // shrinking is in place
+  ASSERT_EQ(pa.resizeBlock(b3, 6, &move), b3);
+  ASSERT_EQ(move.pages, 0u);
+  pa.verify(false);
+
+  // growing forward is in place
+  ASSERT_EQ(pa.resizeBlock(b3, 20, &move), b3);
+  ASSERT_EQ(move.pages, 0u);
+  pa.verify(false);
+
+  // growing backward moves the block down by only what is needed
+  ASSERT_TRUE(pa.freeBlock(b1));
+  ASSERT_EQ(pa.resizeBlock(b2, 14, &move), b2 - 4);
+  ASSERT_EQ(move.from, b2);
+  ASSERT_EQ(move.to, b2 - 4);
+  ASSERT_EQ(move.pages, 10u);
+  b2 -= 4;
+  pa.verify(false);
+
+  // a remainder too small to keep is absorbed
+  ASSERT_EQ(pa.resizeBlock(b2, 17, &move), b1);
+  ASSERT_EQ(move.pages, 14u);
+  b2 = b1;
+  pa.verify(false);
+  ASSERT_EQ(pa.usedBlocks(), 3u);
+
+  // growing into both sides consumes the forward block first
+  ASSERT_TRUE(pa.freeBlock(b0));
+  ASSERT_TRUE(pa.freeBlock(b3));
+  u64 free = pa.freePages();
+  ASSERT_EQ(pa.resizeBlock(b2, 20 + free - 4, &move), b0 + 4);
+  ASSERT_EQ(move.pages, 20u);
+  pa.verify(false);
+  ASSERT_EQ(pa.freePages(), 4u);
+
+  // relocation copies the whole block
+  palloc::PageAllocator pb(100, 1);
+  u64 c0 = pb.createBlock(10);
+  u64 c1 = pb.createBlock(10);
+  ASSERT_EQ(pb.resizeBlock(c0, 30, &move), c1 + 10);
+  ASSERT_EQ(move.from, c0);
+  ASSERT_EQ(move.to, c1 + 10);
+  ASSERT_EQ(move.pages, 10u);
+  pb.verify(false);
+  ASSERT_EQ(pb.resizeBlock(c1, 200, &move), palloc::INV);
+  ASSERT_EQ(move.pages, 0u);
+  pb.verify(false);
+}
+
+TEST(PageAllocator, compaction) {
+  palloc::PageAllocator pa(256, 2);
+  std::vector<u64> blocks;
+  for (u64 idx = 0; idx < 16; idx++) {
+    blocks.push_back(pa.createBlock(8 + idx % 3));
+  }
+  for (u64 idx = 0; idx < 16; idx += 2) {
+    ASSERT_TRUE(pa.freeBlock(blocks.at(idx)));
+  }
+  pa.verify(false);
+  u64 free = pa.freePages();
+  ASSERT_GT(pa.freeBlocks(), 1u);
+  ASSERT_EQ(pa.createBlock(free), palloc::INV);
+
+  // a limited budget plans only some of the moves
+  std::vector<palloc::Move> plan;
+  u64 moved = pa.planCompaction(20, &plan);
+  ASSERT_LE(moved, 20u);
+  ASSERT_EQ(plan.size(), 2u);
+
+  // a full plan is committed incrementally
+  moved = pa.planCompaction(palloc::INV, &plan);
+  ASSERT_EQ(plan.size(), 8u);
+  u64 copied = 0;
+  auto copy = [&copied](const palloc::Move& _move) {
+    ASSERT_LT(_move.to, _move.from);
+    copied += _move.pages;
+  };
+  for (u64 first = 0; first < plan.size(); first += 3) {
+    ASSERT_EQ(pa.commitCompaction(plan, first, 3, copy),
+              std::min((u64)3, plan.size() - first));
+    pa.verify(false);
+  }
+  ASSERT_EQ(copied, moved);
+
+  // all free space is now one block at the end
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  ASSERT_EQ(pa.createBlock(free), 256u - free);
+
+  // stale moves are rejected
+  ASSERT_FALSE(pa.commitMove(plan.at(0)));
+  pa.verify(false);
+
+  // the plan merges the free blocks that make the largest one, not the ones
+  //  after the first free page
+  palloc::PageAllocator pb(100, 1);
+  std::vector<u64> sizes = {2, 30, 5, 2, 10, 2, 40, 9};
+  blocks.clear();
+  for (u64 size : sizes) {
+    blocks.push_back(pb.createBlock(size));
+  }
+  for (u64 idx : {0, 2, 4, 6}) {
+    ASSERT_TRUE(pb.freeBlock(blocks.at(idx)));
+  }
+  ASSERT_EQ(pb.planCompaction(0, &plan), 0u);
+  ASSERT_TRUE(plan.empty());
+  ASSERT_EQ(pb.planCompaction(4, &plan), 4u);
+  ASSERT_EQ(plan.size(), 2u);
+  ASSERT_EQ(plan.at(0).from, blocks.at(3));
+  ASSERT_EQ(plan.at(0).to, blocks.at(2));
+  ASSERT_EQ(pb.commitCompaction(plan, 0, plan.size(), nullptr), 2u);
+  ASSERT_EQ(pb.largestFreeBlock(), 55u);
+  pb.verify(false);
+}
+
+TEST(PageAllocator, aligned) {
+  for (u64 mbs = 1; mbs <= 5; mbs++) {
+    palloc::PageAllocator pa(4096, mbs);
+    ASSERT_EQ(pa.createAlignedBlock(0, 8), palloc::INV);
+    ASSERT_EQ(pa.createAlignedBlock(8, 0), palloc::INV);
+    ASSERT_EQ(pa.createAlignedBlock(8, 3), palloc::INV);
+
+    // misalign the free space
+    u64 b0 = pa.createBlock(3);
+    ASSERT_EQ(b0, 0u);
+
+    // the leading remainder becomes a free block
+    u64 b1 = pa.createAlignedBlock(10, 512);
+    ASSERT_EQ(b1, 512u);
+    pa.verify(false);
+    ASSERT_EQ(pa.freeBlocks(), 2u);
+
+    // a smaller block with an aligned range is used when the large one
+    //  isn't needed
+    u64 b2 = pa.createAlignedBlock(100, 64);
+    ASSERT_EQ(b2 % 64, 0u);
+    ASSERT_LT(b2, 512u);
+    pa.verify(false);
+
+    // the alignment must leave a valid leading block
+    u64 b3 = pa.createAlignedBlock(1, 4);
+    ASSERT_EQ(b3 % 4, 0u);
+    pa.verify(false);
+
+    // impossible alignments fail
+    ASSERT_EQ(pa.createAlignedBlock(2048, 4096), palloc::INV);
+    u64 b4 = pa.createAlignedBlock(2048, 2048);
+    ASSERT_EQ(b4, 2048u);
+    pa.verify(false);
+
+    ASSERT_TRUE(pa.freeBlock(b0));
+    ASSERT_TRUE(pa.freeBlock(b1));
+    ASSERT_TRUE(pa.freeBlock(b2));
+    ASSERT_TRUE(pa.freeBlock(b3));
+    ASSERT_TRUE(pa.freeBlock(b4));
+    pa.verify(false);
+    ASSERT_EQ(pa.freeBlocks(), 1u);
+  }
+}
+
+template <typename Allocator>
+static void checkAlignedProbes() {
+  // free blocks of 9 pages at pages 1 mod 16 can't hold 8 pages aligned to 8,
+  //  the aligned fit of 15 pages after more than kAlignedProbes of them is
+  //  missed
+  Allocator pa(4096, 1);
+  pa.createBlock(1);
+  std::vector<u64> holes;
+  for (u64 idx = 0; idx < palloc::kAlignedProbes + 8; idx++) {
+    holes.push_back(pa.createBlock(9));
+    pa.createBlock(7);
+  }
+  holes.push_back(pa.createBlock(15));
+  pa.createBlock(1);
+  u64 rest = pa.createBlock(pa.freePages());
+  ASSERT_NE(rest, palloc::INV);
+  for (u64 hole : holes) {
+    ASSERT_TRUE(pa.freeBlock(hole));
+  }
+  pa.verify(false);
+  ASSERT_EQ(pa.createAlignedBlock(8, 8), palloc::INV);
+  ASSERT_FALSE(pa.canAllocate(8, 8));
+
+  // a block large enough to surely hold the range is still found
+  ASSERT_TRUE(pa.freeBlock(rest));
+  u64 block = pa.createAlignedBlock(8, 8);
+  ASSERT_NE(block, palloc::INV);
+  ASSERT_EQ(block % 8, 0u);
+  pa.verify(false);
+}
+
+TEST(PageAllocator, alignedProbes) {
+  checkAlignedProbes<palloc::PageAllocator>();
+  checkAlignedProbes<palloc::FirstFitPageAllocator>();
+  checkAlignedProbes<palloc::NextFitPageAllocator>();
+}
+
+// this creates free holes of 16 pages at 0, 64 pages at 24, 32 pages at 96,
+//  and 24 pages at 136
+template <typename Allocator>
+static void makeHoles(Allocator* _pa) {
+  u64 a = _pa->createBlock(16);
+  _pa->createBlock(8);
+  u64 c = _pa->createBlock(64);
+  _pa->createBlock(8);
+  u64 e = _pa->createBlock(32);
+  _pa->createBlock(8);
+  ASSERT_TRUE(_pa->freeBlock(a));
+  ASSERT_TRUE(_pa->freeBlock(c));
+  ASSERT_TRUE(_pa->freeBlock(e));
+  _pa->verify(false);
+  ASSERT_EQ(_pa->freeBlocks(), 4u);
+}
+
+TEST(PageAllocator, firstFit) {
+  // best fit takes the smallest hole
+  palloc::PageAllocator bf(160, 1);
+  makeHoles(&bf);
+  ASSERT_EQ(bf.createBlock(20), 136u);
+  bf.verify(false);
+
+  // first fit takes the lowest addressed hole
+  palloc::FirstFitPageAllocator ff(160, 1);
+  makeHoles(&ff);
+  ASSERT_EQ(ff.createBlock(20), 24u);
+  ff.verify(false);
+  ASSERT_EQ(ff.createBlock(10), 0u);
+  ff.verify(false);
+  ASSERT_EQ(ff.createBlock(30), 44u);
+  ff.verify(false);
+  ASSERT_EQ(ff.createAlignedBlock(8, 32), 96u);
+  ff.verify(false);
+  ASSERT_EQ(ff.createBlock(40), palloc::INV);
+  ASSERT_TRUE(ff.freeBlock(44));
+  ASSERT_EQ(ff.createBlock(40), 44u);
+  ff.verify(false);
+}
+
+TEST(PageAllocator, nextFit) {
+  // next fit starts each search at the previous allocation (page 128 here)
+  palloc::NextFitPageAllocator nf(160, 1);
+  makeHoles(&nf);
+  ASSERT_EQ(nf.createBlock(20), 136u);
+  nf.verify(false);
+
+  // the search wraps around to page 0
+  ASSERT_EQ(nf.createBlock(16), 0u);
+  nf.verify(false);
+  ASSERT_EQ(nf.createBlock(20), 24u);
+  nf.verify(false);
+
+  // holes behind the previous allocation are skipped
+  ASSERT_TRUE(nf.freeBlock(0));
+  ASSERT_EQ(nf.createBlock(10), 44u);
+  nf.verify(false);
+  ASSERT_EQ(nf.createBlock(30), 54u);
+  nf.verify(false);
+  ASSERT_EQ(nf.createBlock(16), 96u);
+  nf.verify(false);
+  ASSERT_EQ(nf.createBlock(16), 112u);
+  nf.verify(false);
+  ASSERT_EQ(nf.createBlock(16), 0u);
+  nf.verify(false);
+  ASSERT_EQ(nf.createBlock(16), palloc::INV);
+  ASSERT_EQ(nf.freePages(), 8u);
+}
+
+TEST(PageAllocator, metadata) {
+  palloc::PageAllocator pa(1 << 20, 1);
+  u64 initial = pa.metadataBytes();
+  ASSERT_GE(initial, 1024 * sizeof(palloc::Block));
+
+  // the block pool and used map grow with the number of blocks
+  std::vector<u64> blocks;
+  for (u64 idx = 0; idx < 5000; idx++) {
+    blocks.push_back(pa.createBlock(1 + idx % 7));
+    ASSERT_NE(blocks.back(), palloc::INV);
+  }
+  u64 peak = pa.metadataBytes();
+  ASSERT_GE(peak, initial + 4000 * sizeof(palloc::Block));
+
+  // and are not shrunk when the blocks are freed
+  ASSERT_TRUE(pa.freeBlocks(blocks.data(), blocks.size()));
+  pa.verify(false);
+  ASSERT_GE(pa.metadataBytes(), peak);
+}
+
+TEST(PageAllocator, stats) {
+  palloc::PageAllocator pa(1024, 4);
+  palloc::Stats stats;
+  pa.getStats(&stats);
+  ASSERT_EQ(stats.classBlocks.size(), 9u);  // 4, 8, ..., 512, unbounded
+  ASSERT_EQ(stats.classBlocks.at(8), 1u);
+  ASSERT_EQ(stats.classPages.at(8), 1024u);
+  ASSERT_EQ(stats.largestFreeBlock, 1024u);
+  ASSERT_EQ(stats.fragmentation, 0.0);
+
+  // leave free blocks of 4, 8, and 800 pages
+  u64 b0 = pa.createBlock(4);
+  u64 b1 = pa.createBlock(100);
+  u64 b2 = pa.createBlock(8);
+  u64 b3 = pa.createBlock(100);
+  ASSERT_TRUE(pa.freeBlock(b0));
+  ASSERT_TRUE(pa.freeBlock(b2));
+  pa.getStats(&stats);
+  ASSERT_EQ(stats.classBlocks.at(0), 1u);
+  ASSERT_EQ(stats.classPages.at(0), 4u);
+  ASSERT_EQ(stats.classBlocks.at(1), 1u);
+  ASSERT_EQ(stats.classPages.at(1), 8u);
+  ASSERT_EQ(stats.classBlocks.at(8), 1u);
+  ASSERT_EQ(stats.classPages.at(8), 812u);
+  ASSERT_EQ(stats.largestFreeBlock, 812u);
+  ASSERT_DOUBLE_EQ(stats.fragmentation, 1.0 - 812.0 / 824.0);
+
+#ifdef PALLOC_STATS
+  ASSERT_EQ(stats.counters.splits, 4u);
+  ASSERT_EQ(stats.counters.coalesces, 0u);
+  ASSERT_EQ(stats.counters.failures, 0u);
+  ASSERT_EQ(stats.counters.probes.count(), 4u);
+  ASSERT_EQ(stats.counters.walked.count(), 4u);
+  ASSERT_EQ(pa.createBlock(1000), palloc::INV);
+  ASSERT_TRUE(pa.freeBlock(b1));
+  pa.getStats(&stats);
+  ASSERT_EQ(stats.counters.coalesces, 2u);
+  ASSERT_EQ(stats.counters.failures, 1u);
+#ifdef PALLOC_STATS_LATENCY
+  ASSERT_EQ(stats.counters.latency[palloc::kTraceCreateBlock].count(), 5u);
+  ASSERT_EQ(stats.counters.latency[palloc::kTraceFreeBlock].count(), 3u);
+#endif  // PALLOC_STATS_LATENCY
+  pa.resetStats();
+  pa.getStats(&stats);
+  ASSERT_EQ(stats.counters.coalesces, 0u);
+  ASSERT_EQ(stats.counters.probes.count(), 0u);
+
+  // removing the trailing free block isn't coalescing
+  ASSERT_TRUE(pa.truncate(b3 + 100));
+  pa.getStats(&stats);
+  ASSERT_EQ(stats.counters.coalesces, 0u);
+#else
+  ASSERT_EQ(stats.counters.splits, 0u);
+  ASSERT_EQ(stats.counters.probes.count(), 0u);
+#endif  // PALLOC_STATS
+
+  // the counters are kept out of line
+  ASSERT_LT(sizeof(palloc::PageAllocator), sizeof(palloc::StatCounters));
+  (void)b1;  // unused without PALLOC_STATS
+  (void)b3;  // unused
+}
+
+template <typename Allocator>
+static void checkQueries() {
+  // the queries predict the outcome of each allocation
+  Allocator pa(5000, 2);
+  std::vector<u64> blocks;
+  std::mt19937_64 rnd(12345);
+  for (u64 iter = 0; iter < 5000; iter++) {
+    if (blocks.empty() || rnd() % 5 < 3) {
+      u64 pages = 1 + rnd() % 200;
+      u64 alignment = (u64)1 << (rnd() % 6);
+      bool can = pa.canAllocate(pages, alignment);
+      u64 base = pa.createAlignedBlock(pages, alignment);
+      ASSERT_EQ(can, base != palloc::INV);
+      if (base != palloc::INV) {
+        blocks.push_back(base);
+      }
+    } else {
+      u64 pick = rnd() % blocks.size();
+      ASSERT_TRUE(pa.freeBlock(blocks.at(pick)));
+      blocks.at(pick) = blocks.back();
+      blocks.pop_back();
+    }
+    u64 largest = pa.largestFreeBlock();
+    ASSERT_EQ(pa.canAllocate(largest), largest > 0);
+    ASSERT_FALSE(pa.canAllocate(largest + 1));
+    if (iter % 500 == 0) {
+      pa.verify(false);
+    }
+  }
+}
+
+TEST(PageAllocator, queries) {
+  palloc::PageAllocator pa(1024, 4);
+  ASSERT_EQ(pa.numClasses(), 9u);
+  ASSERT_EQ(pa.largestFreeBlock(), 1024u);
+  ASSERT_EQ(pa.freeBlocksInClass(8), 1u);
+  ASSERT_EQ(pa.freePagesInClass(8), 1024u);
+  ASSERT_TRUE(pa.canAllocate(1024));
+  ASSERT_FALSE(pa.canAllocate(1025));
+  ASSERT_FALSE(pa.canAllocate(0));
+  ASSERT_TRUE(pa.canAllocate(512, 512));
+  ASSERT_FALSE(pa.canAllocate(1025, 512));
+  ASSERT_FALSE(pa.canAllocate(4, 3));
+
+  // leave free blocks of 4, 8, and 800 pages
+  u64 b0 = pa.createBlock(4);
+  u64 b1 = pa.createBlock(100);
+  u64 b2 = pa.createBlock(8);
+  u64 b3 = pa.createBlock(112);
+  ASSERT_TRUE(pa.freeBlock(b0));
+  ASSERT_TRUE(pa.freeBlock(b2));
+  ASSERT_EQ(pa.largestFreeBlock(), 800u);
+  ASSERT_EQ(pa.freePagesInClass(0), 4u);
+  ASSERT_EQ(pa.freePagesInClass(1), 8u);
+  ASSERT_EQ(pa.freeBlocksInClass(8), 1u);
+  ASSERT_EQ(pa.freePagesInClass(8), 800u);
+  ASSERT_FALSE(pa.canAllocate(801));
+  ASSERT_TRUE(pa.canAllocate(768, 256));
+  ASSERT_FALSE(pa.canAllocate(769, 256));
+  ASSERT_FALSE(pa.canAllocate(8, 1024));
+  pa.verify(false);
+
+  // quick listed blocks count separately in the size classes but the
+  //  largest free block is what coalescing would make of them
+  pa.setDeferredCoalescing(1024, 1.0);
+  ASSERT_TRUE(pa.freeBlock(b1));
+  ASSERT_TRUE(pa.freeBlock(b3));
+  pa.verify(false);
+  ASSERT_EQ(pa.largestFreeBlock(), 1024u);
+  ASSERT_TRUE(pa.canAllocate(1024));
+  ASSERT_TRUE(pa.canAllocate(1024, 1024));
+  ASSERT_EQ(pa.freeBlocksInClass(5), 2u);  // 100 and 112 pages
+  ASSERT_EQ(pa.freePagesInClass(5), 212u);
+  pa.coalesceAll();
+  ASSERT_EQ(pa.largestFreeBlock(), 1024u);
+  ASSERT_EQ(pa.freePagesInClass(5), 0u);
+  u64 b4 = pa.createBlock(1000);
+  ASSERT_EQ(pa.largestFreeBlock(), 24u);
+  ASSERT_TRUE(pa.freeBlock(b4));
+  ASSERT_EQ(pa.freeBlocks(), 2u);  // quick listed
+  ASSERT_EQ(pa.largestFreeBlock(), 1024u);
+  pa.verify(false);
+
+  // adjacent quick listed blocks are merged by createBlock
+  palloc::PageAllocator pq(16, 1);
+  pq.setDeferredCoalescing(8, 1.0);
+  u64 q[4];
+  for (u64 idx = 0; idx < 4; idx++) {
+    q[idx] = pq.createBlock(4);
+  }
+  ASSERT_TRUE(pq.freeBlock(q[1]));
+  ASSERT_TRUE(pq.freeBlock(q[2]));
+  ASSERT_EQ(pq.freeBlocks(), 2u);
+  ASSERT_EQ(pq.largestFreeBlock(), 8u);
+  ASSERT_TRUE(pq.canAllocate(8));
+  ASSERT_FALSE(pq.canAllocate(9));
+  ASSERT_TRUE(pq.canAllocate(8, 4));
+  ASSERT_FALSE(pq.canAllocate(8, 8));
+  palloc::Stats stats;
+  pq.getStats(&stats);
+  ASSERT_EQ(stats.largestFreeBlock, 8u);
+  ASSERT_EQ(stats.fragmentation, 0.0);
+  pq.verify(false);
+  ASSERT_EQ(pq.createBlock(8), 4u);
+  ASSERT_EQ(pq.largestFreeBlock(), 0u);
+  ASSERT_FALSE(pq.canAllocate(1));
+  pq.verify(false);
+
+  checkQueries<palloc::PageAllocator>();
+  checkQueries<palloc::FirstFitPageAllocator>();
+  checkQueries<palloc::NextFitPageAllocator>();
+}
+
+template <typename Allocator>
+static void checkFixedRanges() {
+  // fixed ranges succeed exactly when all of their pages are free
+  const u64 kPages = 4000;
+  Allocator pa(kPages, 1);
+  std::vector<bool> used(kPages, false);
+  std::vector<std::pair<u64, u64> > blocks;
+  std::mt19937_64 rnd(12345);
+  for (u64 iter = 0; iter < 5000; iter++) {
+    if (blocks.empty() || rnd() % 5 < 3) {
+      u64 base = rnd() % kPages;
+      u64 pages = 1 + rnd() % 100;
+      bool free = base + pages <= kPages;
+      for (u64 page = base; free && page < base + pages; page++) {
+        free = !used.at(page);
+      }
+      ASSERT_EQ(pa.createBlockAt(base, pages), free);
+      if (free) {
+        std::fill(used.begin() + base, used.begin() + base + pages, true);
+        blocks.push_back(std::make_pair(base, pages));
+      }
+    } else {
+      u64 pick = rnd() % blocks.size();
+      ASSERT_TRUE(pa.freeBlock(blocks.at(pick).first));
+      std::fill(used.begin() + blocks.at(pick).first,
+                used.begin() + blocks.at(pick).first + blocks.at(pick).second,
+                false);
+      blocks.at(pick) = blocks.back();
+      blocks.pop_back();
+    }
+    if (iter % 500 == 0) {
+      pa.verify(false);
+    }
+  }
+  pa.verify(false);
+}
+
+TEST(PageAllocator, fixedRanges) {
+  palloc::PageAllocator pa(1000, 4);
+  ASSERT_FALSE(pa.createBlockAt(0, 0));
+  ASSERT_FALSE(pa.createBlockAt(1000, 1));
+  ASSERT_FALSE(pa.createBlockAt(990, 11));
+
+  // the leading and trailing free pages are split off
+  ASSERT_TRUE(pa.createBlockAt(100, 50));
+  ASSERT_EQ(pa.blockSize(100), 50u);
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+  ASSERT_EQ(pa.usedPages(), 50u);
+  ASSERT_EQ(pa.largestFreeBlock(), 850u);
+  pa.verify(false);
+
+  // used pages and short leading free blocks fail cleanly
+  ASSERT_FALSE(pa.createBlockAt(149, 10));
+  ASSERT_FALSE(pa.createBlockAt(90, 20));
+  ASSERT_FALSE(pa.createBlockAt(152, 10));
+  ASSERT_EQ(pa.usedBlocks(), 1u);
+
+  // short trailing free pages stay with the block, short requests round up
+  ASSERT_TRUE(pa.createBlockAt(90, 8));
+  ASSERT_EQ(pa.blockSize(90), 10u);
+  ASSERT_TRUE(pa.createBlockAt(150, 1));
+  ASSERT_EQ(pa.blockSize(150), 4u);
+  ASSERT_EQ(pa.createBlock(90), 0u);
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  pa.verify(false);
+
+  // quick listed blocks are coalesced when they hold the range
+  palloc::PageAllocator quick(1000, 1);
+  quick.setDeferredCoalescing(8, 0.9);
+  u64 q0 = quick.createBlock(8);
+  u64 q1 = quick.createBlock(8);
+  ASSERT_TRUE(quick.freeBlock(q0));
+  ASSERT_TRUE(quick.freeBlock(q1));
+  ASSERT_TRUE(quick.createBlockAt(4, 8));
+  ASSERT_EQ(quick.freeBlocks(), 2u);
+  quick.verify(false);
+
+  checkFixedRanges<palloc::PageAllocator>();
+  checkFixedRanges<palloc::FirstFitPageAllocator>();
+  checkFixedRanges<palloc::NextFitPageAllocator>();
+}
+
+TEST(PageAllocator, reserveRanges) {
+  palloc::PageAllocator pa(1 << 16, 2);
+
+  // overlapping, out of bounds, short gaps, and used pages fail the batch
+  u64 bases[] = {300, 100, 200, 101};
+  u64 pages[] = {10, 1, 50, 10};
+  ASSERT_FALSE(pa.reserveRanges(bases, pages, 4));
+  bases[3] = 103;
+  ASSERT_FALSE(pa.reserveRanges(bases, pages, 4));
+  bases[0] = 1 << 16;
+  bases[3] = 104;
+  ASSERT_FALSE(pa.reserveRanges(bases, pages, 4));
+  ASSERT_EQ(pa.usedBlocks(), 0u);
+  ASSERT_TRUE(pa.reserveRanges(bases, pages, 0));
+
+  // a valid batch in any order
+  bases[0] = 300;
+  ASSERT_TRUE(pa.reserveRanges(bases, pages, 4));
+  ASSERT_EQ(pa.usedBlocks(), 4u);
+  ASSERT_EQ(pa.blockSize(100), 2u);
+  ASSERT_EQ(pa.blockSize(104), 10u);
+  ASSERT_EQ(pa.freeBlocks(), 5u);
+  ASSERT_FALSE(pa.reserveRanges(bases, pages, 1));
+  pa.verify(false);
+
+  // thousands of ranges restored at once
+  palloc::PageAllocator big(1 << 20, 1);
+  std::vector<u64> rangeBases;
+  std::vector<u64> rangePages;
+  std::mt19937_64 rnd(12345);
+  for (u64 base = 0; base < (1 << 20) - 64; base += 64) {
+    if (rnd() % 2 == 0) {
+      rangeBases.push_back(base + rnd() % 32);
+      rangePages.push_back(1 + rnd() % 32);
+    }
+  }
+  std::reverse(rangeBases.begin(), rangeBases.end());
+  std::reverse(rangePages.begin(), rangePages.end());
+  ASSERT_TRUE(big.reserveRanges(rangeBases.data(), rangePages.data(),
+                                rangeBases.size()));
+  ASSERT_EQ(big.usedBlocks(), rangeBases.size());
+  big.verify(false);
+}
+
+template <typename Allocator>
+static void checkResizing() {
+  // allocations continue across random growth and shrinking of the space
+  Allocator pa(1000, 2);
+  pa.setDeferredCoalescing(4, 0.5);
+  std::vector<u64> blocks;
+  std::mt19937_64 rnd(12345);
+  u64 truncated = 0;
+  for (u64 iter = 0; iter < 5000; iter++) {
+    u64 choice = rnd() % 20;
+    u64 pages = pa.totalPages();
+    if (choice == 0) {
+      u64 morePages = 1 + rnd() % 500;
+      bool res = pa.extend(morePages);
+      ASSERT_EQ(pa.totalPages(), res ? pages + morePages : pages);
+    } else if (choice == 1) {
+      u64 newPages = pages - rnd() % std::min(pages - 2, (u64)500);
+      bool res = pa.truncate(newPages);
+      ASSERT_EQ(pa.totalPages(), res ? newPages : pages);
+      truncated += (res && newPages < pages) ? 1 : 0;
+    } else if (blocks.empty() || choice < 12) {
+      u64 base = pa.createBlock(1 + rnd() % 50);
+      if (base != palloc::INV) {
+        blocks.push_back(base);
+      }
+    } else {
+      u64 pick = rnd() % blocks.size();
+      ASSERT_TRUE(pa.freeBlock(blocks.at(pick)));
+      blocks.at(pick) = blocks.back();
+      blocks.pop_back();
+    }
+    ASSERT_EQ(pa.freePages() + pa.usedPages(), pa.totalPages());
+    u64 freePages = 0;
+    for (u64 index = 0; index < pa.numClasses(); index++) {
+      freePages += pa.freePagesInClass(index);
+    }
+    ASSERT_EQ(freePages, pa.freePages());
+    if (iter % 500 == 0) {
+      pa.verify(false);
+    }
+  }
+  pa.verify(false);
+  ASSERT_GT(truncated, 0u);
+}
+
+TEST(PageAllocator, resizing) {
+  palloc::PageAllocator pa(1000, 4);
+  ASSERT_EQ(pa.numClasses(), 9u);
+  ASSERT_FALSE(pa.extend(0));
+  ASSERT_FALSE(pa.extend(palloc::INV - 1000));
+
+  // extending coalesces with the trailing free block and adds classes
+  ASSERT_TRUE(pa.extend(1000));
+  ASSERT_EQ(pa.totalPages(), 2000u);
+  ASSERT_EQ(pa.freePages(), 2000u);
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  ASSERT_EQ(pa.numClasses(), 10u);
+  ASSERT_EQ(pa.freePagesInClass(9), 2000u);
+  ASSERT_EQ(pa.largestFreeBlock(), 2000u);
+
+  // extending after a used block appends a free block
+  ASSERT_TRUE(pa.createBlockAt(1900, 100));
+  ASSERT_FALSE(pa.extend(2));
+  ASSERT_TRUE(pa.extend(48));
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+  ASSERT_EQ(pa.createBlock(48), 2000u);
+  ASSERT_TRUE(pa.freeBlock(2000));
+  pa.verify(false);
+
+  // truncating needs a free tail
+  ASSERT_TRUE(pa.truncate(2000));
+  ASSERT_EQ(pa.freeBlocks(), 1u);
+  ASSERT_FALSE(pa.truncate(1950));
+  ASSERT_FALSE(pa.truncate(2001));
+  ASSERT_TRUE(pa.freeBlock(1900));
+  ASSERT_TRUE(pa.truncate(500));
+  ASSERT_EQ(pa.totalPages(), 500u);
+  ASSERT_EQ(pa.numClasses(), 8u);
+  ASSERT_EQ(pa.freePagesInClass(7), 500u);
+  ASSERT_FALSE(pa.truncate(3));
+  pa.verify(false);
+
+  // the rest of a truncated free block must be a valid block
+  ASSERT_TRUE(pa.createBlockAt(0, 100));
+  ASSERT_FALSE(pa.truncate(102));
+  ASSERT_TRUE(pa.truncate(104));
+  ASSERT_EQ(pa.freePages(), 4u);
+  ASSERT_TRUE(pa.truncate(100));
+  ASSERT_EQ(pa.freeBlocks(), 0u);
+  ASSERT_TRUE(pa.extend(4000));
+  ASSERT_EQ(pa.createBlock(4000), 100u);
+  pa.verify(false);
+
+  checkResizing<palloc::PageAllocator>();
+  checkResizing<palloc::FirstFitPageAllocator>();
+  checkResizing<palloc::NextFitPageAllocator>();
+}
+
+template <typename Allocator>
+static void checkVisitors() {
+  // the visitors agree with a map of the pages
+  const u64 kPages = 5000;
+  Allocator pa(kPages, 2);
+  pa.setDeferredCoalescing(4, 0.5);
+  std::vector<u64> blocks;
+  std::mt19937_64 rnd(12345);
+  for (u64 iter = 0; iter < 2000; iter++) {
+    // the range index is toggled while blocks change
+    if (iter % 500 == 250) {
+      pa.setRangeIndex(iter % 1000 == 250);
+    }
+    if (blocks.empty() || rnd() % 5 < 3) {
+      u64 base = pa.createBlock(1 + rnd() % 40);
+      if (base != palloc::INV) {
+        blocks.push_back(base);
+      }
+    } else {
+      u64 pick = rnd() % blocks.size();
+      ASSERT_TRUE(pa.freeBlock(blocks.at(pick)));
+      blocks.at(pick) = blocks.back();
+      blocks.pop_back();
+    }
+    if (iter % 100 != 0) {
+      continue;
+    }
+
+    // used and free blocks tile the pages in order
+    std::vector<u64> owner(kPages, palloc::INV);
+    std::vector<bool> used(kPages, false);
+    u64 usedCount = 0;
+    pa.forEachUsed([&](u64 _base, u64 _pages) {
+        usedCount++;
+        for (u64 page = _base; page < _base + _pages; page++) {
+          owner.at(page) = _base;
+          used.at(page) = true;
+        }
+      });
+    u64 freeCount = 0;
+    u64 last = 0;
+    pa.forEachFree([&](u64 _base, u64 _pages) {
+        freeCount++;
+        ASSERT_TRUE(freeCount == 1 || _base > last);
+        last = _base;
+        for (u64 page = _base; page < _base + _pages; page++) {
+          ASSERT_EQ(owner.at(page), palloc::INV);
+          owner.at(page) = _base;
+        }
+      });
+    ASSERT_EQ(usedCount, pa.usedBlocks());
+    ASSERT_EQ(freeCount, pa.freeBlocks());
+    ASSERT_EQ(std::count(owner.begin(), owner.end(), palloc::INV), 0);
+    pa.verify(false);
+
+    // a range visits exactly the blocks holding its pages
+    for (u64 query = 0; query < 20; query++) {
+      u64 lo = rnd() % (kPages + 10);
+      u64 hi = lo + rnd() % 200;
+      std::vector<u64> expected;
+      for (u64 page = lo; page < std::min(hi, kPages); page++) {
+        if (expected.empty() || expected.back() != owner.at(page)) {
+          expected.push_back(owner.at(page));
+        }
+      }
+      std::vector<u64> visited;
+      pa.forEachBlockInRange(lo, hi, [&](u64 _base, u64 _pages, bool _used) {
+          ASSERT_EQ(_used, used.at(_base));
+          ASSERT_GT(_base + _pages, lo);
+          visited.push_back(_base);
+        });
+      ASSERT_EQ(visited, expected);
+    }
+  }
+}
+
+TEST(PageAllocator, visitors) {
+  palloc::PageAllocator pa(1000, 1);
+  u64 b0 = pa.createBlock(100);
+  u64 b1 = pa.createBlock(100);
+  u64 b2 = pa.createBlock(100);
+  ASSERT_TRUE(pa.freeBlock(b1));
+  u64 calls = 0;
+  pa.forEachBlockInRange(150, 250, [&](u64 _base, u64 _pages, bool _used) {
+      ASSERT_EQ(_base, calls == 0 ? b1 : b2);
+      ASSERT_EQ(_pages, 100u);
+      ASSERT_EQ(_used, calls == 1);
+      calls++;
+    });
+  ASSERT_EQ(calls, 2u);
+  pa.forEachBlockInRange(50, 50, [&](u64, u64, bool) { calls++; });
+  pa.forEachBlockInRange(1000, 2000, [&](u64, u64, bool) { calls++; });
+  ASSERT_EQ(calls, 2u);
+  pa.forEachBlockInRange(0, 1, [&](u64 _base, u64, bool _used) {
+      ASSERT_EQ(_base, b0);
+      ASSERT_TRUE(_used);
+      calls++;
+    });
+  ASSERT_EQ(calls, 3u);
+
+  checkVisitors<palloc::PageAllocator>();
+  checkVisitors<palloc::FirstFitPageAllocator>();
+  checkVisitors<palloc::NextFitPageAllocator>();
+}
+
+TEST(PageAllocator, blockRangeOnUsedHeap) {
+  // only page 0 is free so the free block before any range is far away,
+  //  with the range index the walk still starts at the used block holding
+  //  the start of the range
+  const u64 kPages = 1 << 16;
+  palloc::PageAllocator pa(kPages, 1);
+  pa.setRangeIndex(true);
+  for (u64 page = 0; page < kPages; page++) {
+    ASSERT_EQ(pa.createBlock(1), page);
+  }
+  ASSERT_TRUE(pa.freeBlock(0));
+  pa.verify(false);
+
+  // the visits are the same with the index kept as blocks change, rebuilt,
+  //  and disabled
+  for (u64 pass = 0; pass < 3; pass++) {
+    if (pass == 1) {
+      pa.setRangeIndex(false);
+      pa.setRangeIndex(true);
+    } else if (pass == 2) {
+      pa.setRangeIndex(false);
+    }
+    pa.verify(false);
+    u64 ranges = 0;
+    u64 visited = 0;
+    for (u64 lo = 1; lo + 3 <= kPages; lo += 997) {
+      ranges++;
+      pa.forEachBlockInRange(lo, lo + 3, [&](u64 _base, u64 _pages,
+                                             bool _used) {
+          ASSERT_EQ(_base, lo + visited % 3);
+          ASSERT_EQ(_pages, 1u);
+          ASSERT_TRUE(_used);
+          visited++;
+        });
+    }
+    ASSERT_EQ(visited, ranges * 3);
+  }
+}
+
+TEST(PageAllocator, releaseRange) {
+  palloc::PageAllocator pa(1000, 4);
+  u64 b0 = pa.createBlock(100);
+  u64 b1 = pa.createBlock(100);
+  ASSERT_FALSE(pa.releaseRange(b0 + 1, 0, 10));
+  ASSERT_FALSE(pa.releaseRange(b0, 0, 0));
+  ASSERT_FALSE(pa.releaseRange(b0, 91, 10));
+  ASSERT_FALSE(pa.releaseRange(b0, 10, 2));
+
+  // a hole in the middle leaves two used blocks
+  ASSERT_TRUE(pa.releaseRange(b0, 10, 20));
+  ASSERT_EQ(pa.blockSize(b0), 10u);
+  ASSERT_EQ(pa.blockSize(b0 + 30), 70u);
+  ASSERT_EQ(pa.usedBlocks(), 3u);
+  ASSERT_EQ(pa.usedPages(), 180u);
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+  ASSERT_EQ(pa.createBlock(20), b0 + 10);
+  ASSERT_TRUE(pa.freeBlock(b0 + 10));
+  pa.verify(false);
+
+  // releasing the head moves the block and coalesces with a free neighbor
+  ASSERT_TRUE(pa.releaseRange(b0 + 30, 0, 30));
+  ASSERT_EQ(pa.blockSize(b0 + 30), 0u);
+  ASSERT_EQ(pa.blockSize(b0 + 60), 40u);
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+  ASSERT_EQ(pa.largestFreeBlock(), 800u);
+  pa.verify(false);
+
+  // releasing the tail coalesces forward, releasing all pages frees
+  ASSERT_TRUE(pa.releaseRange(b1, 50, 50));
+  ASSERT_EQ(pa.blockSize(b1), 50u);
+  ASSERT_EQ(pa.largestFreeBlock(), 850u);
+  ASSERT_TRUE(pa.releaseRange(b0, 0, 10));
+  ASSERT_EQ(pa.usedBlocks(), 2u);
+  ASSERT_EQ(pa.freeBlocks(), 2u);
+  pa.verify(false);
+
+  // random holes keep the page map exact
+  std::mt19937_64 rnd(12345);
+  palloc::PageAllocator rpa(5000, 2);
+  rpa.setDeferredCoalescing(4, 0.5);
+  std::vector<bool> used(5000, false);
+  for (u64 iter = 0; iter < 3000; iter++) {
+    u64 choice = rnd() % 3;
+    if (choice == 0) {
+      u64 pages = 1 + rnd() % 60;
+      u64 base = rpa.createBlock(pages);
+      if (base != palloc::INV) {
+        std::fill(used.begin() + base,
+                  used.begin() + base + rpa.blockSize(base), true);
+      }
+      continue;
+    }
+    std::vector<std::pair<u64, u64> > blocks;
+    rpa.forEachUsed([&](u64 _base, u64 _pages) {
+        blocks.push_back(std::make_pair(_base, _pages));
+      });
+    if (blocks.empty()) {
+      continue;
+    }
+    std::pair<u64, u64> block = blocks.at(rnd() % blocks.size());
+    u64 offset = rnd() % block.second;
+    u64 pages = 1 + rnd() % (block.second - offset);
+    bool valid = pages == block.second || pages >= 2;
+    ASSERT_EQ(rpa.releaseRange(block.first, offset, pages), valid);
+    if (valid) {
+      std::fill(used.begin() + block.first + offset,
+                used.begin() + block.first + offset + pages, false);
+    }
+    u64 usedPages = 0;
+    rpa.forEachUsed([&](u64 _base, u64 _pages) {
+        usedPages += _pages;
+        for (u64 page = _base; page < _base + _pages; page++) {
+          ASSERT_TRUE(used.at(page));
+        }
+      });
+    ASSERT_EQ(usedPages, (u64)std::count(used.begin(), used.end(), true));
+    if (iter % 300 == 0) {
+      rpa.verify(false);
+    }
+  }
+  rpa.verify(false);
+}
+
+TEST(PageAllocator, snapshot) {
+  std::string path = testing::TempDir() + "palloc_snapshot_test.bin";
+  std::mt19937_64 rnd(12345);
+
+  // build a fragmented state with some quick listed blocks
+  palloc::PageAllocator pa(1 << 16, 2);
+  pa.setDeferredCoalescing(8, 0.9);
+  std::vector<u64> blocks;
+  for (u64 idx = 0; idx < 3000; idx++) {
+    if (blocks.empty() || rnd() % 3 != 0) {
+      u64 base = pa.createBlock(1 + rnd() % 40);
+      if (base != palloc::INV) {
+        blocks.push_back(base);
+      }
+    } else {
+      u64 pick = rnd() % blocks.size();
+      ASSERT_TRUE(pa.freeBlock(blocks.at(pick)));
+      blocks.at(pick) = blocks.back();
+      blocks.pop_back();
+    }
+  }
+  pa.verify(false);
+  ASSERT_TRUE(pa.saveSnapshot(path));
+
+  // load into a fresh allocator of each policy
+  palloc::PageAllocator pb(1 << 16, 2);
+  ASSERT_TRUE(pb.loadSnapshot(path));
+  pb.verify(false);
+  palloc::FirstFitPageAllocator pf(1 << 16, 2);
+  pf.createBlock(100);
+  ASSERT_TRUE(pf.loadSnapshot(path));
+  pf.verify(false);
+  pa.coalesceAll();
+  for (u64 idx = 0; idx < 2; idx++) {
+    ASSERT_EQ(pb.usedBlocks(), pa.usedBlocks());
+    ASSERT_EQ(pb.usedPages(), pa.usedPages());
+    ASSERT_EQ(pb.freeBlocks(), pa.freeBlocks());
+    ASSERT_EQ(pf.freeBlocks(), pa.freeBlocks());
+    ASSERT_EQ(pf.freePages(), pa.freePages());
+
+    // the same blocks are used
+    u64 pick = rnd() % blocks.size();
+    ASSERT_TRUE(pa.freeBlock(blocks.at(pick)));
+    ASSERT_TRUE(pb.freeBlock(blocks.at(pick)));
+    ASSERT_TRUE(pf.freeBlock(blocks.at(pick)));
+    blocks.at(pick) = blocks.back();
+    blocks.pop_back();
+  }
+  for (u64 base : blocks) {
+    ASSERT_TRUE(pb.freeBlock(base));
+    ASSERT_TRUE(pf.freeBlock(base));
+  }
+  pb.verify(false);
+  pf.verify(false);
+  ASSERT_EQ(pb.freeBlocks(), 1u);
+  ASSERT_EQ(pf.freeBlocks(), 1u);
+
+  // a snapshot of another geometry is rejected and nothing changes
+  u64 base = pb.createBlock(10);
+  palloc::PageAllocator pc(1 << 16, 1);
+  ASSERT_FALSE(pc.loadSnapshot(path));
+  palloc::PageAllocator pd(1 << 15, 2);
+  ASSERT_FALSE(pd.loadSnapshot(path));
+  ASSERT_TRUE(pb.saveSnapshot(path));
+  ASSERT_TRUE(pa.loadSnapshot(path));
+  pa.verify(false);
+  ASSERT_EQ(pa.usedBlocks(), 1u);
+  ASSERT_TRUE(pa.freeBlock(base));
+
+  // a truncated or corrupt snapshot is rejected and nothing changes
+  FILE* file = fopen(path.c_str(), "r+b");
+  ASSERT_NE(file, nullptr);
+  ASSERT_EQ(fseek(file, 0, SEEK_END), 0);
+  long size = ftell(file);  // NOLINT
+  u64 word = 5;
+  ASSERT_EQ(fseek(file, size - sizeof(word), SEEK_SET), 0);
+  ASSERT_EQ(fwrite(&word, sizeof(word), 1, file), 1u);
+  ASSERT_EQ(fclose(file), 0);
+  ASSERT_FALSE(pb.loadSnapshot(path));
+  ASSERT_TRUE(truncate(path.c_str(), size - 1) == 0);
+  ASSERT_FALSE(pb.loadSnapshot(path));
+  pb.verify(false);
+  ASSERT_EQ(pb.usedBlocks(), 1u);
+  ASSERT_EQ(pb.usedPages(), 10u);
+
+  // a missing file is rejected
+  ASSERT_EQ(remove(path.c_str()), 0);
+  ASSERT_FALSE(pb.loadSnapshot(path));
+  ASSERT_FALSE(pb.saveSnapshot("/nonexistent/palloc_snapshot_test.bin"));
+}
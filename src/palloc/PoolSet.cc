@@ -0,0 +1,176 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/PoolSet.h"
+
+#include <cassert>
+#include <cstdio>
+
+namespace palloc {
+
+PoolSet::PoolSet()
+    : interleave_(0) {}
+
+PoolSet::~PoolSet() {
+  for (Pool* pool : pools_) {
+    delete pool;
+  }
+}
+
+bool PoolSet::addPool(u64 _node, u64 _pages, u64 _minBlockSize) {
+  if (positions_.count(_node) != 0) {
+    return false;
+  }
+  Pool* pool = new Pool(_node, _pages, _minBlockSize);
+  positions_[_node] = pools_.size();
+  pools_.push_back(pool);
+  return true;
+}
+
+PoolBlock PoolSet::createBlock(u64 _pages, u64 _node, PoolPolicy _policy) {
+  PoolBlock block = {INV, INV};
+  u64 pos = INV;
+  switch (_policy) {
+    case kPoolStrict:
+      pos = position(_node);
+      if (pos != INV) {
+        pos = createFrom(pos, 1, _pages, &block.base);
+      }
+      break;
+
+    case kPoolPreferred:
+      pos = position(_node);
+      if (pos != INV) {
+        pos = createFrom(pos, pools_.size(), _pages, &block.base);
+      }
+      break;
+
+    case kPoolInterleave:
+      if (!pools_.empty()) {
+        pos = createFrom(interleave_, pools_.size(), _pages, &block.base);
+        if (pos != INV) {
+          interleave_ = (pos + 1) % pools_.size();
+        }
+      }
+      break;
+  }
+  if (pos != INV) {
+    block.node = pools_[pos]->node;
+  }
+  return block;
+}
+
+bool PoolSet::freeBlock(const PoolBlock& _block) {
+  u64 pos = position(_block.node);
+  if (pos == INV) {
+    return false;
+  }
+  return pools_[pos]->allocator.freeBlock(_block.base);
+}
+
+std::vector<u64> PoolSet::nodes() const {
+  std::vector<u64> nodes;
+  for (const Pool* pool : pools_) {
+    nodes.push_back(pool->node);
+  }
+  return nodes;
+}
+
+const PageAllocator* PoolSet::pool(u64 _node) const {
+  u64 pos = position(_node);
+  return pos == INV ? nullptr : &pools_[pos]->allocator;
+}
+
+f64 PoolSet::occupancy(u64 _node) const {
+  const PageAllocator* allocator = pool(_node);
+  if (allocator == nullptr) {
+    return 0.0;
+  }
+  return (f64)allocator->usedPages() / allocator->totalPages();
+}
+
+u64 PoolSet::totalPages() const {
+  u64 pages = 0;
+  for (const Pool* pool : pools_) {
+    pages += pool->allocator.totalPages();
+  }
+  return pages;
+}
+
+u64 PoolSet::freePages() const {
+  u64 pages = 0;
+  for (const Pool* pool : pools_) {
+    pages += pool->allocator.freePages();
+  }
+  return pages;
+}
+
+u64 PoolSet::usedPages() const {
+  u64 pages = 0;
+  for (const Pool* pool : pools_) {
+    pages += pool->allocator.usedPages();
+  }
+  return pages;
+}
+
+void PoolSet::verify(bool _print) const {
+  assert(positions_.size() == pools_.size());
+  for (u64 pos = 0; pos < pools_.size(); pos++) {
+    assert(position(pools_[pos]->node) == pos);
+    if (_print) {
+      printf("node=%lu\n", pools_[pos]->node);
+    }
+    pools_[pos]->allocator.verify(_print);
+  }
+  assert(pools_.empty() || interleave_ < pools_.size());
+}
+
+/*** private below here ***/
+
+PoolSet::Pool::Pool(u64 _node, u64 _pages, u64 _minBlockSize)
+    : node(_node), allocator(_pages, _minBlockSize) {}
+
+u64 PoolSet::position(u64 _node) const {
+  std::unordered_map<u64, u64>::const_iterator it = positions_.find(_node);
+  return it == positions_.end() ? INV : it->second;
+}
+
+u64 PoolSet::createFrom(u64 _first, u64 _count, u64 _pages, u64* _base) {
+  for (u64 idx = 0; idx < _count; idx++) {
+    u64 pos = (_first + idx) % pools_.size();
+    *_base = pools_[pos]->allocator.createBlock(_pages);
+    if (*_base != INV) {
+      return pos;
+    }
+  }
+  return INV;
+}
+
+}  // namespace palloc
@@ -0,0 +1,126 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_POOLSET_H_
+#define PALLOC_POOLSET_H_
+
+#include <prim/prim.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "palloc/PageAllocator.h"
+
+namespace palloc {
+
+/*
+ * This is a set of PageAllocator pools, one per memory node (e.g., a NUMA
+ * node or a device memory region). Node ids are logical, the set only uses
+ * them to name the pools. Blocks are placed by a policy:
+ *  kPoolStrict      only the requested node
+ *  kPoolPreferred   the requested node then the other pools in the order
+ *                   they were added, starting after the requested node
+ *  kPoolInterleave  round robin over all pools, the node is ignored
+ * A block is named by a PoolBlock handle so freeBlock() goes straight to
+ * the owning pool.
+ */
+
+enum PoolPolicy : u8 {
+  kPoolStrict = 0,
+  kPoolPreferred = 1,
+  kPoolInterleave = 2
+};
+
+// a block and the node of the pool that owns it
+struct PoolBlock {
+  u64 node;
+  u64 base;  // INV if no block
+};
+
+class PoolSet {
+ public:
+  PoolSet();
+  ~PoolSet();
+
+  // adds a pool of '_pages' pages for a node
+  //  returns true if success, false if the node already has a pool
+  bool addPool(u64 _node, u64 _pages, u64 _minBlockSize);
+
+  // allocates a block as directed by the policy
+  //  returns the block, its base is INV if no pool could satisfy it
+  PoolBlock createBlock(u64 _pages, u64 _node, PoolPolicy _policy);
+
+  // frees an allocated block
+  //  returns true if success, false otherwise
+  bool freeBlock(const PoolBlock& _block);
+
+  // returns the node ids in the order the pools were added
+  std::vector<u64> nodes() const;
+
+  // returns the pool of a node, nullptr if none
+  const PageAllocator* pool(u64 _node) const;
+
+  // returns the fraction of the pages of a node that are used, 0 if none
+  f64 occupancy(u64 _node) const;
+
+  // returns the total number of pages of all pools
+  u64 totalPages() const;
+
+  // returns the number of free pages of all pools
+  u64 freePages() const;
+
+  // returns the number of used pages of all pools
+  u64 usedPages() const;
+
+  // verify internal data structures
+  void verify(bool _print) const;
+
+ private:
+  struct Pool {
+    Pool(u64 _node, u64 _pages, u64 _minBlockSize);
+    const u64 node;
+    PageAllocator allocator;
+  };
+
+  // this returns the position of a node's pool, INV if none
+  u64 position(u64 _node) const;
+
+  // this allocates from the pools in order starting at '_first', trying at
+  //  most '_count' pools, returns the position of the pool used or INV
+  u64 createFrom(u64 _first, u64 _count, u64 _pages, u64* _base);
+
+  std::vector<Pool*> pools_;  // in the order they were added
+  std::unordered_map<u64, u64> positions_;  // node to position in pools_
+  u64 interleave_;  // position of the next interleaved pool
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_POOLSET_H_
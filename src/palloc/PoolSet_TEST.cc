@@ -0,0 +1,100 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/PoolSet.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <vector>
+
+TEST(PoolSet, policies) {
+  palloc::PoolSet ps;
+  ASSERT_TRUE(ps.addPool(7, 100, 1));
+  ASSERT_TRUE(ps.addPool(3, 200, 1));
+  ASSERT_TRUE(ps.addPool(5, 100, 1));
+  ASSERT_FALSE(ps.addPool(3, 50, 1));
+  ASSERT_EQ(ps.nodes(), std::vector<u64>({7, 3, 5}));
+  ASSERT_EQ(ps.totalPages(), 400u);
+  ps.verify(false);
+
+  // strict stays on the node
+  palloc::PoolBlock b0 = ps.createBlock(80, 7, palloc::kPoolStrict);
+  ASSERT_EQ(b0.node, 7u);
+  ASSERT_EQ(b0.base, 0u);
+  palloc::PoolBlock b1 = ps.createBlock(30, 7, palloc::kPoolStrict);
+  ASSERT_EQ(b1.node, palloc::INV);
+  ASSERT_EQ(b1.base, palloc::INV);
+  ASSERT_EQ(ps.createBlock(1, 9, palloc::kPoolStrict).base, palloc::INV);
+  ASSERT_DOUBLE_EQ(ps.occupancy(7), 0.8);
+
+  // preferred falls back to the next pools in order
+  b1 = ps.createBlock(30, 7, palloc::kPoolPreferred);
+  ASSERT_EQ(b1.node, 3u);
+  palloc::PoolBlock b2 = ps.createBlock(90, 5, palloc::kPoolPreferred);
+  ASSERT_EQ(b2.node, 5u);
+  palloc::PoolBlock b3 = ps.createBlock(20, 5, palloc::kPoolPreferred);
+  ASSERT_EQ(b3.node, 7u);
+  ASSERT_EQ(ps.createBlock(1, 9, palloc::kPoolPreferred).base, palloc::INV);
+  ASSERT_EQ(ps.usedPages(), 220u);
+
+  // frees go to the owning pool
+  ASSERT_TRUE(ps.freeBlock(b0));
+  ASSERT_FALSE(ps.freeBlock(b0));
+  ASSERT_FALSE(ps.freeBlock({9, 0}));
+  ASSERT_TRUE(ps.freeBlock(b1));
+  ASSERT_TRUE(ps.freeBlock(b2));
+  ASSERT_TRUE(ps.freeBlock(b3));
+  ASSERT_EQ(ps.pool(3)->usedPages(), 0u);
+  ASSERT_EQ(ps.pool(9), nullptr);
+  ASSERT_DOUBLE_EQ(ps.occupancy(9), 0.0);
+  ps.verify(false);
+}
+
+TEST(PoolSet, interleave) {
+  palloc::PoolSet ps;
+  ASSERT_EQ(ps.createBlock(1, 0, palloc::kPoolInterleave).base, palloc::INV);
+  ASSERT_TRUE(ps.addPool(0, 10, 1));
+  ASSERT_TRUE(ps.addPool(1, 20, 1));
+  ASSERT_TRUE(ps.addPool(2, 10, 1));
+
+  // round robin, skipping pools that are full
+  std::vector<u64> nodes;
+  for (u64 idx = 0; idx < 8; idx++) {
+    palloc::PoolBlock block = ps.createBlock(5, 0, palloc::kPoolInterleave);
+    ASSERT_NE(block.base, palloc::INV);
+    nodes.push_back(block.node);
+  }
+  ASSERT_EQ(nodes, std::vector<u64>({0, 1, 2, 0, 1, 2, 1, 1}));
+  ASSERT_EQ(ps.createBlock(5, 0, palloc::kPoolInterleave).base,
+            palloc::INV);
+  ASSERT_EQ(ps.freePages(), 0u);
+  ps.verify(false);
+}
@@ -0,0 +1,157 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_SIZECLASSES_H_
+#define PALLOC_SIZECLASSES_H_
+
+#include <prim/prim.h>
+
+#include <cassert>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "palloc/Block.h"
+
+namespace palloc {
+
+/*
+ * These are the exponential (i.e., powers of 2) size classes of free blocks.
+ * Class 'i' holds sizes up to ceilPow2(minBlockSize) * 2^i and the last
+ * class is unbounded. The number of classes is limited to 64 so a class
+ * mask fits in a word.
+ *
+ * There is only one level of classes, unlike TLSF which subdivides each
+ * power of 2 class linearly. The class comes from a count leading zeros and
+ * the first non-empty class from a bit scan of the mask, both O(1), but the
+ * search within a class relies on the size ordered trees of the placement
+ * policy (see BestFit.h) and takes O(log n) time. A second level would only
+ * make those trees a few levels shallower, and unlike TLSF's good fit, the
+ * trees still return the best fit.
+ */
+
+class SizeClasses {
+ public:
+  typedef std::vector<Block*> Lists;  // a free list root per class
+
+  SizeClasses(u64 _pages, u64 _minBlockSize);
+
+  // returns the number of classes
+  u64 count() const {
+    return count_;
+  }
+
+  // returns the class of a block size
+  u64 index(u64 _pages) const {
+    u64 index = ceilLog2(_pages);
+    index = (index <= shift_) ? 0 : index - shift_;
+    return std::min(index, count_ - 1);
+  }
+
+  // returns the largest block size of a class, U64_MAX for the last class
+  u64 limit(u64 _index) const;
+
+  // sets the number of classes for a new number of pages
+  //  returns true (the classes can always change)
+  bool resize(u64 _pages);
+
+  // returns ceil(log2(_value)) using a count leading zeros instruction
+  static constexpr u64 ceilLog2(u64 _value) {
+    return (_value <= 1) ? 0 : 64 - (u64)__builtin_clzll(_value - 1);
+  }
+
+ private:
+  u64 count_;
+  u64 shift_;  // log2 of the first class limit
+};
+
+/*
+ * These are the size classes of a geometry fixed at compile time. The class
+ * count, shift, and limits are constants so index() compiles to a few
+ * instructions and the free list roots fit in a std::array.
+ */
+
+template <u64 Pages, u64 MinBlockSize>
+class StaticSizeClasses {
+ public:
+  static_assert(MinBlockSize > 0 && MinBlockSize <= Pages,
+                "MinBlockSize must be > 0 and MinBlockSize <= Pages");
+
+  static constexpr u64 kShift = SizeClasses::ceilLog2(MinBlockSize);
+  static constexpr u64 kCount =
+      SizeClasses::ceilLog2(Pages) - kShift + 1 < 64 ?
+      SizeClasses::ceilLog2(Pages) - kShift + 1 : 64;
+
+  typedef std::array<Block*, kCount> Lists;  // a free list root per class
+
+  // the arguments are checked against the template arguments
+  StaticSizeClasses(u64 _pages, u64 _minBlockSize);
+
+  // returns the number of classes
+  static constexpr u64 count() {
+    return kCount;
+  }
+
+  // returns the class of a block size
+  static u64 index(u64 _pages) {
+    u64 index = SizeClasses::ceilLog2(_pages);
+    index = (index <= kShift) ? 0 : index - kShift;
+    return index < kCount - 1 ? index : kCount - 1;
+  }
+
+  // returns the largest block size of a class, U64_MAX for the last class
+  static constexpr u64 limit(u64 _index) {
+    return (_index == kCount - 1) ? U64_MAX : (u64)1 << (kShift + _index);
+  }
+
+  // returns true only for the fixed number of pages, the classes can't change
+  static constexpr bool resize(u64 _pages) {
+    return _pages == Pages;
+  }
+};
+
+template <u64 Pages, u64 MinBlockSize>
+constexpr u64 StaticSizeClasses<Pages, MinBlockSize>::kShift;
+
+template <u64 Pages, u64 MinBlockSize>
+constexpr u64 StaticSizeClasses<Pages, MinBlockSize>::kCount;
+
+template <u64 Pages, u64 MinBlockSize>
+StaticSizeClasses<Pages, MinBlockSize>::StaticSizeClasses(
+    u64 _pages, u64 _minBlockSize) {
+  assert(_pages == Pages && _minBlockSize == MinBlockSize);
+  (void)_pages;  // unused
+  (void)_minBlockSize;  // unused
+}
+
+}  // namespace palloc
+
+#endif  // PALLOC_SIZECLASSES_H_
@@ -0,0 +1,67 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_SNAPSHOT_H_
+#define PALLOC_SNAPSHOT_H_
+
+#include <prim/prim.h>
+
+namespace palloc {
+
+/*
+ * A snapshot is a flat file holding a SnapshotHeader followed by one word per
+ * block in page order. The base page of each block is implied by the sizes
+ * of the blocks before it, so a word holds only the size of the block with
+ * kSnapshotUsed set for used blocks. Words are written in the byte order of
+ * the machine so a snapshot is loaded by mapping the file and walking the
+ * words once.
+ */
+
+const u64 kSnapshotUsed = (u64)1 << 63;
+const u64 kSnapshotVersion = 1;
+
+struct SnapshotHeader {
+  char magic[8];  // "PALLOCSS"
+  u64 version;
+  u64 pages;
+  u64 minBlockSize;
+  u64 blocks;  // number of words that follow
+};
+
+// returns true if '_header' starts a snapshot of this version
+bool validSnapshotHeader(const SnapshotHeader& _header);
+
+// fills in the header of a snapshot
+void makeSnapshotHeader(u64 _pages, u64 _minBlockSize, u64 _blocks,
+                        SnapshotHeader* _header);
+
+}  // namespace palloc
+
+#endif  // PALLOC_SNAPSHOT_H_
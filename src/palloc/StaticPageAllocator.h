@@ -0,0 +1,63 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_STATICPAGEALLOCATOR_H_
+#define PALLOC_STATICPAGEALLOCATOR_H_
+
+#include <prim/prim.h>
+
+#include "palloc/BestFit.h"
+#include "palloc/PageAllocator.h"
+
+namespace palloc {
+
+/*
+ * This is a best fit PageAllocator for a geometry fixed at compile time,
+ * e.g., StaticPageAllocator<(u64)1 << 24, 16>. The size classes are
+ * constants, so the class of a size is computed with a few inlined
+ * instructions, and the free list roots are a std::array in the allocator
+ * rather than a heap allocated vector. Placement is identical to
+ * PageAllocator with the same geometry. The geometry can't change, so
+ * extend() and truncate() always fail.
+ */
+
+template <u64 Pages, u64 MinBlockSize>
+class StaticPageAllocator
+    : public BasicPageAllocator<StaticBestFit<Pages, MinBlockSize> > {
+ public:
+  // see BasicPageAllocator
+  explicit StaticPageAllocator(u64 _reserveBlocks = 0)
+      : BasicPageAllocator<StaticBestFit<Pages, MinBlockSize> >(
+            Pages, MinBlockSize, _reserveBlocks) {}
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_STATICPAGEALLOCATOR_H_
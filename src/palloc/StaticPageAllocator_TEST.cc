@@ -0,0 +1,97 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/StaticPageAllocator.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <random>
+#include <vector>
+
+TEST(StaticPageAllocator, classes) {
+  typedef palloc::StaticSizeClasses<(u64)1 << 24, 16> Classes;
+  static_assert(Classes::count() == 21, "16, 32, ..., 2^23, unbounded");
+  static_assert(Classes::limit(0) == 16, "first class limit");
+  static_assert(Classes::limit(20) == U64_MAX, "last class limit");
+
+  // matches the runtime classes
+  palloc::SizeClasses classes((u64)1 << 24, 16);
+  ASSERT_EQ(Classes::count(), classes.count());
+  for (u64 size = 1; size < 100000; size += 1 + size / 16) {
+    ASSERT_EQ(Classes::index(size), classes.index(size));
+  }
+  ASSERT_EQ(Classes::index(U64_MAX), classes.index(U64_MAX));
+  for (u64 index = 0; index < classes.count(); index++) {
+    ASSERT_EQ(Classes::limit(index), classes.limit(index));
+  }
+
+  // more than 64 classes are capped
+  static_assert(palloc::StaticSizeClasses<U64_MAX, 1>::count() == 64,
+                "capped class count");
+}
+
+TEST(StaticPageAllocator, placement) {
+  // placement matches the runtime allocator of the same geometry
+  palloc::StaticPageAllocator<10000, 3> pa;
+  palloc::PageAllocator ref(10000, 3);
+  std::vector<u64> blocks;
+  std::mt19937_64 rnd(12345);
+  for (u64 iter = 0; iter < 20000; iter++) {
+    if (blocks.empty() || rnd() % 5 < 3) {
+      u64 pages = 1 + rnd() % 100;
+      u64 base = pa.createBlock(pages);
+      ASSERT_EQ(base, ref.createBlock(pages));
+      if (base != palloc::INV) {
+        blocks.push_back(base);
+      }
+    } else {
+      u64 pick = rnd() % blocks.size();
+      ASSERT_TRUE(pa.freeBlock(blocks.at(pick)));
+      ASSERT_TRUE(ref.freeBlock(blocks.at(pick)));
+      blocks.at(pick) = blocks.back();
+      blocks.pop_back();
+    }
+    if (iter % 2000 == 0) {
+      pa.verify(false);
+    }
+  }
+  pa.verify(false);
+  ASSERT_EQ(pa.freeBlocks(), ref.freeBlocks());
+
+  // the free list roots are not heap allocated
+  ASSERT_LT(pa.metadataBytes(), ref.metadataBytes());
+
+  // the geometry can't change
+  ASSERT_FALSE(pa.extend(100));
+  ASSERT_FALSE(pa.truncate(9990));
+  ASSERT_EQ(pa.totalPages(), 10000u);
+  pa.verify(false);
+}
@@ -0,0 +1,97 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/Stats.h"
+
+#include <cassert>
+
+#include <algorithm>
+
+namespace palloc {
+
+const u64 Histogram::kBuckets;
+
+Histogram::Histogram() {
+  clear();
+}
+
+u64 Histogram::bucket(u64 _index) const {
+  assert(_index < kBuckets);
+  return buckets_[_index];
+}
+
+u64 Histogram::count() const {
+  u64 count = 0;
+  for (u64 index = 0; index < kBuckets; index++) {
+    count += buckets_[index];
+  }
+  return count;
+}
+
+u64 Histogram::quantile(f64 _fraction) const {
+  // find the bucket holding the value at the rank of the quantile
+  u64 total = count();
+  if (total == 0) {
+    return 0;
+  }
+  u64 rank = std::min((u64)(_fraction * total), total - 1);
+  u64 seen = 0;
+  for (u64 index = 0; index < kBuckets; index++) {
+    seen += buckets_[index];
+    if (seen > rank) {
+      return index == 0 ? 0 :
+          (index == 64 ? U64_MAX : ((u64)1 << index) - 1);
+    }
+  }
+  return 0;
+}
+
+void Histogram::clear() {
+  for (u64 index = 0; index < kBuckets; index++) {
+    buckets_[index] = 0;
+  }
+}
+
+StatCounters::StatCounters() {
+  clear();
+}
+
+void StatCounters::clear() {
+  splits = 0;
+  coalesces = 0;
+  failures = 0;
+  probes.clear();
+  walked.clear();
+  for (u64 op = 0; op < kNumTraceOps; op++) {
+    latency[op].clear();
+  }
+}
+
+}  // namespace palloc
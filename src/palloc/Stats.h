@@ -0,0 +1,146 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_STATS_H_
+#define PALLOC_STATS_H_
+
+#include <prim/prim.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <chrono>
+#include <vector>
+
+#include "palloc/Trace.h"
+
+/*
+ * Defining PALLOC_STATS enables the event counters and search histograms,
+ * defining PALLOC_STATS_LATENCY also enables the latency histograms. When
+ * they are not defined the counting statements are compiled out and the
+ * allocators hold no counters.
+ */
+#ifdef PALLOC_STATS_LATENCY
+#ifndef PALLOC_STATS
+#define PALLOC_STATS
+#endif
+#endif
+
+#ifdef PALLOC_STATS
+#define PALLOC_STAT(_statement) _statement
+#else
+#define PALLOC_STAT(_statement)
+#endif
+
+#ifdef PALLOC_STATS_LATENCY
+#define PALLOC_LATENCY(_statement) _statement
+#else
+#define PALLOC_LATENCY(_statement)
+#endif
+
+namespace palloc {
+
+// returns the time stamp counter on x86, nanoseconds elsewhere
+inline u64 cycles() {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// a histogram of power of 2 buckets, bucket 0 counts zeros and bucket 'i'
+//  counts values in [2^(i-1), 2^i)
+class Histogram {
+ public:
+  static const u64 kBuckets = 65;
+
+  Histogram();
+
+  // adds a value
+  void add(u64 _value) {
+    buckets_[_value == 0 ? 0 : 64 - __builtin_clzll(_value)]++;
+  }
+
+  // returns the count of a bucket
+  u64 bucket(u64 _index) const;
+
+  // returns the number of values
+  u64 count() const;
+
+  // returns the largest value of the bucket holding the '_fraction' quantile
+  //  (e.g., 0.99), 0 if empty
+  u64 quantile(f64 _fraction) const;
+
+  // removes all values
+  void clear();
+
+ private:
+  u64 buckets_[kBuckets];
+};
+
+// the work done by free block searches
+struct SearchCount {
+  u64 probes;  // free lists (or trees) probed
+  u64 walked;  // blocks walked
+};
+
+// the event counters of an allocator, only counted with PALLOC_STATS
+struct StatCounters {
+  StatCounters();
+  void clear();
+
+  u64 splits;  // blocks split in two
+  u64 coalesces;  // blocks merged into a neighbor
+  u64 failures;  // allocations without enough contiguous free pages
+  Histogram probes;  // free lists probed per search
+  Histogram walked;  // blocks walked per search
+  Histogram latency[kNumTraceOps];  // cycles per call, indexed by TraceOp
+};
+
+// a snapshot of the state of an allocator
+struct Stats {
+  // free blocks and pages per size class (see SizeClasses)
+  std::vector<u64> classBlocks;
+  std::vector<u64> classPages;
+
+  u64 largestFreeBlock;
+
+  // external fragmentation index, the fraction of free pages that are not in
+  //  the largest free block, 0 when there are no free pages
+  f64 fragmentation;
+
+  StatCounters counters;
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_STATS_H_
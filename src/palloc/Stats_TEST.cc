@@ -0,0 +1,72 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/Stats.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+TEST(Stats, histogram) {
+  palloc::Histogram histogram;
+  ASSERT_EQ(histogram.count(), 0u);
+  ASSERT_EQ(histogram.quantile(0.5), 0u);
+
+  histogram.add(0);
+  histogram.add(1);
+  histogram.add(2);
+  histogram.add(3);
+  histogram.add(4);
+  histogram.add(U64_MAX);
+  ASSERT_EQ(histogram.count(), 6u);
+  ASSERT_EQ(histogram.bucket(0), 1u);
+  ASSERT_EQ(histogram.bucket(1), 1u);
+  ASSERT_EQ(histogram.bucket(2), 2u);
+  ASSERT_EQ(histogram.bucket(3), 1u);
+  ASSERT_EQ(histogram.bucket(64), 1u);
+
+  ASSERT_EQ(histogram.quantile(0.0), 0u);
+  ASSERT_EQ(histogram.quantile(0.2), 1u);
+  ASSERT_EQ(histogram.quantile(0.5), 3u);
+  ASSERT_EQ(histogram.quantile(0.8), 7u);
+  ASSERT_EQ(histogram.quantile(1.0), U64_MAX);
+
+  histogram.clear();
+  ASSERT_EQ(histogram.count(), 0u);
+}
+
+TEST(Stats, cycles) {
+  u64 start = palloc::cycles();
+  u64 sum = 0;
+  for (u64 idx = 0; idx < 100000; idx++) {
+    sum += idx * idx;
+  }
+  ASSERT_NE(sum, 0u);
+  ASSERT_GT(palloc::cycles(), start);
+}
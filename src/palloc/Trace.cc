@@ -0,0 +1,141 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/Trace.h"
+
+#include <cassert>
+#include <cstring>
+
+namespace palloc {
+
+static const char kTraceMagic[8] = {'P', 'A', 'L', 'L', 'O', 'C', 'T', 'R'};
+static const u64 kTraceVersion = 1;
+
+const char* traceOpName(u64 _op) {
+  static const char* kNames[kNumTraceOps] = {
+    "createBlock", "createAlignedBlock", "freeBlock", "shrinkBlock",
+    "growBlock", "resizeBlock", "createBlocks", "freeBlocks", "batchItem",
+    "setDeferredCoalescing", "coalesceAll", "commitMove", "createBlockAt",
+    "reserveRanges", "extend", "truncate", "releaseRange"
+  };
+  return _op < kNumTraceOps ? kNames[_op] : "unknown";
+}
+
+TraceWriter::TraceWriter()
+    : file_(nullptr), ok_(false), buffer_(kBufferRecords), count_(0) {}
+
+TraceWriter::~TraceWriter() {
+  close();
+}
+
+bool TraceWriter::open(const std::string& _path, u64 _pages,
+                       u64 _minBlockSize) {
+  close();
+  file_ = fopen(_path.c_str(), "wb");
+  if (file_ == nullptr) {
+    return false;
+  }
+
+  TraceHeader header;
+  memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+  header.version = kTraceVersion;
+  header.pages = _pages;
+  header.minBlockSize = _minBlockSize;
+  ok_ = fwrite(&header, sizeof(header), 1, file_) == 1;
+  start_ = std::chrono::steady_clock::now();
+  count_ = 0;
+  return ok_;
+}
+
+bool TraceWriter::close() {
+  if (file_ == nullptr) {
+    return false;
+  }
+  flush();
+  ok_ = (fclose(file_) == 0) && ok_;
+  file_ = nullptr;
+  return ok_;
+}
+
+void TraceWriter::flush() {
+  assert(file_ != nullptr);
+  if (count_ > 0 && fwrite(buffer_.data(), sizeof(TraceRecord), count_,
+                           file_) != count_) {
+    ok_ = false;
+  }
+  count_ = 0;
+}
+
+TraceReader::TraceReader()
+    : file_(nullptr) {}
+
+TraceReader::~TraceReader() {
+  if (file_ != nullptr) {
+    fclose(file_);
+  }
+}
+
+bool TraceReader::open(const std::string& _path) {
+  if (file_ != nullptr) {
+    fclose(file_);
+  }
+  file_ = fopen(_path.c_str(), "rb");
+  if (file_ == nullptr) {
+    return false;
+  }
+  if (fread(&header_, sizeof(header_), 1, file_) != 1 ||
+      memcmp(header_.magic, kTraceMagic, sizeof(kTraceMagic)) != 0 ||
+      header_.version != kTraceVersion) {
+    fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+const TraceHeader& TraceReader::header() const {
+  return header_;
+}
+
+bool TraceReader::next(TraceRecord* _record) {
+  return file_ != nullptr && fread(_record, sizeof(*_record), 1, file_) == 1;
+}
+
+bool TraceReader::readAll(std::vector<TraceRecord>* _records) {
+  TraceRecord record;
+  while (next(&record)) {
+    _records->push_back(record);
+  }
+  // a partial record at the end means the trace was truncated
+  return file_ != nullptr && feof(file_) && !ferror(file_) &&
+      ((u64)ftell(file_) - sizeof(TraceHeader)) % sizeof(TraceRecord) == 0;
+}
+
+}  // namespace palloc
@@ -0,0 +1,182 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_TRACE_H_
+#define PALLOC_TRACE_H_
+
+#include <prim/prim.h>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace palloc {
+
+/*
+ * A trace is a binary file holding a TraceHeader followed by fixed width
+ * TraceRecords, one per call that changes an allocator. Batch calls are
+ * followed by one kTraceBatchItem record per block. Records are written in
+ * the byte order of the machine.
+ *
+ * Record arguments and results by operation:
+ *  kTraceCreateBlock           pages,      -,           base
+ *  kTraceCreateAlignedBlock    pages,      alignment,   base
+ *  kTraceFreeBlock             block,      -,           success
+ *  kTraceShrinkBlock           block,      pages,       success
+ *  kTraceGrowBlock             block,      pages,       success
+ *  kTraceResizeBlock           block,      pages,       base
+ *  kTraceCreateBlocks          count,      -,           success
+ *  kTraceFreeBlocks            count,      -,           success
+ *  kTraceBatchItem             pages or block,  -,      base or 0
+ *  kTraceSetDeferredCoalescing quickPages, threshold bits, 0
+ *  kTraceCoalesceAll           -,          -,           0
+ *  kTraceCommitMove            from,       to,          moved pages or 0
+ *  kTraceCreateBlockAt         base,       pages,       success
+ *  kTraceReserveRanges         count,      -,           success
+ *  kTraceExtend                morePages,  -,           success
+ *  kTraceTruncate              newPages,   -,           success
+ *  kTraceReleaseRange          block,      offset,      success
+ * The batch items of kTraceReserveRanges hold the base page and the pages of
+ * each range as the arguments. kTraceReleaseRange is followed by one batch
+ * item holding the pages.
+ */
+
+enum TraceOp : u8 {
+  kTraceCreateBlock = 0,
+  kTraceCreateAlignedBlock,
+  kTraceFreeBlock,
+  kTraceShrinkBlock,
+  kTraceGrowBlock,
+  kTraceResizeBlock,
+  kTraceCreateBlocks,
+  kTraceFreeBlocks,
+  kTraceBatchItem,
+  kTraceSetDeferredCoalescing,
+  kTraceCoalesceAll,
+  kTraceCommitMove,
+  kTraceCreateBlockAt,
+  kTraceReserveRanges,
+  kTraceExtend,
+  kTraceTruncate,
+  kTraceReleaseRange,
+  kNumTraceOps
+};
+
+struct TraceHeader {
+  char magic[8];  // "PALLOCTR"
+  u64 version;
+  u64 pages;
+  u64 minBlockSize;
+};
+
+struct TraceRecord {
+  u64 op : 8;
+  u64 time : 56;  // nanoseconds since the trace started
+  u64 args[2];
+  u64 result;
+};
+
+static_assert(sizeof(TraceRecord) == 32, "trace records must be 32 bytes");
+
+// returns the name of a trace operation
+const char* traceOpName(u64 _op);
+
+// writes trace records to a file through a large buffer
+class TraceWriter {
+ public:
+  TraceWriter();
+  ~TraceWriter();
+
+  // opens the file and writes the header
+  //  returns true if success, false otherwise
+  bool open(const std::string& _path, u64 _pages, u64 _minBlockSize);
+
+  // flushes the buffer and closes the file
+  //  returns true if all records were written, false otherwise
+  bool close();
+
+  // appends one record
+  void record(u64 _op, u64 _arg0, u64 _arg1, u64 _result) {
+    TraceRecord& record = buffer_[count_];
+    record.op = _op;
+    record.time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count();
+    record.args[0] = _arg0;
+    record.args[1] = _arg1;
+    record.result = _result;
+    if (++count_ == buffer_.size()) {
+      flush();
+    }
+  }
+
+ private:
+  // the number of records buffered before they are written
+  static const u64 kBufferRecords = 4096;
+
+  // this writes the buffered records to the file
+  void flush();
+
+  FILE* file_;
+  bool ok_;  // false once a write fails
+  std::chrono::steady_clock::time_point start_;
+  std::vector<TraceRecord> buffer_;
+  u64 count_;
+};
+
+// reads trace records from a file
+class TraceReader {
+ public:
+  TraceReader();
+  ~TraceReader();
+
+  // opens the file and reads the header
+  //  returns true if success, false otherwise (missing or not a trace)
+  bool open(const std::string& _path);
+
+  // returns the header of the open trace
+  const TraceHeader& header() const;
+
+  // reads the next record
+  //  returns true if success, false at the end of the trace
+  bool next(TraceRecord* _record);
+
+  // appends all remaining records to '_records'
+  //  returns true if the trace ended on a record boundary, false otherwise
+  bool readAll(std::vector<TraceRecord>* _records);
+
+ private:
+  FILE* file_;
+  TraceHeader header_;
+};
+
+}  // namespace palloc
+
+#endif  // PALLOC_TRACE_H_
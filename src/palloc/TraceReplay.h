@@ -0,0 +1,107 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_TRACEREPLAY_H_
+#define PALLOC_TRACEREPLAY_H_
+
+#include <prim/prim.h>
+
+#include <unordered_map>
+#include <vector>
+
+#include "palloc/PageAllocator.h"
+#include "palloc/Trace.h"
+
+namespace palloc {
+
+/*
+ * This drives an allocator with the calls of a trace (see Trace.h). The
+ * replayed allocator may place blocks differently than the recorded one
+ * (e.g., a different placement policy), so the recorded base pages are
+ * translated to the replayed ones. Only blocks whose base pages differ are
+ * kept in the translation table, so a faithful replay does no lookups.
+ *
+ * A call whose result differs from the recorded one counts as a mismatch.
+ * A call on a block that the replayed allocator failed to create is skipped.
+ */
+
+template <typename Allocator>
+class TraceReplay {
+ public:
+  explicit TraceReplay(Allocator* _allocator);
+
+  // replays '_count' records, a batch call and its items must not be split
+  //  across calls
+  void replay(const TraceRecord* _records, u64 _count);
+
+  // returns the number of calls replayed
+  u64 calls() const;
+
+  // returns the number of calls whose result differed from the trace
+  u64 mismatches() const;
+
+  // returns the number of calls skipped
+  u64 skipped() const;
+
+ private:
+  // this sets '_replayed' to the replayed base page of a recorded block
+  //  returns true if success, false if the replayed allocator doesn't have it
+  bool lookup(u64 _recorded, u64* _replayed) const;
+
+  // this records that a block is known by '_recorded' in the trace and by
+  //  '_replayed' here
+  void map(u64 _recorded, u64 _replayed);
+
+  // this forgets a recorded block
+  void unmap(u64 _recorded);
+
+  // this counts a mismatch if the results differ
+  void check(u64 _recorded, u64 _replayed);
+
+  // these replay one call and return the number of records consumed
+  u64 replayCreateBlocks(const TraceRecord* _records, u64 _count);
+  u64 replayFreeBlocks(const TraceRecord* _records, u64 _count);
+  u64 replayReserveRanges(const TraceRecord* _records, u64 _count);
+  u64 replayReleaseRange(const TraceRecord* _records, u64 _count);
+
+  Allocator* allocator_;
+  std::unordered_map<u64, u64> blocks_;  // recorded to replayed base pages
+  std::vector<u64> pages_;  // scratch space for batch calls
+  std::vector<u64> bases_;
+  u64 calls_;
+  u64 mismatches_;
+  u64 skipped_;
+};
+
+}  // namespace palloc
+
+#include "palloc/TraceReplay.tcc"
+
+#endif  // PALLOC_TRACEREPLAY_H_
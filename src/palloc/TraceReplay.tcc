@@ -0,0 +1,354 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cstring>
+
+namespace palloc {
+
+template <typename Allocator>
+TraceReplay<Allocator>::TraceReplay(Allocator* _allocator)
+    : allocator_(_allocator), calls_(0), mismatches_(0), skipped_(0) {}
+
+template <typename Allocator>
+void TraceReplay<Allocator>::replay(const TraceRecord* _records, u64 _count) {
+  u64 idx = 0;
+  while (idx < _count) {
+    const TraceRecord& record = _records[idx];
+    u64 consumed = 1;
+    calls_++;
+    switch (record.op) {
+      case kTraceCreateBlock: {
+        u64 base = allocator_->createBlock(record.args[0]);
+        check(record.result, base);
+        if (record.result != INV) {
+          map(record.result, base);
+        }
+        break;
+      }
+
+      case kTraceCreateAlignedBlock: {
+        u64 base = allocator_->createAlignedBlock(record.args[0],
+                                                  record.args[1]);
+        check(record.result, base);
+        if (record.result != INV) {
+          map(record.result, base);
+        }
+        break;
+      }
+
+      case kTraceFreeBlock: {
+        u64 block;
+        if (!lookup(record.args[0], &block)) {
+          skipped_++;
+          break;
+        }
+        bool res = allocator_->freeBlock(block);
+        check(record.result, res);
+        if (res) {
+          unmap(record.args[0]);
+        }
+        break;
+      }
+
+      case kTraceShrinkBlock: {
+        u64 block;
+        if (!lookup(record.args[0], &block)) {
+          skipped_++;
+          break;
+        }
+        bool res = allocator_->shrinkBlock(block, record.args[1]);
+        check(record.result, res);
+        if (res && record.args[1] == 0) {
+          unmap(record.args[0]);  // shrinking to zero frees the block
+        }
+        break;
+      }
+
+      case kTraceGrowBlock: {
+        u64 block;
+        if (!lookup(record.args[0], &block)) {
+          skipped_++;
+          break;
+        }
+        bool res = allocator_->growBlock(block, record.args[1]);
+        check(record.result, res);
+        break;
+      }
+
+      case kTraceResizeBlock: {
+        u64 block;
+        if (!lookup(record.args[0], &block)) {
+          skipped_++;
+          break;
+        }
+        Move move;
+        u64 base = allocator_->resizeBlock(block, record.args[1], &move);
+        check(record.result, base);
+        // the block keeps its old base page wherever the resize failed
+        unmap(record.args[0]);
+        map(record.result == INV ? record.args[0] : record.result,
+            base == INV ? block : base);
+        break;
+      }
+
+      case kTraceCreateBlocks:
+        consumed = replayCreateBlocks(&record, _count - idx);
+        break;
+
+      case kTraceFreeBlocks:
+        consumed = replayFreeBlocks(&record, _count - idx);
+        break;
+
+      case kTraceSetDeferredCoalescing: {
+        f64 threshold;
+        memcpy(&threshold, &record.args[1], sizeof(threshold));
+        allocator_->setDeferredCoalescing(record.args[0], threshold);
+        break;
+      }
+
+      case kTraceCoalesceAll:
+        allocator_->coalesceAll();
+        break;
+
+      case kTraceCommitMove: {
+        u64 from;
+        if (!lookup(record.args[0], &from)) {
+          skipped_++;
+          break;
+        }
+        // a failed move was recorded with zero pages, which fails again
+        Move move = {from, record.args[1], record.result};
+        bool res = allocator_->commitMove(move);
+        check(record.result != 0, res);
+        unmap(record.args[0]);
+        map(record.result != 0 ? record.args[1] : record.args[0],
+            res ? record.args[1] : from);
+        break;
+      }
+
+      case kTraceCreateBlockAt: {
+        bool res = allocator_->createBlockAt(record.args[0], record.args[1]);
+        check(record.result, res);
+        if (record.result) {
+          map(record.args[0], res ? record.args[0] : INV);
+        }
+        break;
+      }
+
+      case kTraceReserveRanges:
+        consumed = replayReserveRanges(&record, _count - idx);
+        break;
+
+      case kTraceExtend:
+        check(record.result, allocator_->extend(record.args[0]));
+        break;
+
+      case kTraceTruncate:
+        check(record.result, allocator_->truncate(record.args[0]));
+        break;
+
+      case kTraceReleaseRange:
+        consumed = replayReleaseRange(&record, _count - idx);
+        break;
+
+      default:
+        // batch items outside of a batch or unknown operations
+        calls_--;
+        skipped_++;
+        break;
+    }
+    idx += consumed;
+  }
+}
+
+template <typename Allocator>
+u64 TraceReplay<Allocator>::calls() const {
+  return calls_;
+}
+
+template <typename Allocator>
+u64 TraceReplay<Allocator>::mismatches() const {
+  return mismatches_;
+}
+
+template <typename Allocator>
+u64 TraceReplay<Allocator>::skipped() const {
+  return skipped_;
+}
+
+/*** private below here ***/
+
+template <typename Allocator>
+bool TraceReplay<Allocator>::lookup(u64 _recorded, u64* _replayed) const {
+  *_replayed = _recorded;
+  if (!blocks_.empty()) {
+    auto it = blocks_.find(_recorded);
+    if (it != blocks_.end()) {
+      *_replayed = it->second;
+    }
+  }
+  return *_replayed != INV || _recorded == INV;
+}
+
+template <typename Allocator>
+void TraceReplay<Allocator>::map(u64 _recorded, u64 _replayed) {
+  if (_recorded != _replayed) {
+    blocks_[_recorded] = _replayed;
+  } else {
+    unmap(_recorded);
+  }
+}
+
+template <typename Allocator>
+void TraceReplay<Allocator>::unmap(u64 _recorded) {
+  if (!blocks_.empty()) {
+    blocks_.erase(_recorded);
+  }
+}
+
+template <typename Allocator>
+void TraceReplay<Allocator>::check(u64 _recorded, u64 _replayed) {
+  if (_recorded != _replayed) {
+    mismatches_++;
+  }
+}
+
+template <typename Allocator>
+u64 TraceReplay<Allocator>::replayCreateBlocks(const TraceRecord* _records,
+                                               u64 _count) {
+  // gather the sizes, a truncated batch is skipped
+  u64 count = _records[0].args[0];
+  if (count >= _count) {
+    skipped_++;
+    return _count;
+  }
+  pages_.clear();
+  for (u64 idx = 1; idx <= count; idx++) {
+    pages_.push_back(_records[idx].args[0]);
+  }
+
+  bases_.resize(count);
+  bool res = allocator_->createBlocks(pages_.data(), count, bases_.data());
+  check(_records[0].result, res);
+  if (_records[0].result) {
+    for (u64 idx = 1; idx <= count; idx++) {
+      map(_records[idx].result, res ? bases_.at(idx - 1) : INV);
+    }
+  }
+  return count + 1;
+}
+
+template <typename Allocator>
+u64 TraceReplay<Allocator>::replayFreeBlocks(const TraceRecord* _records,
+                                             u64 _count) {
+  // gather the blocks, those the replay doesn't have are left out
+  u64 count = _records[0].args[0];
+  if (count >= _count) {
+    skipped_++;
+    return _count;
+  }
+  bases_.clear();
+  for (u64 idx = 1; idx <= count; idx++) {
+    u64 block;
+    if (!lookup(_records[idx].args[0], &block)) {
+      skipped_++;
+    } else {
+      bases_.push_back(block);
+    }
+  }
+
+  bool res = allocator_->freeBlocks(bases_.data(), bases_.size());
+  check(_records[0].result, res);
+  if (res) {
+    for (u64 idx = 1; idx <= count; idx++) {
+      unmap(_records[idx].args[0]);
+    }
+  }
+  return count + 1;
+}
+
+template <typename Allocator>
+u64 TraceReplay<Allocator>::replayReserveRanges(const TraceRecord* _records,
+                                                u64 _count) {
+  // gather the ranges, a truncated batch is skipped
+  u64 count = _records[0].args[0];
+  if (count >= _count) {
+    skipped_++;
+    return _count;
+  }
+  bases_.clear();
+  pages_.clear();
+  for (u64 idx = 1; idx <= count; idx++) {
+    bases_.push_back(_records[idx].args[0]);
+    pages_.push_back(_records[idx].args[1]);
+  }
+
+  bool res = allocator_->reserveRanges(bases_.data(), pages_.data(), count);
+  check(_records[0].result, res);
+  if (_records[0].result) {
+    for (u64 idx = 1; idx <= count; idx++) {
+      map(_records[idx].args[0], res ? _records[idx].args[0] : INV);
+    }
+  }
+  return count + 1;
+}
+
+template <typename Allocator>
+u64 TraceReplay<Allocator>::replayReleaseRange(const TraceRecord* _records,
+                                               u64 _count) {
+  // the pages are in the following item, a truncated call is skipped
+  if (_count < 2) {
+    skipped_++;
+    return _count;
+  }
+  u64 block;
+  if (!lookup(_records[0].args[0], &block)) {
+    skipped_++;
+    return 2;
+  }
+  u64 offset = _records[0].args[1];
+  u64 pages = _records[1].args[0];
+  u64 size = allocator_->blockSize(block);
+  bool res = allocator_->releaseRange(block, offset, pages);
+  check(_records[0].result, res);
+  if (res) {
+    // the pages after the gap became a block, those before it only remain
+    //  when the offset isn't zero
+    if (offset + pages < size) {
+      map(_records[0].args[0] + offset + pages, block + offset + pages);
+    }
+    if (offset == 0) {
+      unmap(_records[0].args[0]);
+    }
+  }
+  return 2;
+}
+
+}  // namespace palloc
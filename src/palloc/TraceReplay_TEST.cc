@@ -0,0 +1,219 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/TraceReplay.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "palloc/PageAllocator.h"
+
+// this returns the number of calls in a trace
+static u64 countCalls(const std::vector<palloc::TraceRecord>& _records) {
+  u64 calls = 0;
+  for (const palloc::TraceRecord& record : _records) {
+    if (record.op != palloc::kTraceBatchItem) {
+      calls++;
+    }
+  }
+  return calls;
+}
+
+// this runs a random mix of every traced call
+static void exercise(palloc::PageAllocator* _pa) {
+  std::mt19937_64 rnd(12345);
+  std::vector<u64> blocks;
+  for (u64 op = 0; op < 20000; op++) {
+    if (op == 5000) {
+      _pa->setDeferredCoalescing(8, 0.5);
+    } else if (op == 15000) {
+      _pa->setDeferredCoalescing(0, 0.0);
+    } else if (op % 4000 == 2000) {
+      _pa->extend(256);
+    } else if (op % 4000 == 0) {
+      _pa->truncate(_pa->totalPages() - 256);
+    }
+    u64 choice = rnd() % 16;
+    if (blocks.empty() || choice < 5) {
+      u64 block = (choice == 0) ? _pa->createAlignedBlock(1 + rnd() % 32, 16) :
+          _pa->createBlock(1 + rnd() % 64);
+      if (choice == 1) {
+        u64 base = rnd() % 4000;
+        if (_pa->createBlockAt(base, 1 + rnd() % 16)) {
+          blocks.push_back(base);
+        }
+      } else if (choice == 2) {
+        u64 bases[2] = {rnd() % 4000, rnd() % 4000};
+        u64 pages[2] = {1 + rnd() % 8, 1 + rnd() % 8};
+        if (_pa->reserveRanges(bases, pages, 2)) {
+          blocks.insert(blocks.end(), bases, bases + 2);
+        }
+      }
+      if (block != palloc::INV) {
+        blocks.push_back(block);
+      }
+      continue;
+    }
+    u64 index = rnd() % blocks.size();
+    u64 block = blocks.at(index);
+    if (choice < 9) {
+      ASSERT_TRUE(_pa->freeBlock(block));
+      blocks.at(index) = blocks.back();
+      blocks.pop_back();
+    } else if (choice < 10) {
+      if (_pa->blockSize(block) > 6 && _pa->releaseRange(block, 2, 2)) {
+        blocks.push_back(block + 4);
+      } else {
+        _pa->shrinkBlock(block, 1);
+      }
+    } else if (choice < 11) {
+      _pa->growBlock(block, 1 + rnd() % 64);
+    } else if (choice < 12) {
+      palloc::Move move;
+      u64 base = _pa->resizeBlock(block, 1 + rnd() % 64, &move);
+      if (base != palloc::INV) {
+        blocks.at(index) = base;
+      }
+    } else if (choice < 13) {
+      u64 pages[3] = {1 + rnd() % 8, 1 + rnd() % 8, 1 + rnd() % 8};
+      u64 bases[3];
+      if (_pa->createBlocks(pages, 3, bases)) {
+        blocks.insert(blocks.end(), bases, bases + 3);
+      }
+    } else if (choice < 14 && blocks.size() >= 2) {
+      u64 bases[2] = {blocks.back(), blocks.at(blocks.size() - 2)};
+      ASSERT_TRUE(_pa->freeBlocks(bases, 2));
+      blocks.resize(blocks.size() - 2);
+    } else if (choice < 15) {
+      _pa->freeBlock(palloc::INV);  // recorded as a failure
+    } else if (op % 100 == 15) {
+      // compact, then find the blocks again through the moves
+      std::vector<palloc::Move> plan;
+      _pa->planCompaction(256, &plan);
+      _pa->commitCompaction(plan, 0, plan.size(), [&](
+          const palloc::Move& _move) {
+          for (u64& b : blocks) {
+            if (b == _move.from) {
+              b = _move.to;
+            }
+          }
+        });
+    } else {
+      _pa->coalesceAll();
+    }
+  }
+}
+
+TEST(TraceReplay, exact) {
+  std::string path = testing::TempDir() + "palloc_replay_exact.bin";
+  palloc::PageAllocator pa(4096, 2);
+  ASSERT_TRUE(pa.startTrace(path));
+  exercise(&pa);
+  ASSERT_TRUE(pa.stopTrace());
+  ASSERT_FALSE(pa.stopTrace());
+  pa.verify(false);
+
+  palloc::TraceReader reader;
+  ASSERT_TRUE(reader.open(path));
+  ASSERT_EQ(reader.header().pages, 4096u);
+  ASSERT_EQ(reader.header().minBlockSize, 2u);
+  std::vector<palloc::TraceRecord> records;
+  ASSERT_TRUE(reader.readAll(&records));
+  ASSERT_GT(countCalls(records), 20000u);
+
+  // the replayed allocator ends in the same state
+  palloc::PageAllocator replayed(reader.header().pages,
+                                 reader.header().minBlockSize);
+  palloc::TraceReplay<palloc::PageAllocator> replay(&replayed);
+  replay.replay(records.data(), records.size());
+  replayed.verify(false);
+  ASSERT_EQ(replay.calls(), countCalls(records));
+  ASSERT_EQ(replay.mismatches(), 0u);
+  ASSERT_EQ(replay.skipped(), 0u);
+  ASSERT_EQ(replayed.freeBlocks(), pa.freeBlocks());
+  ASSERT_EQ(replayed.usedBlocks(), pa.usedBlocks());
+  ASSERT_EQ(replayed.usedPages(), pa.usedPages());
+  remove(path.c_str());
+}
+
+TEST(TraceReplay, otherPolicy) {
+  std::string path = testing::TempDir() + "palloc_replay_other.bin";
+  palloc::PageAllocator pa(4096, 2);
+  ASSERT_TRUE(pa.startTrace(path));
+  exercise(&pa);
+  ASSERT_TRUE(pa.stopTrace());
+
+  palloc::TraceReader reader;
+  ASSERT_TRUE(reader.open(path));
+  std::vector<palloc::TraceRecord> records;
+  ASSERT_TRUE(reader.readAll(&records));
+
+  // blocks land elsewhere but are still found through the translation
+  palloc::NextFitPageAllocator replayed(reader.header().pages,
+                                        reader.header().minBlockSize);
+  palloc::TraceReplay<palloc::NextFitPageAllocator> replay(&replayed);
+  replay.replay(records.data(), records.size());
+  replayed.verify(false);
+  ASSERT_EQ(replay.calls(), countCalls(records));
+  ASSERT_GT(replay.mismatches(), 0u);
+  remove(path.c_str());
+}
+
+TEST(TraceReplay, corruptBatch) {
+  // batch counts near U64_MAX are skipped rather than read past the end
+  palloc::PageAllocator pa(1024, 1);
+  palloc::TraceReplay<palloc::PageAllocator> replay(&pa);
+  for (u64 op : {palloc::kTraceCreateBlocks, palloc::kTraceFreeBlocks,
+                 palloc::kTraceReserveRanges}) {
+    for (u64 count : {U64_MAX, U64_MAX - 1, (u64)2}) {
+      std::vector<palloc::TraceRecord> records(2);
+      records[0].op = op;
+      records[0].time = 0;
+      records[0].args[0] = count;
+      records[0].args[1] = 0;
+      records[0].result = 0;
+      records[1].op = palloc::kTraceBatchItem;
+      records[1].time = 0;
+      records[1].args[0] = 1;
+      records[1].args[1] = 0;
+      records[1].result = 0;
+      u64 skipped = replay.skipped();
+      replay.replay(records.data(), records.size());
+      ASSERT_EQ(replay.skipped(), skipped + 1);
+    }
+  }
+  ASSERT_EQ(pa.usedBlocks(), 0u);
+  pa.verify(false);
+}
@@ -0,0 +1,101 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/Trace.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+TEST(Trace, roundTrip) {
+  std::string path = testing::TempDir() + "palloc_trace_roundtrip.bin";
+
+  // write more records than fit in the buffer
+  const u64 kRecords = 10000;
+  palloc::TraceWriter writer;
+  ASSERT_TRUE(writer.open(path, 1 << 20, 4));
+  for (u64 idx = 0; idx < kRecords; idx++) {
+    writer.record(idx % palloc::kNumTraceOps, idx, idx * 2, idx * 3);
+  }
+  ASSERT_TRUE(writer.close());
+  ASSERT_FALSE(writer.close());
+
+  palloc::TraceReader reader;
+  ASSERT_TRUE(reader.open(path));
+  ASSERT_EQ(reader.header().pages, 1u << 20);
+  ASSERT_EQ(reader.header().minBlockSize, 4u);
+  std::vector<palloc::TraceRecord> records;
+  ASSERT_TRUE(reader.readAll(&records));
+  ASSERT_EQ(records.size(), kRecords);
+  u64 time = 0;
+  for (u64 idx = 0; idx < kRecords; idx++) {
+    const palloc::TraceRecord& record = records.at(idx);
+    ASSERT_EQ(record.op, idx % palloc::kNumTraceOps);
+    ASSERT_EQ(record.args[0], idx);
+    ASSERT_EQ(record.args[1], idx * 2);
+    ASSERT_EQ(record.result, idx * 3);
+    ASSERT_GE(record.time, time);
+    time = record.time;
+  }
+  remove(path.c_str());
+}
+
+TEST(Trace, invalid) {
+  std::string path = testing::TempDir() + "palloc_trace_invalid.bin";
+  palloc::TraceReader reader;
+  ASSERT_FALSE(reader.open(path));
+
+  // not a trace
+  FILE* file = fopen(path.c_str(), "wb");
+  ASSERT_NE(file, nullptr);
+  fprintf(file, "this is not a trace file, just some text");
+  fclose(file);
+  ASSERT_FALSE(reader.open(path));
+
+  // a truncated trace
+  palloc::TraceWriter writer;
+  ASSERT_TRUE(writer.open(path, 1024, 1));
+  writer.record(palloc::kTraceCreateBlock, 1, 0, 0);
+  writer.record(palloc::kTraceCreateBlock, 1, 0, 1);
+  ASSERT_TRUE(writer.close());
+  ASSERT_EQ(truncate(path.c_str(),
+                     sizeof(palloc::TraceHeader) +
+                     sizeof(palloc::TraceRecord) + 5), 0);
+  ASSERT_TRUE(reader.open(path));
+  std::vector<palloc::TraceRecord> records;
+  ASSERT_FALSE(reader.readAll(&records));
+  ASSERT_EQ(records.size(), 1u);
+  remove(path.c_str());
+}
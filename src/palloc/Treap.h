@@ -0,0 +1,84 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_TREAP_H_
+#define PALLOC_TREAP_H_
+
+#include <prim/prim.h>
+
+#include "palloc/Block.h"
+
+namespace palloc {
+
+/*
+ * This is an intrusive treap over the free index links of blocks (parent,
+ * left, and right). Priorities are a hash of the block address so no random
+ * state is kept. Removal rotates the block down to a leaf, which takes an
+ * expected O(1) rotations and needs no search.
+ *
+ * 'Order' must provide:
+ *   static bool less(const Block* _a, const Block* _b);
+ *   static const bool kAugmented;  // maintain Block::maxSize
+ */
+
+template <typename Order>
+class Treap {
+ public:
+  // returns the first block of a tree, nullptr if empty
+  static Block* first(Block* _root);
+
+  // returns the next block in order, nullptr if none
+  static Block* next(Block* _block);
+
+  // inserts a block into a tree
+  static void insert(Block** _root, Block* _block);
+
+  // removes a block from a tree
+  static void remove(Block** _root, Block* _block);
+
+  // verifies the structure of a tree, returns the number of blocks
+  static u64 verify(const Block* _root);
+
+ private:
+  // this returns the priority of a block
+  static u64 priority(const Block* _block);
+
+  // this recomputes the subtree maximum size of a block
+  static void update(Block* _block);
+
+  // this rotates a block above its parent
+  static void rotateUp(Block** _root, Block* _block);
+};
+
+}  // namespace palloc
+
+#include "palloc/Treap.tcc"
+
+#endif  // PALLOC_TREAP_H_
@@ -0,0 +1,205 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <cassert>
+
+#include <algorithm>
+
+namespace palloc {
+
+template <typename Order>
+Block* Treap<Order>::first(Block* _root) {
+  if (_root != nullptr) {
+    while (_root->left != nullptr) {
+      _root = _root->left;
+    }
+  }
+  return _root;
+}
+
+template <typename Order>
+Block* Treap<Order>::next(Block* _block) {
+  // the successor is the first block of the right subtree if it exists
+  if (_block->right != nullptr) {
+    return first(_block->right);
+  }
+
+  // otherwise it is the first ancestor reached from a left subtree
+  while (_block->parent != nullptr && _block->parent->right == _block) {
+    _block = _block->parent;
+  }
+  return _block->parent;
+}
+
+template <typename Order>
+void Treap<Order>::insert(Block** _root, Block* _block) {
+  // insert the block as a leaf
+  _block->left = nullptr;
+  _block->right = nullptr;
+  _block->maxSize = _block->size;
+  Block* parent = nullptr;
+  Block** link = _root;
+  while (*link != nullptr) {
+    parent = *link;
+    if (Order::kAugmented) {
+      parent->maxSize = std::max(parent->maxSize, _block->size);
+    }
+    link = Order::less(_block, parent) ? &parent->left : &parent->right;
+  }
+  _block->parent = parent;
+  *link = _block;
+
+  // restore the heap ordering of the priorities
+  while (_block->parent != nullptr &&
+         priority(_block->parent) < priority(_block)) {
+    rotateUp(_root, _block);
+  }
+}
+
+template <typename Order>
+void Treap<Order>::remove(Block** _root, Block* _block) {
+  // rotate the block down until it is a leaf
+  while (_block->left != nullptr || _block->right != nullptr) {
+    Block* child;
+    if (_block->left == nullptr) {
+      child = _block->right;
+    } else if (_block->right == nullptr) {
+      child = _block->left;
+    } else {
+      child = (priority(_block->left) > priority(_block->right)) ?
+          _block->left : _block->right;
+    }
+    rotateUp(_root, child);
+  }
+
+  // detach the leaf
+  Block* parent = _block->parent;
+  if (parent == nullptr) {
+    *_root = nullptr;
+  } else if (parent->left == _block) {
+    parent->left = nullptr;
+  } else {
+    parent->right = nullptr;
+  }
+  _block->parent = nullptr;
+
+  // the ancestors may have lost their largest block
+  if (Order::kAugmented) {
+    for (; parent != nullptr; parent = parent->parent) {
+      update(parent);
+    }
+  }
+}
+
+template <typename Order>
+u64 Treap<Order>::verify(const Block* _root) {
+  if (_root == nullptr) {
+    return 0;
+  }
+  // check links, order, priority, and the subtree maximum
+  u64 maxSize = _root->size;
+  if (_root->left != nullptr) {
+    assert(_root->left->parent == _root);
+    assert(Order::less(_root->left, _root));
+    assert(priority(_root->left) <= priority(_root));
+    maxSize = std::max(maxSize, _root->left->maxSize);
+  }
+  if (_root->right != nullptr) {
+    assert(_root->right->parent == _root);
+    assert(Order::less(_root, _root->right));
+    assert(priority(_root->right) <= priority(_root));
+    maxSize = std::max(maxSize, _root->right->maxSize);
+  }
+  (void)maxSize;  // unused
+  assert(!Order::kAugmented || _root->maxSize == maxSize);
+  return 1 + verify(_root->left) + verify(_root->right);
+}
+
+template <typename Order>
+u64 Treap<Order>::priority(const Block* _block) {
+  // a mix of the block's address, stable for the life of the block
+  u64 hash = (u64)_block;
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDlu;
+  hash ^= hash >> 33;
+  return hash;
+}
+
+template <typename Order>
+void Treap<Order>::update(Block* _block) {
+  u64 maxSize = _block->size;
+  if (_block->left != nullptr) {
+    maxSize = std::max(maxSize, _block->left->maxSize);
+  }
+  if (_block->right != nullptr) {
+    maxSize = std::max(maxSize, _block->right->maxSize);
+  }
+  _block->maxSize = maxSize;
+}
+
+template <typename Order>
+void Treap<Order>::rotateUp(Block** _root, Block* _block) {
+  Block* parent = _block->parent;
+  Block* grand = parent->parent;
+
+  // move the child subtree that crosses over to the parent
+  if (parent->left == _block) {
+    parent->left = _block->right;
+    if (parent->left != nullptr) {
+      parent->left->parent = parent;
+    }
+    _block->right = parent;
+  } else {
+    parent->right = _block->left;
+    if (parent->right != nullptr) {
+      parent->right->parent = parent;
+    }
+    _block->left = parent;
+  }
+  parent->parent = _block;
+
+  // attach the block where the parent was
+  _block->parent = grand;
+  if (grand == nullptr) {
+    *_root = _block;
+  } else if (grand->left == parent) {
+    grand->left = _block;
+  } else {
+    grand->right = _block;
+  }
+
+  // the rotated pair's subtrees changed
+  if (Order::kAugmented) {
+    update(parent);
+    update(_block);
+  }
+}
+
+}  // namespace palloc
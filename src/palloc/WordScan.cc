@@ -0,0 +1,105 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/WordScan.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif  // __x86_64__
+
+namespace palloc {
+
+u64 fullWordsScalar(const u64* _words, u64 _count) {
+  u64 idx = 0;
+  while (idx < _count && _words[idx] == U64_MAX) {
+    idx++;
+  }
+  return idx;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx2")))
+u64 fullWordsAvx2(const u64* _words, u64 _count) {
+  const __m256i ones = _mm256_set1_epi64x(-1);
+  u64 idx = 0;
+  for (; idx + 4 <= _count; idx += 4) {
+    __m256i words = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(_words + idx));
+    u32 full = _mm256_movemask_pd(
+        _mm256_castsi256_pd(_mm256_cmpeq_epi64(words, ones)));
+    if (full != 0xF) {
+      return idx + __builtin_ctz(~full);
+    }
+  }
+  return idx + fullWordsScalar(_words + idx, _count - idx);
+}
+
+__attribute__((target("avx512f")))
+u64 fullWordsAvx512(const u64* _words, u64 _count) {
+  const __m512i ones = _mm512_set1_epi64(-1);
+  u64 idx = 0;
+  for (; idx + 8 <= _count; idx += 8) {
+    __m512i words = _mm512_loadu_si512(_words + idx);
+    __mmask8 notFull = _mm512_cmpneq_epu64_mask(words, ones);
+    if (notFull != 0) {
+      return idx + __builtin_ctz(notFull);
+    }
+  }
+  return idx + fullWordsScalar(_words + idx, _count - idx);
+}
+
+FullWordsFunc selectFullWords() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return fullWordsAvx512;
+  } else if (__builtin_cpu_supports("avx2")) {
+    return fullWordsAvx2;
+  }
+  return fullWordsScalar;
+}
+
+#else
+
+u64 fullWordsAvx2(const u64* _words, u64 _count) {
+  return fullWordsScalar(_words, _count);
+}
+
+u64 fullWordsAvx512(const u64* _words, u64 _count) {
+  return fullWordsScalar(_words, _count);
+}
+
+FullWordsFunc selectFullWords() {
+  return fullWordsScalar;
+}
+
+#endif  // __x86_64__
+
+}  // namespace palloc
@@ -0,0 +1,72 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#ifndef PALLOC_WORDSCAN_H_
+#define PALLOC_WORDSCAN_H_
+
+#include <prim/prim.h>
+
+namespace palloc {
+
+/*
+ * These scan arrays of bitmap words for the end of a run of set bits. The
+ * vector versions compare 4 (AVX2) or 8 (AVX-512) words per instruction and
+ * are compiled with target attributes, so they are safe to build for any x86
+ * CPU and are only called when selectFullWords() finds the CPU supports
+ * them. Other architectures use the scalar version everywhere.
+ */
+
+// returns the number of leading words of '_words' with all bits set, at most
+//  '_count'
+typedef u64 (*FullWordsFunc)(const u64* _words, u64 _count);
+
+u64 fullWordsScalar(const u64* _words, u64 _count);
+u64 fullWordsAvx2(const u64* _words, u64 _count);
+u64 fullWordsAvx512(const u64* _words, u64 _count);
+
+// returns the fastest version the CPU supports
+FullWordsFunc selectFullWords();
+
+// returns a mask of the bits of '_word' that start runs of at least '_bits'
+//  set bits within the word, '_bits' must be 1 to 64
+inline u64 runStarts(u64 _word, u64 _bits) {
+  // after each step bit 'i' is set when bits 'i' to 'i + span - 1' are
+  u64 span = 1;
+  while (span < _bits && _word != 0) {
+    u64 step = span < _bits - span ? span : _bits - span;
+    _word &= _word >> step;
+    span += step;
+  }
+  return _word;
+}
+
+}  // namespace palloc
+
+#endif  // PALLOC_WORDSCAN_H_
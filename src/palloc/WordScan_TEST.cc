@@ -0,0 +1,80 @@
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice, this
+ * list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * - Neither the name of prim nor the names of its contributors may be used to
+ * endorse or promote products derived from this software without specific prior
+ * written permission.
+ *
+ * See the NOTICE file distributed with this work for additional information
+ * regarding copyright ownership.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "palloc/WordScan.h"
+
+#include <gtest/gtest.h>
+#include <prim/prim.h>
+
+#include <vector>
+
+TEST(WordScan, fullWords) {
+  std::vector<palloc::FullWordsFunc> funcs;
+  funcs.push_back(palloc::fullWordsScalar);
+  funcs.push_back(palloc::selectFullWords());
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    funcs.push_back(palloc::fullWordsAvx2);
+  }
+  if (__builtin_cpu_supports("avx512f")) {
+    funcs.push_back(palloc::fullWordsAvx512);
+  }
+#endif  // __x86_64__
+
+  // every position of the first partial word and every count
+  std::vector<u64> words(40, U64_MAX);
+  for (palloc::FullWordsFunc func : funcs) {
+    for (u64 partial = 0; partial <= words.size(); partial++) {
+      if (partial < words.size()) {
+        words.at(partial) = U64_MAX - 1;
+      }
+      for (u64 count = 0; count <= words.size(); count++) {
+        ASSERT_EQ(func(words.data(), count), std::min(partial, count));
+      }
+      if (partial < words.size()) {
+        words.at(partial) = U64_MAX;
+      }
+    }
+  }
+}
+
+TEST(WordScan, runStarts) {
+  ASSERT_EQ(palloc::runStarts(0, 1), 0u);
+  ASSERT_EQ(palloc::runStarts(0xF0, 1), 0xF0u);
+  ASSERT_EQ(palloc::runStarts(0xF0, 3), 0x30u);
+  ASSERT_EQ(palloc::runStarts(0xF0, 4), 0x10u);
+  ASSERT_EQ(palloc::runStarts(0xF0, 5), 0u);
+  ASSERT_EQ(palloc::runStarts(0xF0F, 4), 0x101u);
+  ASSERT_EQ(palloc::runStarts(U64_MAX, 64), 1u);
+  ASSERT_EQ(palloc::runStarts(U64_MAX, 63), 3u);
+  ASSERT_EQ(palloc::runStarts(U64_MAX << 1, 63), 2u);
+  ASSERT_EQ(palloc::runStarts(U64_MAX << 1, 64), 0u);
+}